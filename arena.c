@@ -0,0 +1,55 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <malloc.h>
+#define aligned_free _aligned_free
+#else
+#define aligned_free free
+#endif
+
+bool arena_init(Arena* arena, size_t capacity) {
+    capacity = arena_block_size(capacity);
+
+    #if defined(_WIN32) || defined(_WIN64)
+    void* memory = _aligned_malloc(capacity, ARENA_ALIGNMENT);
+    #else
+    void* memory = NULL;
+    if(posix_memalign(&memory, ARENA_ALIGNMENT, capacity) != 0) memory = NULL;
+    #endif
+
+    arena->base = (uint8_t*)memory;
+    arena->capacity = memory ? capacity : 0;
+    arena->used = 0;
+    return memory != NULL;
+}
+
+void* arena_alloc_uninitialized(Arena* arena, size_t size) {
+    size = arena_block_size(size);
+    if(!arena->base || size > arena->capacity - arena->used) return NULL;
+
+    void* block = arena->base + arena->used;
+    arena->used += size;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    void* block = arena_alloc_uninitialized(arena, size);
+    if(block) memset(block, 0, size);
+    return block;
+}
+
+void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+void arena_free(Arena* arena) {
+    if(arena->base) aligned_free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * @file arena.h
+ * @brief Header file for the arena allocator, which carves memory out of a single allocation.
+ *
+ * @details An arena is one block of memory allocated up front, from which smaller blocks are handed
+ * out in order. Blocks are never freed individually: the whole arena is reset or freed at once. This
+ * keeps the number of allocations, and the ways they can fail, to exactly one; once the arena is
+ * initialized, running out of memory is a recoverable error (`arena_alloc()` returns NULL) rather
+ * than a failed `malloc()` in the middle of playback.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-26
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Alignment of the blocks returned by `arena_alloc()`, in bytes.
+ */
+#define ARENA_ALIGNMENT 64
+
+/**
+ * @brief An arena; all fields are read-only outside of arena.c.
+ */
+typedef struct arena {
+    /** The memory of the arena, or NULL if not initialized. */
+    uint8_t* base;
+    /** The size of the arena, in bytes. */
+    size_t capacity;
+    /** The number of bytes handed out so far, including alignment padding. */
+    size_t used;
+} Arena;
+
+/**
+ * @brief Computes the space a block takes in an arena, including its alignment padding.
+ * @param size The size of the block, in bytes.
+ */
+static inline size_t arena_block_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+/**
+ * @brief Allocates the memory of an arena.
+ *
+ * @details This function does not free any previously allocated memory;
+ * arena_free() must be called before calling this function again on the same arena.
+ *
+ * @param arena The arena to initialize.
+ * @param capacity The size of the arena, in bytes.
+ * @return false if the memory could not be allocated, true otherwise.
+ */
+bool arena_init(Arena* arena, size_t capacity);
+
+/**
+ * @brief Hands out a zero-filled block from an arena.
+ * @param arena The arena.
+ * @param size The size of the block, in bytes.
+ * @return The block, aligned to `ARENA_ALIGNMENT` bytes, or NULL if the arena does not have enough space left.
+ */
+void* arena_alloc(Arena* arena, size_t size);
+
+/**
+ * @brief Hands out a block from an arena without filling it.
+ *
+ * @details Unlike `arena_alloc()`, this does not touch the memory of the block, so the operating
+ * system does not need to back the parts of a large block that are never written.
+ *
+ * @param arena The arena.
+ * @param size The size of the block, in bytes.
+ * @return The block, aligned to `ARENA_ALIGNMENT` bytes, or NULL if the arena does not have enough space left.
+ */
+void* arena_alloc_uninitialized(Arena* arena, size_t size);
+
+/**
+ * @brief Makes all the space of an arena available again, invalidating the blocks handed out so far.
+ * @param arena The arena.
+ */
+void arena_reset(Arena* arena);
+
+/**
+ * @brief Frees the memory of an arena.
+ * @param arena The arena.
+ */
+void arena_free(Arena* arena);
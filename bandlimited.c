@@ -0,0 +1,61 @@
+#include "bandlimited.h"
+
+#include <stdint.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int16_t sawtooth_tables[BANDLIMITED_OCTAVES][BANDLIMITED_TABLE_SIZE];
+static int16_t triangle_tables[BANDLIMITED_OCTAVES][BANDLIMITED_TABLE_SIZE];
+
+static uint32_t table_sample_rate = 0; // Sample rate the tables were built for, 0 if never built
+
+// Fills a table with the first `harmonics` harmonics of the waveform
+static void build_table(BandlimitedWaveform waveform, int16_t* table, int harmonics) {
+    for(int i = 0; i < BANDLIMITED_TABLE_SIZE; i++) {
+        double x = 2.0 * M_PI * i / BANDLIMITED_TABLE_SIZE;
+        double value = 0;
+
+        if(waveform == BANDLIMITED_SAWTOOTH) {
+            // Rising from -1 to 1: -(2/pi) * sum(sin(n*x) / n)
+            for(int n = 1; n <= harmonics; n++) {
+                value += sin(n * x) / n;
+            }
+            value *= -2.0 / M_PI;
+        } else {
+            // -1 at the start of the cycle, 1 halfway through: -(8/pi^2) * sum(cos(n*x) / n^2) over odd n
+            for(int n = 1; n <= harmonics; n += 2) {
+                value += cos(n * x) / ((double)n * n);
+            }
+            value *= -8.0 / (M_PI * M_PI);
+        }
+
+        table[i] = (int16_t)lround(value * BANDLIMITED_PEAK);
+    }
+}
+
+void bandlimited_init(uint32_t sample_rate) {
+    if(sample_rate == table_sample_rate) return;
+
+    for(int octave = 0; octave < BANDLIMITED_OCTAVES; octave++) {
+        // Harmonics of the highest frequency in this octave that stay below the Nyquist frequency
+        int harmonics = (sample_rate / 2) / (BANDLIMITED_BASE_FREQUENCY << octave);
+        if(harmonics < 1) harmonics = 1;
+
+        build_table(BANDLIMITED_SAWTOOTH, sawtooth_tables[octave], harmonics);
+        build_table(BANDLIMITED_TRIANGLE, triangle_tables[octave], harmonics);
+    }
+
+    table_sample_rate = sample_rate;
+}
+
+const int16_t* bandlimited_table(BandlimitedWaveform waveform, uint16_t frequency) {
+    int octave = 0;
+    while(octave < BANDLIMITED_OCTAVES - 1 && frequency > (BANDLIMITED_BASE_FREQUENCY << octave)) {
+        octave++;
+    }
+
+    return waveform == BANDLIMITED_SAWTOOTH ? sawtooth_tables[octave] : triangle_tables[octave];
+}
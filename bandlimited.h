@@ -0,0 +1,104 @@
+#pragma once
+
+/**
+ * @file bandlimited.h
+ * @brief Header file for the band-limited wavetables used by the square, sawtooth and triangle oscillators.
+ *
+ * @details Naive waveforms contain harmonics well above the Nyquist frequency, which fold back as
+ * aliasing. This module precomputes, once, a set of mip-mapped wavetables per waveform: one table per
+ * octave of the fundamental frequency, each containing only the harmonics that stay below the Nyquist
+ * frequency for the highest note of that octave. Oscillators pick the table for their current frequency
+ * and read it with the same phase accumulator they use for the naive waveform, so the cost per sample
+ * is a single table lookup.
+ *
+ * Square waves are built from the difference of two sawtooth reads, which also supports arbitrary
+ * duty cycles without dedicated tables.
+ *
+ * The number of harmonics in each table depends on the sample rate, so the tables are rebuilt when
+ * the oscillators switch to a different sample rate.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-22
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Number of samples in each wavetable; must be a power of 2.
+ */
+#define BANDLIMITED_TABLE_SIZE 1024
+
+/**
+ * @brief Number of octave tables per waveform.
+ */
+#define BANDLIMITED_OCTAVES 10
+
+/**
+ * @brief Highest fundamental frequency (in Hz) covered by the first octave table.
+ */
+#define BANDLIMITED_BASE_FREQUENCY 32
+
+/**
+ * @brief Value of the peaks of a naive waveform in the tables; Gibbs ripples can go slightly above it.
+ */
+#define BANDLIMITED_PEAK 28000
+
+/**
+ * @brief Band-limited waveforms.
+ */
+typedef enum bandlimited_waveform {
+    BANDLIMITED_SAWTOOTH,
+    BANDLIMITED_TRIANGLE
+} BandlimitedWaveform;
+
+/**
+ * @brief Computes the wavetables for a sample rate, if they were not computed for it already.
+ *
+ * @details This is called automatically when an oscillator switches to band-limited output or changes
+ * sample rate, but can be called in advance to avoid the computation while playing. Tables previously
+ * returned by `bandlimited_table()` are overwritten if the sample rate is different.
+ *
+ * @param sample_rate The sample rate the oscillators run at, in Hz.
+ */
+void bandlimited_init(uint32_t sample_rate);
+
+/**
+ * @brief Retrieves the wavetable to use for a waveform at a given frequency.
+ *
+ * @details `bandlimited_init()` must have been called before; the table is band-limited for the
+ * sample rate passed to it.
+ *
+ * @param waveform The waveform to get the table for.
+ * @param frequency The fundamental frequency in Hz.
+ * @return The wavetable, `BANDLIMITED_TABLE_SIZE` samples long, with values between about
+ * -`BANDLIMITED_PEAK` and +`BANDLIMITED_PEAK`.
+ */
+const int16_t* bandlimited_table(BandlimitedWaveform waveform, uint16_t frequency);
+
+/**
+ * @brief Computes the factor used by `bandlimited_index()` for a given sample rate.
+ * @param sample_rate The sample rate, i.e. the length of a cycle of the oscillator's phase.
+ * @return The scale factor in Q16 fixed point.
+ */
+static inline uint32_t bandlimited_index_scale(uint32_t sample_rate) {
+    return (uint32_t)(((uint64_t)BANDLIMITED_TABLE_SIZE << 16) / sample_rate);
+}
+
+/**
+ * @brief Converts an oscillator phase (0 to `sample_rate` - 1) to an index in a wavetable.
+ * @param phase The phase of the oscillator.
+ * @param scale The value returned by `bandlimited_index_scale()` for the oscillator's sample rate.
+ */
+static inline uint16_t bandlimited_index(uint32_t phase, uint32_t scale) {
+    return (uint16_t)(((phase * scale) >> 16) & (BANDLIMITED_TABLE_SIZE - 1));
+}
+
+/**
+ * @brief Converts a wavetable value to an unsigned 8-bit sample centered around 128, clamping the ripples.
+ */
+static inline uint8_t bandlimited_to_u8(int32_t value) {
+    int32_t sample = 128 + (value * 127) / BANDLIMITED_PEAK;
+    if(sample < 0) sample = 0;
+    if(sample > 255) sample = 255;
+    return (uint8_t)sample;
+}
@@ -0,0 +1,212 @@
+#include "batch.h"
+#include "song.h"
+#include "looper.h"
+#include "envelope.h"
+#include "resampler.h"
+#include "output.h"
+#include "wav.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#define BLOCKS_PER_SECOND 100
+#define MAX_PATH_LENGTH 4096
+
+static double now_seconds(void) {
+    #if defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+    #endif
+}
+
+// Builds <output directory>/<base name of the song without extension>.wav
+static bool output_path(const char* directory, const char* song, char* out, size_t size) {
+    const char* name = song;
+    for(const char* c = song; *c; c++) {
+        if(*c == '/' || *c == '\\') name = c + 1;
+    }
+
+    const char* extension = strrchr(name, '.');
+    int name_length = extension && extension != name ? (int)(extension - name) : (int)strlen(name);
+
+    int written = snprintf(out, size, "%s/%.*s.wav", directory, name_length, name);
+    return written > 0 && (size_t)written < size;
+}
+
+// Renders a song to its file; the looper must not be initialized
+static bool render_song(const BatchOptions* options, const char* song) {
+    double start = now_seconds();
+
+    char path[MAX_PATH_LENGTH];
+    char error[512];
+    if(!output_path(options->output_directory, song, path, sizeof(path))) {
+        fprintf(stderr, "%s: output path too long\n", song);
+        return false;
+    }
+
+    looper_set_sample_rate(options->render_rate);
+    looper_set_master_gain(options->master_gain);
+    if(!song_load(song, error, sizeof(error))) {
+        fprintf(stderr, "%s\n", error);
+        return false;
+    }
+
+    uint32_t block_samples = options->render_rate / BLOCKS_PER_SECOND;
+    bool resample = options->output_rate != options->render_rate;
+    if(resample && !resampler_init(options->render_rate, options->output_rate)) {
+        fprintf(stderr, "%s: unsupported output sample rate %u\n", song, options->output_rate);
+        return false;
+    }
+
+    uint32_t output_capacity = resample ? resampler_max_output(block_samples) : block_samples;
+    float* mix_block = (float*)malloc(block_samples * sizeof(float));
+    float* resampled = (float*)malloc(output_capacity * sizeof(float));
+    uint8_t* converted = (uint8_t*)malloc(output_capacity * output_sample_size(options->format));
+    if(!mix_block || !resampled || !converted) {
+        fprintf(stderr, "Error: Memory allocation failed in render_song()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(!wav_open(path, options->output_rate, options->format, options->wav_flags)) {
+        fprintf(stderr, "%s: could not open %s\n", song, path);
+        free(mix_block);
+        free(resampled);
+        free(converted);
+        return false;
+    }
+    bool ok = true;
+
+    uint64_t total_samples = song_length_samples() * options->loops;
+    for(uint64_t rendered = 0; ok && rendered < total_samples;) {
+        uint32_t count = total_samples - rendered < block_samples ? (uint32_t)(total_samples - rendered) : block_samples;
+        looper_render(mix_block, count);
+        rendered += count;
+
+        const float* samples = mix_block;
+        if(resample) {
+            count = resampler_process(mix_block, count, resampled);
+            samples = resampled;
+        }
+
+        output_convert(options->format, samples, count, converted);
+        ok = wav_write(converted, count * output_sample_size(options->format));
+        if(!ok) fprintf(stderr, "%s: could not write %s\n", song, path);
+    }
+
+    if(!wav_close() && ok) {
+        fprintf(stderr, "%s: could not finish writing %s\n", song, path);
+        ok = false;
+    }
+
+    free(mix_block);
+    free(resampled);
+    free(converted);
+    if(resample) resampler_free();
+    if(!ok) return false;
+
+    double elapsed = now_seconds() - start;
+    double audio_seconds = (double)total_samples / options->render_rate;
+    fprintf(stderr, "%s -> %s: %.1f s of audio in %.2f s (%.0fx real time)\n",
+        song, path, audio_seconds, elapsed, elapsed > 0 ? audio_seconds / elapsed : 0);
+    return true;
+}
+
+int batch_run(const BatchOptions* options, char** songs, int count) {
+    double start = now_seconds();
+    int failed = 0;
+
+    #if defined(_WIN32) || defined(_WIN64)
+    for(int i = 0; i < count; i++) {
+        if(!render_song(options, songs[i])) failed++;
+
+        // Reset the singletons for the next song
+        looper_free();
+        envelope_free();
+    }
+    #else
+    long jobs = options->jobs > 0 ? (long)options->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+    if(jobs < 1) jobs = 1;
+
+    pid_t* children = (pid_t*)calloc((size_t)jobs, sizeof(pid_t)); // 0 for a free job
+    const char** child_songs = (const char**)calloc((size_t)jobs, sizeof(const char*));
+    if(!children || !child_songs) {
+        fprintf(stderr, "Error: Memory allocation failed in batch_run()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int next = 0;
+    long running = 0;
+    while(next < count || running > 0) {
+        while(next < count && running < jobs) {
+            long job = 0;
+            while(children[job] != 0) job++;
+
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if(pid == 0) {
+                exit(render_song(options, songs[next]) ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+
+            if(pid < 0) {
+                fprintf(stderr, "%s: could not start a process to render the song\n", songs[next]);
+                failed++;
+            } else {
+                children[job] = pid;
+                child_songs[job] = songs[next];
+                running++;
+            }
+            next++;
+        }
+
+        if(running == 0) continue;
+
+        int status;
+        pid_t pid = wait(&status);
+        if(pid < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+
+        for(long job = 0; job < jobs; job++) {
+            if(children[job] == pid) {
+                children[job] = 0;
+                running--;
+                if(WIFSIGNALED(status)) {
+                    fprintf(stderr, "%s: render killed by signal %d (%s)\n", child_songs[job], WTERMSIG(status), strsignal(WTERMSIG(status)));
+                    failed++;
+                } else if(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                    fprintf(stderr, "%s: render exited with status %d\n", child_songs[job], WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+                    failed++;
+                }
+                break;
+            }
+        }
+    }
+
+    free(children);
+    free(child_songs);
+    #endif
+
+    fprintf(stderr, "Rendered %d of %d songs in %.2f s\n", count - failed, count, now_seconds() - start);
+    return failed;
+}
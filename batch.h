@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * @file batch.h
+ * @brief Header file for the batch renderer, which renders song files offline to WAV files.
+ *
+ * @details Each song (see song.h) is rendered as fast as possible to a WAV file with the same base
+ * name in the output directory, and a line with the render time and throughput of the song is
+ * printed to `stderr` when it is done.
+ *
+ * The looper and the oscillators are singletons, so songs cannot be rendered by several threads of
+ * the same process. On POSIX systems, each song is rendered by its own child process instead, with at
+ * most `jobs` of them running at a time; since songs are only loaded by the processes rendering them,
+ * memory use depends on the number of jobs, not on the number of songs. On Windows, songs are
+ * rendered one at a time.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-25
+ */
+
+#include "output.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Settings of a batch render.
+ */
+typedef struct batch_options {
+    /** The internal sample rate, in Hz. */
+    uint32_t render_rate;
+    /** The sample rate of the files, in Hz. */
+    uint32_t output_rate;
+    /** The format of the samples in the files. */
+    OutputFormat format;
+    /** The master gain of the mix bus. */
+    float master_gain;
+    /** Number of times each loop is rendered. */
+    uint32_t loops;
+    /** Maximum number of songs rendered at the same time, or 0 for the number of CPUs. */
+    uint32_t jobs;
+    /** The directory the files are written to. */
+    const char* output_directory;
+    /** Flags for `wav_open()`. */
+    int wav_flags;
+} BatchOptions;
+
+/**
+ * @brief Renders a list of song files.
+ * @param options The settings of the render.
+ * @param songs The paths of the song files.
+ * @param count The number of songs.
+ * @return The number of songs that could not be rendered.
+ */
+int batch_run(const BatchOptions* options, char** songs, int count);
@@ -0,0 +1,279 @@
+#include "bench.h"
+#include "macros.h"
+#include "square.h"
+#include "sawtooth.h"
+#include "triangle.h"
+#include "noise.h"
+#include "resampler.h"
+#include "output.h"
+#include "effects.h"
+#include "bytebeat.h"
+#include "meters.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SAMPLES 20000000
+#define BENCH_FREQUENCY_CHANGE_SAMPLES 1000 // Samples between frequency changes, to include table switching
+
+// Frequencies cycled through while benchmarking oscillators
+static const uint16_t BENCH_FREQUENCIES[] = { A_2, E_3, A_3, E_4, A_4, E_5, A_5, E_6, A_6 };
+#define BENCH_FREQUENCY_COUNT (sizeof(BENCH_FREQUENCIES) / sizeof(BENCH_FREQUENCIES[0]))
+
+#define BENCH_RESAMPLER_BLOCK (SAMPLE_RATE / 100)
+
+// Output rates benchmarked for the resampler
+static const uint32_t BENCH_OUTPUT_RATES[] = { 22050, 44100, 48000 };
+
+#define BENCH_OUTPUT_BLOCK 1024
+
+// Prevents the compiler from optimizing away the benchmarked code
+static volatile uint32_t bench_sink;
+
+typedef struct oscillator {
+    const char* name;
+    void (*set_frequency)(uint16_t);
+    void (*set_band_limited)(bool);
+    uint8_t (*step)(void);
+} Oscillator;
+
+static const Oscillator OSCILLATORS[] = {
+    { "square", square_set_frequency, square_set_band_limited, square_step },
+    { "sawtooth", sawtooth_set_frequency, sawtooth_set_band_limited, sawtooth_step },
+    { "triangle", triangle_set_frequency, triangle_set_band_limited, triangle_step }
+};
+
+// Returns the average time taken to generate a sample, in nanoseconds
+static double bench_oscillator(const Oscillator* oscillator, bool band_limited) {
+    oscillator->set_band_limited(band_limited);
+
+    uint32_t checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        if(i % BENCH_FREQUENCY_CHANGE_SAMPLES == 0) {
+            oscillator->set_frequency(BENCH_FREQUENCIES[(i / BENCH_FREQUENCY_CHANGE_SAMPLES) % BENCH_FREQUENCY_COUNT]);
+        }
+        checksum += oscillator->step();
+    }
+    clock_t end = clock();
+    bench_sink = checksum;
+
+    oscillator->set_band_limited(false);
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Returns the average time taken to generate a noise sample, in nanoseconds, one at a time or in blocks
+static double bench_noise(NoiseMode mode, uint16_t frequency, bool block) {
+    NoiseGenerator generator;
+    noise_generator_init(&generator, NOISE_DEFAULT_SEED, mode);
+    noise_generator_set_frequency(&generator, frequency, SAMPLE_RATE);
+
+    uint8_t output[BENCH_OUTPUT_BLOCK];
+    uint32_t checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += BENCH_OUTPUT_BLOCK) {
+        if(block) {
+            noise_generator_fill(&generator, output, BENCH_OUTPUT_BLOCK);
+        } else {
+            for(int j = 0; j < BENCH_OUTPUT_BLOCK; j++) output[j] = noise_generator_step(&generator);
+        }
+        checksum += output[BENCH_OUTPUT_BLOCK - 1];
+    }
+    clock_t end = clock();
+    bench_sink = checksum;
+
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Returns the average time taken to resample an input sample, in nanoseconds
+static double bench_resampler(uint32_t output_rate) {
+    if(!resampler_init(SAMPLE_RATE, output_rate)) return 0;
+
+    float input[BENCH_RESAMPLER_BLOCK];
+    float output[BENCH_RESAMPLER_BLOCK * 8];
+    for(int i = 0; i < BENCH_RESAMPLER_BLOCK; i++) {
+        input[i] = (i % 16) / 8.0f - 1.0f;
+    }
+
+    float checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += BENCH_RESAMPLER_BLOCK) {
+        uint32_t count = resampler_process(input, BENCH_RESAMPLER_BLOCK, output);
+        checksum += output[count - 1];
+    }
+    clock_t end = clock();
+    bench_sink = (uint32_t)checksum;
+
+    resampler_free();
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Returns the average time taken to convert a sample from the mix bus to an output format, in nanoseconds
+static double bench_output(OutputFormat format) {
+    float input[BENCH_OUTPUT_BLOCK];
+    uint8_t output[BENCH_OUTPUT_BLOCK * sizeof(float)];
+    for(int i = 0; i < BENCH_OUTPUT_BLOCK; i++) {
+        input[i] = (i % 64) / 32.0f - 1.0f;
+    }
+
+    uint32_t checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += BENCH_OUTPUT_BLOCK) {
+        output_convert(format, input, BENCH_OUTPUT_BLOCK, output);
+        checksum += output[BENCH_OUTPUT_BLOCK * output_sample_size(format) - 1];
+    }
+    clock_t end = clock();
+    bench_sink = checksum;
+
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Returns the average time taken to scale a sample of the mix to float, in nanoseconds, after the effects chain if not empty
+static double bench_effects(void) {
+    int32_t input[BENCH_OUTPUT_BLOCK];
+    int32_t mix[BENCH_OUTPUT_BLOCK];
+    float output[BENCH_OUTPUT_BLOCK];
+    for(int i = 0; i < BENCH_OUTPUT_BLOCK; i++) {
+        input[i] = (i % 64) * 4 - 128;
+    }
+
+    uint32_t checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += BENCH_OUTPUT_BLOCK) {
+        memcpy(mix, input, sizeof(mix)); // Stands in for mixing the channels
+        if(effects_count() > 0) effects_process(mix, BENCH_OUTPUT_BLOCK);
+        for(int j = 0; j < BENCH_OUTPUT_BLOCK; j++) output[j] = mix[j] / 128.0f;
+
+        // Every sample of the block, as integers so that the sum does not add a chain of float additions
+        for(int j = 0; j < BENCH_OUTPUT_BLOCK; j++) {
+            uint32_t bits;
+            memcpy(&bits, &output[j], sizeof(bits));
+            checksum += bits;
+        }
+    }
+    clock_t end = clock();
+    bench_sink = checksum;
+
+    effects_clear();
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Formula benchmarked for the bytebeat evaluator, with shifts, a division and a conditional
+#define BENCH_BYTEBEAT_FORMULA "(t*(t>>5|t>>8)>>(t>>16&7)) + (t&4096 ? t/3 : t>>2)"
+
+// Returns the average time taken to evaluate a bytebeat formula, in nanoseconds, with the scalar interpreter or in blocks
+static double bench_bytebeat(const BytebeatProgram* program, bool block) {
+    uint32_t t[BENCH_OUTPUT_BLOCK];
+    uint8_t output[BENCH_OUTPUT_BLOCK];
+
+    uint32_t checksum = 0;
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += BENCH_OUTPUT_BLOCK) {
+        for(int j = 0; j < BENCH_OUTPUT_BLOCK; j++) t[j] = i + j;
+        if(block) {
+            bytebeat_program_eval(program, t, output, BENCH_OUTPUT_BLOCK);
+        } else {
+            for(int j = 0; j < BENCH_OUTPUT_BLOCK; j++) output[j] = bytebeat_program_eval_one(program, t[j]);
+        }
+        checksum += output[BENCH_OUTPUT_BLOCK - 1];
+    }
+    clock_t end = clock();
+    bench_sink = checksum;
+
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+// Returns the average time taken to measure a sample with a level meter, in nanoseconds, in blocks of `block_size`
+static double bench_meter(uint32_t block_size) {
+    int32_t input[BENCH_OUTPUT_BLOCK];
+    for(int i = 0; i < BENCH_OUTPUT_BLOCK; i++) {
+        input[i] = (i % 64) * 4 - 128;
+    }
+
+    Meter meter;
+    meter_reset(&meter);
+    clock_t start = clock();
+    for(uint32_t i = 0; i < BENCH_SAMPLES; i += block_size) {
+        meter_process(&meter, input + i % (BENCH_OUTPUT_BLOCK - block_size + 1), block_size, 127);
+    }
+    clock_t end = clock();
+    bench_sink = meter.peak + (uint32_t)meter.clipped;
+
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / BENCH_SAMPLES;
+}
+
+static void print_result(const char* name, double ns_per_sample, double baseline_ns_per_sample) {
+    printf("  %-28s %8.2f ns/sample  %6.2fx\n", name, ns_per_sample, ns_per_sample / baseline_ns_per_sample);
+}
+
+void bench_run(void) {
+    printf("Oscillators (%d samples each, relative to naive square_step()):\n", BENCH_SAMPLES);
+
+    double baseline = 0;
+    for(size_t i = 0; i < sizeof(OSCILLATORS) / sizeof(OSCILLATORS[0]); i++) {
+        const Oscillator* oscillator = &OSCILLATORS[i];
+        char name[64];
+
+        double naive = bench_oscillator(oscillator, false);
+        if(i == 0) baseline = naive;
+        snprintf(name, sizeof(name), "%s (naive)", oscillator->name);
+        print_result(name, naive, baseline);
+
+        double band_limited = bench_oscillator(oscillator, true);
+        snprintf(name, sizeof(name), "%s (band-limited)", oscillator->name);
+        print_result(name, band_limited, baseline);
+    }
+
+    printf("Noise (relative to naive square_step()):\n");
+    print_result("long, every sample", bench_noise(NOISE_MODE_LONG, 0, false), baseline);
+    print_result("long, every sample (block)", bench_noise(NOISE_MODE_LONG, 0, true), baseline);
+    print_result("short, 1000 Hz", bench_noise(NOISE_MODE_SHORT, 1000, false), baseline);
+    print_result("short, 1000 Hz (block)", bench_noise(NOISE_MODE_SHORT, 1000, true), baseline);
+
+    printf("Resampler (per input sample, relative to naive square_step()):\n");
+    for(size_t i = 0; i < sizeof(BENCH_OUTPUT_RATES) / sizeof(BENCH_OUTPUT_RATES[0]); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%d Hz -> %u Hz", SAMPLE_RATE, BENCH_OUTPUT_RATES[i]);
+        print_result(name, bench_resampler(BENCH_OUTPUT_RATES[i]), baseline);
+    }
+
+    printf("Output conversion (relative to naive square_step()):\n");
+    print_result("u8", bench_output(OUTPUT_U8), baseline);
+    print_result("s16le", bench_output(OUTPUT_S16LE), baseline);
+    print_result("f32le", bench_output(OUTPUT_F32LE), baseline);
+
+    printf("Bytebeat (relative to naive square_step()):\n");
+    BytebeatProgram program;
+    char error[128];
+    if(bytebeat_program_compile(BENCH_BYTEBEAT_FORMULA, &program, error, sizeof(error))) {
+        print_result("one value at a time (scalar)", bench_bytebeat(&program, false), baseline);
+        char name[64];
+        snprintf(name, sizeof(name), "blocks of %d values", BYTEBEAT_LANES);
+        print_result(name, bench_bytebeat(&program, true), baseline);
+    }
+
+    printf("Meters (relative to naive square_step()):\n");
+    print_result("blocks of 80 samples", bench_meter(80), baseline);
+    print_result("blocks of 256 samples", bench_meter(256), baseline);
+
+    printf("Effects (relative to the dry mix):\n");
+    effects_set_sample_rate(SAMPLE_RATE);
+    double dry = bench_effects();
+    print_result("dry", dry, dry);
+    effects_add_delay(250, 128, 96);
+    print_result("delay", bench_effects(), dry);
+    effects_add_lowpass(2000);
+    print_result("low-pass", bench_effects(), dry);
+    effects_add_bitcrush(4);
+    print_result("bit-crush", bench_effects(), dry);
+    effects_add_downsample(SAMPLE_RATE / 3);
+    print_result("downsample", bench_effects(), dry);
+    effects_add_delay(250, 128, 96);
+    effects_add_lowpass(2000);
+    effects_add_bitcrush(4);
+    effects_add_downsample(SAMPLE_RATE / 3);
+    print_result("all four", bench_effects(), dry);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+ * @file bench.h
+ * @brief Header file for the benchmarks of the audio generation code.
+ *
+ * @details The benchmarks measure the average time taken to generate a sample with each of the
+ * compared code paths, and print the results on `stdout` together with their cost relative to the
+ * baseline of each group. Run them with `cbeat bench`.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-22
+ */
+
+/**
+ * @brief Runs every benchmark and prints the results on `stdout`.
+ */
+void bench_run(void);
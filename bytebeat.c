@@ -0,0 +1,496 @@
+#include "bytebeat.h"
+#include "macros.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NODES 256
+
+// Opcodes; binary opcodes with CONST_RIGHT set take their right operand from the constant whose index follows
+enum opcode {
+    OP_T, OP_CONST,
+    OP_NEG, OP_NOT, OP_LNOT,
+    OP_MUL, OP_DIV, OP_MOD, OP_ADD, OP_SUB, OP_SHL, OP_SHR,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_AND, OP_XOR, OP_OR, OP_LAND, OP_LOR,
+    OP_SELECT
+};
+#define CONST_RIGHT 0x80
+
+// Binary operators by precedence, lowest first, as in C
+static const struct { const char* symbol; uint8_t op; uint8_t precedence; } BINARY_OPERATORS[] = {
+    { "||", OP_LOR, 1 }, { "&&", OP_LAND, 2 }, { "<<", OP_SHL, 8 }, { ">>", OP_SHR, 8 },
+    { "<=", OP_LE, 7 }, { ">=", OP_GE, 7 }, { "==", OP_EQ, 6 }, { "!=", OP_NE, 6 },
+    { "|", OP_OR, 3 }, { "^", OP_XOR, 4 }, { "&", OP_AND, 5 }, { "<", OP_LT, 7 }, { ">", OP_GT, 7 },
+    { "+", OP_ADD, 9 }, { "-", OP_SUB, 9 }, { "*", OP_MUL, 10 }, { "/", OP_DIV, 10 }, { "%", OP_MOD, 10 }
+};
+#define BINARY_OPERATOR_COUNT (sizeof(BINARY_OPERATORS) / sizeof(BINARY_OPERATORS[0]))
+
+// A node of the syntax tree built while parsing
+typedef struct node {
+    uint8_t op;
+    uint32_t value; // OP_CONST
+    int16_t operands[3];
+} Node;
+
+typedef struct parser {
+    const char* formula;
+    const char* position;
+    Node nodes[MAX_NODES];
+    int16_t node_count;
+    BytebeatProgram* program;
+    uint8_t depth; // Stack depth while emitting
+    char* error;
+    size_t error_size;
+    bool failed;
+} Parser;
+
+static uint32_t apply_unary(uint8_t op, uint32_t a) {
+    switch(op) {
+        case OP_NEG: return 0u - a;
+        case OP_NOT: return ~a;
+        default: return !a;
+    }
+}
+
+static uint32_t apply_binary(uint8_t op, uint32_t a, uint32_t b) {
+    switch(op) {
+        case OP_MUL: return a * b;
+        case OP_DIV: return b ? a / b : 0;
+        case OP_MOD: return b ? a % b : 0;
+        case OP_ADD: return a + b;
+        case OP_SUB: return a - b;
+        case OP_SHL: return a << (b & 31);
+        case OP_SHR: return a >> (b & 31);
+        case OP_LT: return a < b;
+        case OP_LE: return a <= b;
+        case OP_GT: return a > b;
+        case OP_GE: return a >= b;
+        case OP_EQ: return a == b;
+        case OP_NE: return a != b;
+        case OP_AND: return a & b;
+        case OP_XOR: return a ^ b;
+        case OP_OR: return a | b;
+        case OP_LAND: return a && b;
+        default: return a || b;
+    }
+}
+
+static int16_t parse_error(Parser* parser, const char* problem) {
+    if(!parser->failed) {
+        if(*parser->position == '\0') {
+            snprintf(parser->error, parser->error_size, "%s at the end of the formula", problem);
+        } else {
+            snprintf(parser->error, parser->error_size, "%s at '%c' (column %d)", problem, *parser->position, (int)(parser->position - parser->formula) + 1);
+        }
+        parser->failed = true;
+    }
+    return -1;
+}
+
+static void skip_spaces(Parser* parser) {
+    while(*parser->position == ' ' || *parser->position == '\t') parser->position++;
+}
+
+// Adds a node, computing it right away if its operands are constants
+static int16_t add_node(Parser* parser, uint8_t op, uint32_t value, int16_t a, int16_t b, int16_t c) {
+    if(parser->failed) return -1;
+
+    Node* nodes = parser->nodes;
+    if(op == OP_SELECT && nodes[a].op == OP_CONST) return nodes[a].value ? b : c;
+    if(op >= OP_NEG && op <= OP_LNOT && nodes[a].op == OP_CONST) {
+        nodes[a].value = apply_unary(op, nodes[a].value);
+        return a;
+    }
+    if(op >= OP_MUL && op <= OP_LOR && nodes[a].op == OP_CONST && nodes[b].op == OP_CONST) {
+        nodes[a].value = apply_binary(op, nodes[a].value, nodes[b].value);
+        return a;
+    }
+
+    // Constants are read directly by binary instructions when they are the right operand
+    bool commutative = op == OP_MUL || op == OP_ADD || (op >= OP_EQ && op <= OP_LOR);
+    if(commutative && nodes[a].op == OP_CONST) {
+        int16_t swapped = a;
+        a = b;
+        b = swapped;
+    }
+
+    if(parser->node_count >= MAX_NODES) return parse_error(parser, "formula too long");
+    Node* node = &nodes[parser->node_count];
+    *node = (Node){ .op = op, .value = value, .operands = { a, b, c } };
+    return parser->node_count++;
+}
+
+static int16_t parse_conditional(Parser* parser);
+
+static int16_t parse_unary(Parser* parser) {
+    skip_spaces(parser);
+    char c = *parser->position;
+
+    if(c == '-' || c == '~' || c == '!' || c == '+') {
+        parser->position++;
+        int16_t operand = parse_unary(parser);
+        if(operand < 0) return -1;
+        if(c == '+') return operand;
+        return add_node(parser, c == '-' ? OP_NEG : c == '~' ? OP_NOT : OP_LNOT, 0, operand, -1, -1);
+    }
+
+    if(c == '(') {
+        parser->position++;
+        int16_t inner = parse_conditional(parser);
+        if(inner < 0) return -1;
+        skip_spaces(parser);
+        if(*parser->position != ')') return parse_error(parser, "expected ')'");
+        parser->position++;
+        return inner;
+    }
+
+    if(c == 't' && !(parser->position[1] >= 'a' && parser->position[1] <= 'z')) {
+        parser->position++;
+        return add_node(parser, OP_T, 0, -1, -1, -1);
+    }
+
+    if(c >= '0' && c <= '9') {
+        bool hex = c == '0' && (parser->position[1] == 'x' || parser->position[1] == 'X');
+        char* end;
+        unsigned long long value = strtoull(parser->position, &end, hex ? 16 : 10);
+        if(value > UINT32_MAX) return parse_error(parser, "number too large");
+        parser->position = end;
+        return add_node(parser, OP_CONST, (uint32_t)value, -1, -1, -1);
+    }
+
+    return parse_error(parser, "unexpected character");
+}
+
+// Parses binary operators of at least the given precedence, by precedence climbing
+static int16_t parse_binary(Parser* parser, uint8_t min_precedence) {
+    int16_t left = parse_unary(parser);
+
+    while(left >= 0) {
+        skip_spaces(parser);
+
+        size_t i;
+        for(i = 0; i < BINARY_OPERATOR_COUNT; i++) {
+            size_t length = strlen(BINARY_OPERATORS[i].symbol);
+            if(strncmp(parser->position, BINARY_OPERATORS[i].symbol, length) == 0) break;
+        }
+        if(i == BINARY_OPERATOR_COUNT || BINARY_OPERATORS[i].precedence < min_precedence) break;
+
+        parser->position += strlen(BINARY_OPERATORS[i].symbol);
+        int16_t right = parse_binary(parser, BINARY_OPERATORS[i].precedence + 1);
+        if(right < 0) return -1;
+        left = add_node(parser, BINARY_OPERATORS[i].op, 0, left, right, -1);
+    }
+
+    return left;
+}
+
+static int16_t parse_conditional(Parser* parser) {
+    int16_t condition = parse_binary(parser, 1);
+    if(condition < 0) return -1;
+
+    skip_spaces(parser);
+    if(*parser->position != '?') return condition;
+    parser->position++;
+
+    int16_t if_true = parse_conditional(parser);
+    if(if_true < 0) return -1;
+    skip_spaces(parser);
+    if(*parser->position != ':') return parse_error(parser, "expected ':'");
+    parser->position++;
+    int16_t if_false = parse_conditional(parser);
+    if(if_false < 0) return -1;
+
+    return add_node(parser, OP_SELECT, 0, condition, if_true, if_false);
+}
+
+static void emit_byte(Parser* parser, uint8_t byte) {
+    if(parser->failed) return;
+    if(parser->program->length >= BYTEBEAT_MAX_CODE) {
+        parse_error(parser, "formula too long");
+        return;
+    }
+    parser->program->code[parser->program->length++] = byte;
+}
+
+static void emit_constant(Parser* parser, uint32_t value) {
+    BytebeatProgram* program = parser->program;
+
+    uint8_t index;
+    for(index = 0; index < program->constant_count; index++) {
+        if(program->constants[index] == value) break;
+    }
+    if(index == program->constant_count) {
+        if(program->constant_count >= BYTEBEAT_MAX_CONSTANTS) {
+            parse_error(parser, "too many constants");
+            return;
+        }
+        program->constants[program->constant_count++] = value;
+    }
+    emit_byte(parser, index);
+}
+
+static void push(Parser* parser, int8_t count) {
+    parser->depth += count;
+    if(parser->depth > parser->program->stack_depth) parser->program->stack_depth = parser->depth;
+    if(parser->depth > BYTEBEAT_MAX_STACK) parse_error(parser, "formula nested too deeply");
+}
+
+// Emits the code evaluating a node, leaving its value on the stack
+static void emit(Parser* parser, int16_t index) {
+    const Node* node = &parser->nodes[index];
+    const Node* right = node->operands[1] >= 0 ? &parser->nodes[node->operands[1]] : NULL;
+
+    switch(node->op) {
+        case OP_T:
+            emit_byte(parser, OP_T);
+            push(parser, 1);
+            break;
+        case OP_CONST:
+            emit_byte(parser, OP_CONST);
+            emit_constant(parser, node->value);
+            push(parser, 1);
+            break;
+        case OP_NEG: case OP_NOT: case OP_LNOT:
+            emit(parser, node->operands[0]);
+            emit_byte(parser, node->op);
+            break;
+        case OP_SELECT:
+            emit(parser, node->operands[0]);
+            emit(parser, node->operands[1]);
+            emit(parser, node->operands[2]);
+            emit_byte(parser, OP_SELECT);
+            push(parser, -2);
+            break;
+        default:
+            emit(parser, node->operands[0]);
+            if(right->op == OP_CONST) {
+                // The constant is read by the instruction rather than pushed
+                emit_byte(parser, node->op | CONST_RIGHT);
+                emit_constant(parser, right->value);
+            } else {
+                emit(parser, node->operands[1]);
+                emit_byte(parser, node->op);
+                push(parser, -1);
+            }
+            break;
+    }
+}
+
+bool bytebeat_program_compile(const char* formula, BytebeatProgram* out, char* error, size_t error_size) {
+    Parser* parser = (Parser*)malloc(sizeof(Parser));
+    if(!parser) {
+        fprintf(stderr, "Error: Memory allocation failed in bytebeat_program_compile()\n");
+        exit(EXIT_FAILURE);
+    }
+    *parser = (Parser){ .formula = formula, .position = formula, .program = out, .error = error, .error_size = error_size };
+    memset(out, 0, sizeof(BytebeatProgram));
+
+    int16_t root = parse_conditional(parser);
+    skip_spaces(parser);
+    if(root >= 0 && *parser->position != '\0') parse_error(parser, "unexpected character");
+    if(!parser->failed) emit(parser, root);
+
+    bool ok = !parser->failed;
+    free(parser);
+    return ok;
+}
+
+// Computes a binary operator for every lane, where `x` is the left operand and `y` the right one
+#define BINARY_CASES(LANES) \
+    case OP_MUL: LANES(x * y); break; \
+    case OP_DIV: LANES(x / (y + (y == 0)) & -(uint32_t)(y != 0)); break; \
+    case OP_MOD: LANES(x % (y + (y == 0)) & -(uint32_t)(y != 0)); break; \
+    case OP_ADD: LANES(x + y); break; \
+    case OP_SUB: LANES(x - y); break; \
+    case OP_SHL: LANES(x << (y & 31)); break; \
+    case OP_SHR: LANES(x >> (y & 31)); break; \
+    case OP_LT: LANES(x < y); break; \
+    case OP_LE: LANES(x <= y); break; \
+    case OP_GT: LANES(x > y); break; \
+    case OP_GE: LANES(x >= y); break; \
+    case OP_EQ: LANES(x == y); break; \
+    case OP_NE: LANES(x != y); break; \
+    case OP_AND: LANES(x & y); break; \
+    case OP_XOR: LANES(x ^ y); break; \
+    case OP_OR: LANES(x | y); break; \
+    case OP_LAND: LANES((x != 0) & (y != 0)); break; \
+    case OP_LOR: LANES((x | y) != 0); break;
+
+// The right operand is the next row of the stack
+#define STACK_LANES(expression) \
+    for(uint32_t l = 0; l < BYTEBEAT_LANES; l++) { uint32_t x = a[l], y = b[l]; a[l] = (expression); }
+
+// The right operand is the same constant for every lane, which allows e.g. shifting every lane at once
+#define CONSTANT_LANES(expression) \
+    for(uint32_t l = 0; l < BYTEBEAT_LANES; l++) { uint32_t x = a[l]; a[l] = (expression); }
+
+// Evaluates a program for BYTEBEAT_LANES values of `t`; every loop has a fixed number of iterations and
+// no branches, so that the compiler turns it into a few vector instructions
+static void eval_lanes(const BytebeatProgram* program, const uint32_t* t, uint8_t* out) {
+    const uint32_t lanes = BYTEBEAT_LANES;
+    uint32_t stack[BYTEBEAT_MAX_STACK][BYTEBEAT_LANES];
+    uint32_t depth = 0;
+
+    const uint8_t* code = program->code;
+    const uint8_t* end = code + program->length;
+    while(code < end) {
+        uint8_t op = *code++;
+
+        if(op == OP_T) {
+            memcpy(stack[depth++], t, lanes * sizeof(uint32_t));
+            continue;
+        }
+        if(op == OP_CONST) {
+            uint32_t value = program->constants[*code++];
+            uint32_t* a = stack[depth++];
+            for(uint32_t l = 0; l < lanes; l++) a[l] = value;
+            continue;
+        }
+        if(op >= OP_NEG && op <= OP_LNOT) {
+            uint32_t* a = stack[depth - 1];
+            if(op == OP_NEG) for(uint32_t l = 0; l < lanes; l++) a[l] = 0u - a[l];
+            else if(op == OP_NOT) for(uint32_t l = 0; l < lanes; l++) a[l] = ~a[l];
+            else for(uint32_t l = 0; l < lanes; l++) a[l] = !a[l];
+            continue;
+        }
+        if(op == OP_SELECT) {
+            uint32_t* c = stack[depth - 3];
+            const uint32_t* x = stack[depth - 2];
+            const uint32_t* y = stack[depth - 1];
+            for(uint32_t l = 0; l < lanes; l++) c[l] = c[l] ? x[l] : y[l];
+            depth -= 2;
+            continue;
+        }
+
+        if(op & CONST_RIGHT) {
+            uint32_t* a = stack[depth - 1];
+            const uint32_t y = program->constants[*code++];
+            switch(op & ~CONST_RIGHT) {
+                BINARY_CASES(CONSTANT_LANES)
+            }
+        } else {
+            depth--;
+            uint32_t* restrict a = stack[depth - 1];
+            const uint32_t* restrict b = stack[depth]; // The next row, never the same as `a`
+            switch(op) {
+                BINARY_CASES(STACK_LANES)
+            }
+        }
+    }
+
+    for(uint32_t l = 0; l < lanes; l++) out[l] = (uint8_t)stack[0][l];
+}
+
+void bytebeat_program_eval(const BytebeatProgram* program, const uint32_t* t, uint8_t* out, uint32_t count) {
+    while(count >= BYTEBEAT_LANES) {
+        eval_lanes(program, t, out);
+        t += BYTEBEAT_LANES;
+        out += BYTEBEAT_LANES;
+        count -= BYTEBEAT_LANES;
+    }
+    if(count == 0) return;
+
+    // The last values, padded to a whole set of lanes
+    uint32_t padded_t[BYTEBEAT_LANES] = { 0 };
+    uint8_t padded_out[BYTEBEAT_LANES];
+    memcpy(padded_t, t, count * sizeof(uint32_t));
+    eval_lanes(program, padded_t, padded_out);
+    memcpy(out, padded_out, count);
+}
+
+uint8_t bytebeat_program_eval_one(const BytebeatProgram* program, uint32_t t) {
+    uint32_t stack[BYTEBEAT_MAX_STACK];
+    uint32_t depth = 0;
+
+    const uint8_t* code = program->code;
+    const uint8_t* end = code + program->length;
+    while(code < end) {
+        uint8_t op = *code++;
+
+        if(op == OP_T) stack[depth++] = t;
+        else if(op == OP_CONST) stack[depth++] = program->constants[*code++];
+        else if(op >= OP_NEG && op <= OP_LNOT) stack[depth - 1] = apply_unary(op, stack[depth - 1]);
+        else if(op == OP_SELECT) {
+            depth -= 2;
+            stack[depth - 1] = stack[depth - 1] ? stack[depth] : stack[depth + 1];
+        } else if(op & CONST_RIGHT) {
+            stack[depth - 1] = apply_binary(op & ~CONST_RIGHT, stack[depth - 1], program->constants[*code++]);
+        } else {
+            depth--;
+            stack[depth - 1] = apply_binary(op, stack[depth - 1], stack[depth]);
+        }
+    }
+
+    return (uint8_t)stack[0];
+}
+
+static BytebeatProgram program;
+static bool has_program = false;
+static uint8_t amplitude = 255;
+static uint32_t rate = BYTEBEAT_DEFAULT_RATE;
+static uint32_t sample_rate = SAMPLE_RATE;
+static uint64_t t_per_sample_q32 = ((uint64_t)BYTEBEAT_DEFAULT_RATE << 32) / SAMPLE_RATE; // Increment of `t` per sample, in Q32
+
+bool bytebeat_set_formula(const char* formula, char* error, size_t error_size) {
+    BytebeatProgram compiled;
+    if(!bytebeat_program_compile(formula, &compiled, error, error_size)) return false;
+
+    program = compiled;
+    has_program = true;
+    return true;
+}
+
+uint8_t bytebeat_amplitude(void) {
+    return amplitude;
+}
+
+void bytebeat_set_amplitude(uint8_t amp) {
+    amplitude = amp;
+}
+
+uint32_t bytebeat_rate(void) {
+    return rate;
+}
+
+void bytebeat_set_rate(uint32_t new_rate) {
+    rate = new_rate;
+    t_per_sample_q32 = ((uint64_t)rate << 32) / sample_rate;
+}
+
+void bytebeat_set_sample_rate(uint32_t new_sample_rate) {
+    sample_rate = new_sample_rate;
+    t_per_sample_q32 = ((uint64_t)rate << 32) / sample_rate;
+}
+
+void bytebeat_fill(const uint32_t* samples, uint8_t* out, uint32_t count) {
+    if(!has_program) {
+        memset(out, 128, count);
+        return;
+    }
+
+    uint32_t t[BYTEBEAT_LANES];
+    uint8_t values[BYTEBEAT_LANES];
+    while(count > 0) {
+        uint32_t lanes = count < BYTEBEAT_LANES ? count : BYTEBEAT_LANES;
+        if(t_per_sample_q32 == (uint64_t)1 << 32) {
+            memcpy(t, samples, lanes * sizeof(uint32_t));
+        } else {
+            for(uint32_t l = 0; l < lanes; l++) t[l] = (uint32_t)((samples[l] * t_per_sample_q32) >> 32);
+        }
+
+        eval_lanes(&program, t, values);
+        for(uint32_t l = 0; l < lanes; l++) {
+            out[l] = amplitude == 255 ? values[l] : apply_amplitude(values[l], amplitude);
+        }
+
+        samples += lanes;
+        out += lanes;
+        count -= lanes;
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+/**
+ * @file bytebeat.h
+ * @brief Header file for the bytebeat channel, which plays a formula of the time `t`.
+ *
+ * @details A bytebeat is a formula such as `t*(t>>5|t>>8)>>(t>>16)`, evaluated for `t` = 0, 1, 2...
+ * at a fixed rate (classically 8000 Hz), whose low 8 bits are the unsigned samples of the sound.
+ * Formulas are evaluated with unsigned 32-bit integers, as in the original C bytebeats, and can use:
+ * - `t`, decimal and hexadecimal (`0x`) constants and parentheses;
+ * - the unary operators `-`, `~` and `!`;
+ * - the binary operators `*`, `/`, `%`, `+`, `-`, `<<`, `>>`, `<`, `<=`, `>`, `>=`, `==`, `!=`, `&`,
+ *   `^`, `|`, `&&` and `||`, with the same precedence as in C;
+ * - the conditional operator `?:`.
+ * Division and remainder by 0 give 0, and shift counts are taken modulo 32.
+ *
+ * A formula is parsed once into a `BytebeatProgram`, a compact stack-based bytecode. The bytecode is
+ * not interpreted one sample at a time: each instruction is applied to `BYTEBEAT_LANES` values of `t`
+ * at once, in loops without branches that the compiler can vectorize, so the cost of decoding the
+ * instructions is shared by all the lanes. Both sides of `?:`, `&&` and `||` are evaluated, which is
+ * only a difference for division by 0, which does not trap.
+ *
+ * `bytebeat_program_*` functions allow independent programs; the other functions drive the channel
+ * played by the looper (see `looper_enable_bytebeat()`), whose `t` counts from the beginning of the
+ * loop at the rate set with `bytebeat_set_rate()`, so it follows seeks and restarts with the loop.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-29
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Number of values of `t` evaluated at once by each instruction.
+ */
+#define BYTEBEAT_LANES 16
+
+/**
+ * @brief Maximum number of bytes of bytecode of a program.
+ */
+#define BYTEBEAT_MAX_CODE 256
+
+/**
+ * @brief Maximum number of distinct constants of a program.
+ */
+#define BYTEBEAT_MAX_CONSTANTS 64
+
+/**
+ * @brief Maximum stack depth of a program, i.e. nesting of its expressions.
+ */
+#define BYTEBEAT_MAX_STACK 32
+
+/**
+ * @brief Rate of `t` of the bytebeat channel until `bytebeat_set_rate()` is called, in Hz.
+ */
+#define BYTEBEAT_DEFAULT_RATE 8000
+
+/**
+ * @brief A compiled formula; all fields are read-only outside of bytebeat.c.
+ */
+typedef struct bytebeat_program {
+    /** The instructions: an opcode per byte, followed by a constant index for constants. */
+    uint8_t code[BYTEBEAT_MAX_CODE];
+    /** The number of bytes of `code`. */
+    uint16_t length;
+    /** The constants used by the code. */
+    uint32_t constants[BYTEBEAT_MAX_CONSTANTS];
+    /** The number of `constants`. */
+    uint8_t constant_count;
+    /** The maximum number of values on the stack during evaluation. */
+    uint8_t stack_depth;
+} BytebeatProgram;
+
+/**
+ * @brief Parses a formula into a program.
+ *
+ * @details Constant subexpressions are computed while parsing, so that e.g. `t*(1<<4)` costs a single
+ * multiplication.
+ *
+ * @param formula The formula, e.g. `t*(t>>5|t>>8)`.
+ * @param out The program; only valid if the function returns true.
+ * @param error Buffer for a description of the error, if the formula is invalid.
+ * @param error_size The size of the error buffer.
+ * @return false if the formula is invalid or too long, true otherwise.
+ */
+bool bytebeat_program_compile(const char* formula, BytebeatProgram* out, char* error, size_t error_size);
+
+/**
+ * @brief Evaluates a program for a block of values of `t`.
+ * @param program The program.
+ * @param t The values of `t`.
+ * @param out The buffer for the low 8 bits of each result.
+ * @param count The number of values.
+ */
+void bytebeat_program_eval(const BytebeatProgram* program, const uint32_t* t, uint8_t* out, uint32_t count);
+
+/**
+ * @brief Evaluates a program for a single value of `t`, one instruction at a time.
+ * @details Gives the same result as `bytebeat_program_eval()`, without the cost of a whole set of lanes;
+ * use it when values are needed one at a time.
+ * @param program The program.
+ * @param t The value of `t`.
+ * @return The low 8 bits of the result.
+ */
+uint8_t bytebeat_program_eval_one(const BytebeatProgram* program, uint32_t t);
+
+/**
+ * @brief Sets the formula played by the bytebeat channel.
+ * @details The channel plays silence (128) until a formula is set.
+ * @return false, leaving the formula unchanged, if the formula is invalid (see `bytebeat_program_compile()`).
+ */
+bool bytebeat_set_formula(const char* formula, char* error, size_t error_size);
+
+/**
+ * @brief Get the amplitude of the bytebeat channel.
+ */
+uint8_t bytebeat_amplitude(void);
+/**
+ * @brief Set the amplitude of the bytebeat channel.
+ * @details The output values will range from -`amplitude`/2 to +`amplitude`/2, centered around 128.
+ * @param amplitude The desired amplitude as an unsigned 8-bit integer.
+ */
+void bytebeat_set_amplitude(uint8_t amplitude);
+
+/**
+ * @brief Get the rate at which `t` counts, in Hz.
+ */
+uint32_t bytebeat_rate(void);
+/**
+ * @brief Set the rate at which `t` counts.
+ * @param rate The rate in Hz; the default is `BYTEBEAT_DEFAULT_RATE`.
+ */
+void bytebeat_set_rate(uint32_t rate);
+
+/**
+ * @brief Set the sample rate of the bytebeat channel.
+ * @param sample_rate The sample rate in Hz; the rate of `t` is kept.
+ */
+void bytebeat_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * @brief Get the values of the bytebeat channel at a block of positions.
+ * @param samples The positions, in samples since the beginning of the loop.
+ * @param out The buffer to write the samples to.
+ * @param count The number of samples to generate.
+ */
+void bytebeat_fill(const uint32_t* samples, uint8_t* out, uint32_t count);
@@ -1 +1 @@
-gcc -o out/win/cbeat main.c looper.c square.c sawtooth.c triangle.c noise.c custom.c utils.c composer.c
+gcc -o out/win/cbeat main.c looper.c square.c sawtooth.c triangle.c noise.c custom.c utils.c composer.c envelope.c timeline.c bandlimited.c bench.c resampler.c output.c wav.c writer.c shmring.c server.c song.c batch.c arena.c samples.c effects.c bytebeat.c trace.c realtime.c meters.c -lm
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include "composer.h"
 #include "utils.h"
 #include "macros.h"
+#include "timeline.h"
+#include "trace.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 
 static const uint16_t NOTES[] = {
     C_0, CSHARP_0, D_0, DSHARP_0, E_0, F_0, FSHARP_0, G_0, GSHARP_0, A_0, ASHARP_0, B_0,
@@ -18,40 +21,25 @@ static const uint16_t NOTES[] = {
     C_8, CSHARP_8, D_8, DSHARP_8, E_8, F_8, FSHARP_8, G_8, GSHARP_8, A_8, ASHARP_8, B_8
 };
 
-uint8_t apply_envelope(Envelope envelope, uint8_t volume, uint32_t sample) {
-    if(sample > 0xFFFF) sample = 0xFFFF;
-
-    uint8_t min_volume;
-    uint32_t decay_length;
-
-    switch(envelope) {
-        case CONSTANT:
-            return volume;
-        case DECAY_SLOW:
-            min_volume = volume / DECAY_VOLUME_FACTOR;
-            decay_length = DECAY_SLOW_SAMPLES;
-            break;
-        case DECAY_MEDIUM:
-            min_volume = volume / DECAY_VOLUME_FACTOR;
-            decay_length = DECAY_MEDIUM_SAMPLES;
-            break;
-        case DECAY_FAST:
-            min_volume = volume / DECAY_VOLUME_FACTOR;
-            decay_length = DECAY_FAST_SAMPLES;
-            break;
-        case HIT:
-            min_volume = volume / HIT_VOLUME_FACTOR;
-            decay_length = HIT_SAMPLES;
-            break;
-        default:
-            return volume;
+// Fills `out_curve` with the volume at each of the first `count` sixteenth boundaries of a note
+static void compute_envelope_curve(Envelope envelope, uint8_t volume, uint8_t* out_curve, int count) {
+    if(envelope_is_render_time(envelope)) {
+        // Applied by the looper while rendering
+        memset(out_curve, volume, count);
+        return;
     }
 
-    // Note: the function already clamps position to [0, length]
-    if(envelope == HIT) {
-        return quadratic_interpolate_8(volume, min_volume, sample, decay_length);
-    } else {
-        return linear_interpolate_8(volume, min_volume, sample, decay_length);
+    uint16_t table_length;
+    const uint16_t* gains = envelope_table(envelope, looper_samples_per_sixteenth(), &table_length);
+
+    if(!gains) {
+        // Unknown envelope: keep the volume constant
+        memset(out_curve, volume, count);
+        return;
+    }
+
+    for(int i = 0; i < count; i++) {
+        out_curve[i] = envelope_apply_gain(volume, gains[i < table_length ? i : table_length - 1]);
     }
 }
 
@@ -71,26 +59,105 @@ uint16_t composer_get_frequency(int note_index) {
     return NOTES[note_index];
 }
 
-void composer_set_note(
+// Phrases are written to the looper in chunks of this many sixteenths
+#define PHRASE_CHUNK_SIXTEENTHS 64
+
+void composer_set_phrase(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth,
+    uint8_t volume, Envelope envelope,
+    const ComposerNote* notes, int count
+){
+    if(count <= 0) return;
+
+    TRACE_BEGIN("composer_set_phrase");
+
+    uint16_t max_length = 0;
+    for(int n = 0; n < count; n++) {
+        if(notes[n].length_sixteenths > max_length) max_length = notes[n].length_sixteenths;
+    }
+
+    // Volume at each sixteenth boundary of a note, shared by every note in the phrase
+    uint8_t envelope_curve[max_length + 1];
+    compute_envelope_curve(envelope, volume, envelope_curve, max_length + 1);
+
+    uint8_t render_envelope = envelope_render_id(envelope);
+
+    NoteAttributes chunk[PHRASE_CHUNK_SIXTEENTHS];
+    int chunk_length = 0;
+    uint16_t chunk_start = (start_beat * 4) + start_sixteenth;
+
+    for(int n = 0; n < count; n++) {
+        const ComposerNote* note = &notes[n];
+        bool staccato = note->flags & COMPOSER_NOTE_STACCATO;
+        bool is_slide = note->frequency_start != note->frequency_end;
+
+        for(int i = 0; i < note->length_sixteenths; i++) {
+            NoteAttributes* attrs = &chunk[chunk_length];
+
+            if(note->flags & COMPOSER_NOTE_REST) {
+                *attrs = (NoteAttributes){ .flags = 0 };
+            } else {
+                attrs->flags = 1 + (staccato && i == note->length_sixteenths - 1 ? 2 : 0) + (note->flags & COMPOSER_NOTE_DOUBLES ? 4 : 0) + (i == 0 ? 8 : 0);
+                attrs->envelope = render_envelope;
+                if(is_slide) {
+                    attrs->frequency_start = linear_interpolate_16_short(note->frequency_start, note->frequency_end, i, note->length_sixteenths);
+                    attrs->frequency_end = linear_interpolate_16_short(note->frequency_start, note->frequency_end, i + 1, note->length_sixteenths);
+                } else {
+                    attrs->frequency_start = note->frequency_start;
+                    attrs->frequency_end = note->frequency_start;
+                }
+                attrs->volume_start = envelope_curve[i];
+                attrs->volume_end = envelope_curve[i + 1];
+            }
+
+            if(++chunk_length == PHRASE_CHUNK_SIXTEENTHS) {
+                looper_set_notes(chunk_start, chunk_length, channel, chunk);
+                chunk_start += chunk_length;
+                chunk_length = 0;
+            }
+        }
+    }
+
+    if(chunk_length > 0) looper_set_notes(chunk_start, chunk_length, channel, chunk);
+
+    TRACE_END("composer_set_phrase");
+}
+
+void composer_set_frequencies(
     Channel channel,
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
     uint8_t volume, Envelope envelope, bool staccato, bool doubles,
-    uint16_t frequency
+    const uint16_t* frequencies, int count
 ){
-    for(int i = 0; i < length_sixteenths; i++) {
-        uint16_t sixteenth = (start_beat * 4) + start_sixteenth + i;
-        uint32_t sample_in_note = (uint32_t)looper_samples_per_sixteenth() * i;
-        
-        NoteAttributes attrs = {
-            .flags = 1 + (staccato && i == length_sixteenths - 1 ? 2 : 0) + (doubles ? 4 : 0),
-            .frequency_start = frequency,
-            .frequency_end = frequency,
-            .volume_start = apply_envelope(envelope, volume, sample_in_note),
-            .volume_end = apply_envelope(envelope, volume, sample_in_note + looper_samples_per_sixteenth())
-        };
+    if(count <= 0) return;
 
-        looper_set_note(sixteenth, channel, attrs);
+    uint8_t flags = (staccato ? COMPOSER_NOTE_STACCATO : 0) | (doubles ? COMPOSER_NOTE_DOUBLES : 0);
+    ComposerNote phrase[count];
+    for(int i = 0; i < count; i++) {
+        phrase[i] = (ComposerNote){
+            .frequency_start = frequencies[i],
+            .frequency_end = frequencies[i],
+            .length_sixteenths = length_sixteenths,
+            .flags = flags
+        };
     }
+
+    composer_set_phrase(channel, start_beat, start_sixteenth, volume, envelope, phrase, count);
+}
+
+void composer_set_note(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
+    uint8_t volume, Envelope envelope, bool staccato, bool doubles,
+    uint16_t frequency
+){
+    composer_set_frequencies(
+        channel,
+        start_beat, start_sixteenth, length_sixteenths,
+        volume, envelope, staccato, doubles,
+        &frequency, 1
+    );
 }
 
 void composer_set_notes(
@@ -99,25 +166,23 @@ void composer_set_notes(
     uint8_t volume, Envelope envelope, bool staccato, bool doubles,
     int count, ... // Variable number of frequency (uint16_t)
 ){
+    if(count <= 0) return;
+
+    uint16_t frequencies[count];
+
     va_list args;
     va_start(args, count);
-
     for(int i = 0; i < count; i++) {
-        uint16_t frequency = va_arg(args, int);
-
-        uint16_t total_sixteenth = (start_beat * 4) + start_sixteenth + (i * length_sixteenths);
-        uint16_t beat = total_sixteenth / 4;
-        uint16_t sixteenth = total_sixteenth % 4;
-
-        composer_set_note(
-            channel,
-            beat, sixteenth, length_sixteenths,
-            volume, envelope, staccato, doubles,
-            frequency
-        );
+        frequencies[i] = va_arg(args, int);
     }
-
     va_end(args);
+
+    composer_set_frequencies(
+        channel,
+        start_beat, start_sixteenth, length_sixteenths,
+        volume, envelope, staccato, doubles,
+        frequencies, count
+    );
 }
 
 void composer_set_slide(
@@ -126,22 +191,14 @@ void composer_set_slide(
     uint8_t volume, Envelope envelope, bool staccato, bool doubles,
     uint16_t frequency_start, uint16_t frequency_end
 ){
-    uint32_t length_samples = (uint32_t)looper_samples_per_sixteenth() * (uint32_t)length_sixteenths;
-
-    for(int i = 0; i < length_sixteenths; i++) {
-        uint16_t sixteenth = (start_beat * 4) + start_sixteenth + i;
-        uint32_t sample_in_note = (uint32_t)looper_samples_per_sixteenth() * i;
-        
-        NoteAttributes attrs = {
-            .flags = 1 + (staccato && i == length_sixteenths - 1 ? 2 : 0) + (doubles ? 4 : 0),
-            .frequency_start = linear_interpolate_16(frequency_start, frequency_end, sample_in_note, length_samples),
-            .frequency_end = linear_interpolate_16(frequency_start, frequency_end, sample_in_note + looper_samples_per_sixteenth(), length_samples),
-            .volume_start = apply_envelope(envelope, volume, sample_in_note),
-            .volume_end = apply_envelope(envelope, volume, sample_in_note + looper_samples_per_sixteenth())
-        };
-
-        looper_set_note(sixteenth, channel, attrs);
-    }
+    ComposerNote note = {
+        .frequency_start = frequency_start,
+        .frequency_end = frequency_end,
+        .length_sixteenths = length_sixteenths,
+        .flags = (staccato ? COMPOSER_NOTE_STACCATO : 0) | (doubles ? COMPOSER_NOTE_DOUBLES : 0)
+    };
+
+    composer_set_phrase(channel, start_beat, start_sixteenth, volume, envelope, &note, 1);
 }
 
 void composer_set_slides(
@@ -150,32 +207,77 @@ void composer_set_slides(
     uint8_t volume, Envelope envelope, bool staccato, bool doubles,
     int count, ... // Variable number of frequency pairs (uint16_t frequency_start, uint16_t frequency_end)
 ){
+    if(count <= 0) return;
+
+    uint8_t flags = (staccato ? COMPOSER_NOTE_STACCATO : 0) | (doubles ? COMPOSER_NOTE_DOUBLES : 0);
+    ComposerNote phrase[count];
+
     va_list args;
-    va_start(args, count * 2);
+    va_start(args, count);
+    for(int i = 0; i < count; i++) {
+        phrase[i].frequency_start = va_arg(args, int);
+        phrase[i].frequency_end = va_arg(args, int);
+        phrase[i].length_sixteenths = length_sixteenths;
+        phrase[i].flags = flags;
+    }
+    va_end(args);
+
+    composer_set_phrase(channel, start_beat, start_sixteenth, volume, envelope, phrase, count);
+}
+
+// Returns the tick at which the given sixteenth starts
+static uint32_t sixteenth_to_tick(uint16_t start_beat, uint16_t start_sixteenth) {
+    return ((uint32_t)start_beat * 4 + start_sixteenth) * timeline_ppqn() / 4;
+}
+
+bool composer_set_tuplet(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
+    uint8_t volume, Envelope envelope, bool staccato,
+    const uint16_t* frequencies, int count
+){
+    if(timeline_ppqn() == 0 || count <= 0) return false;
+
+    composer_set_rest(channel, start_beat, start_sixteenth, length_sixteenths);
+
+    uint32_t start_tick = sixteenth_to_tick(start_beat, start_sixteenth);
+    uint32_t length_ticks = (uint32_t)length_sixteenths * timeline_ppqn() / 4;
 
     for(int i = 0; i < count; i++) {
-        uint16_t frequency_start = va_arg(args, int);
-        uint16_t frequency_end = va_arg(args, int);
-
-        uint16_t total_sixteenth = (start_beat * 4) + start_sixteenth + (i * length_sixteenths);
-        uint16_t beat = total_sixteenth / 4;
-        uint16_t sixteenth = total_sixteenth % 4;
-
-        composer_set_slide(
-            channel,
-            beat, sixteenth, length_sixteenths,
-            volume, envelope, staccato, doubles,
-            frequency_start, frequency_end
-        );
+        uint32_t note_start = start_tick + length_ticks * i / count;
+        uint32_t note_length = start_tick + length_ticks * (i + 1) / count - note_start;
+        // Same gap as the staccato flag in the grid
+        if(staccato) note_length = note_length * 7 / 8;
+
+        if(!looper_add_timeline_note(channel, note_start, note_length, frequencies[i], volume, envelope_render_id(envelope))) {
+            return false;
+        }
     }
 
-    va_end(args);
+    return true;
+}
+
+bool composer_set_tick_note(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, int32_t offset_ticks, uint32_t length_ticks,
+    uint8_t volume, Envelope envelope,
+    uint16_t frequency
+){
+    if(timeline_ppqn() == 0) return false;
+
+    int64_t tick = (int64_t)sixteenth_to_tick(start_beat, start_sixteenth) + offset_ticks;
+    if(tick < 0) tick += timeline_length_ticks(); // Wrap around to the end of the loop
+    if(tick < 0) return false;
+
+    return looper_add_timeline_note(channel, (uint32_t)tick, length_ticks, frequency, volume, envelope_render_id(envelope));
 }
 
 void composer_set_rest(
     Channel channel,
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths
 ){
+    TRACE_BEGIN("composer_set_rest");
+
     for(int i = 0; i < length_sixteenths; i++) {
         uint16_t sixteenth = (start_beat * 4) + start_sixteenth + i;
         
@@ -185,6 +287,8 @@ void composer_set_rest(
 
         looper_set_note(sixteenth, channel, attrs);
     }
+
+    TRACE_END("composer_set_rest");
 }
 
 void composer_set_rests(
@@ -206,6 +310,11 @@ void composer_set_glissando(
     uint8_t volume, Envelope envelope, bool staccato, bool doubles,
     int start_note_index, int note_index_step
 ){
+    TRACE_BEGIN("composer_set_glissando");
+
+    uint8_t envelope_curve[2];
+    compute_envelope_curve(envelope, volume, envelope_curve, 2);
+
     for(int i = 0; i < length_sixteenths; i++) {
         uint16_t sixteenth = (start_beat * 4) + start_sixteenth + i;
         uint16_t start_freqency, end_freqency;
@@ -218,15 +327,18 @@ void composer_set_glissando(
         }
         
         NoteAttributes attrs = {
-            .flags = 1 + (staccato && i == length_sixteenths - 1 ? 2 : 0) + (doubles ? 4 : 0),
+            .flags = 1 + (staccato && i == length_sixteenths - 1 ? 2 : 0) + (doubles ? 4 : 0) + 8,
+            .envelope = envelope_render_id(envelope),
             .frequency_start = start_freqency,
             .frequency_end = end_freqency,
-            .volume_start = apply_envelope(envelope, volume, 0),
-            .volume_end = apply_envelope(envelope, volume, looper_samples_per_sixteenth())
+            .volume_start = envelope_curve[0],
+            .volume_end = envelope_curve[1]
         };
 
         looper_set_note(sixteenth, channel, attrs);
     }
+
+    TRACE_END("composer_set_glissando");
 }
 
 void composer_apply_dynamics(
@@ -234,6 +346,8 @@ void composer_apply_dynamics(
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
     uint8_t start_volume_factor, uint8_t end_volume_factor
 ){
+    TRACE_BEGIN("composer_apply_dynamics");
+
     NoteAttributes attrs_array[length_sixteenths];
     int count = looper_read_notes((start_beat * 4) + start_sixteenth, length_sixteenths, channel, attrs_array);
 
@@ -248,6 +362,8 @@ void composer_apply_dynamics(
         channel,
         attrs_array
     );
+
+    TRACE_END("composer_apply_dynamics");
 }
 
 void composer_copy_section(
@@ -255,14 +371,15 @@ void composer_copy_section(
     Channel dest_channel, uint16_t dest_start_beat, uint16_t dest_start_sixteenth,
     uint16_t length_sixteenths
 ){
-    NoteAttributes attrs_array[length_sixteenths];
-    int count = looper_read_notes((src_start_beat * 4) + src_start_sixteenth, length_sixteenths, src_channel, attrs_array);
-    looper_set_notes(
-        (dest_start_beat * 4) + dest_start_sixteenth,
-        count,
-        dest_channel,
-        attrs_array
+    TRACE_BEGIN("composer_copy_section");
+
+    looper_copy_notes(
+        src_channel, (src_start_beat * 4) + src_start_sixteenth,
+        dest_channel, (dest_start_beat * 4) + dest_start_sixteenth,
+        length_sixteenths
     );
+
+    TRACE_END("composer_copy_section");
 }
 
 // Note: will round notes that are not exactly on a semitone to the next semitone
@@ -271,6 +388,8 @@ void composer_shift_semitones(
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
     int semitone_shift
 ){
+    TRACE_BEGIN("composer_shift_semitones");
+
     NoteAttributes attrs_array[length_sixteenths];
     int count = looper_read_notes((start_beat * 4) + start_sixteenth, length_sixteenths, channel, attrs_array);
 
@@ -285,6 +404,8 @@ void composer_shift_semitones(
         channel,
         attrs_array
     );
+
+    TRACE_END("composer_shift_semitones");
 }
 
 void composer_shift_octaves(
@@ -294,6 +415,8 @@ void composer_shift_octaves(
 ){
     if(octave_shift == 0) return;
 
+    TRACE_BEGIN("composer_shift_octaves");
+
     NoteAttributes attrs_array[length_sixteenths];
     int count = looper_read_notes((start_beat * 4) + start_sixteenth, length_sixteenths, channel, attrs_array);
 
@@ -313,4 +436,6 @@ void composer_shift_octaves(
         channel,
         attrs_array
     );
+
+    TRACE_END("composer_shift_octaves");
 }
\ No newline at end of file
@@ -10,24 +10,29 @@
  // TODO: Documentation
 
 #include "looper.h"
+#include "envelope.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
 
-#define DECAY_VOLUME_FACTOR 4
-#define HIT_VOLUME_FACTOR 4
-#define DECAY_SLOW_SAMPLES 32000
-#define DECAY_MEDIUM_SAMPLES 16000
-#define DECAY_FAST_SAMPLES 8000
-#define HIT_SAMPLES 4000
-
-typedef enum envelope {
-    CONSTANT,
-    DECAY_SLOW,
-    DECAY_MEDIUM,
-    DECAY_FAST,
-    HIT
-} Envelope;
+// Flags for `ComposerNote`
+#define COMPOSER_NOTE_STACCATO 0x01
+#define COMPOSER_NOTE_DOUBLES 0x02
+#define COMPOSER_NOTE_REST 0x04
+
+/**
+ * @brief A single note of a phrase passed to `composer_set_phrase()`.
+ */
+typedef struct composer_note {
+    /** The starting frequency of the note in Hz. */
+    uint16_t frequency_start;
+    /** The ending frequency of the note in Hz; equal to `frequency_start` for a plain note. */
+    uint16_t frequency_end;
+    /** The length of the note in sixteenths. */
+    uint16_t length_sixteenths;
+    /** Bitmask of `COMPOSER_NOTE_*` flags. */
+    uint8_t flags;
+} ComposerNote;
 
 // Only used for glissando and semitone shift
 int composer_get_note_index(uint16_t frequency);
@@ -47,6 +52,34 @@ void composer_set_notes(
     int count, ... // Variable number of frequency (uint16_t)
 );
 
+/**
+ * @brief Sets a whole phrase of consecutive notes, starting at the given position.
+ *
+ * @details Equivalent to calling `composer_set_slide()` (or `composer_set_rest()`) for each note
+ * in order, but the envelope curve is computed only once for the whole phrase and the notes are
+ * written to the looper in bulk.
+ *
+ * @param notes Array of `count` notes; each one starts where the previous one ends.
+ */
+void composer_set_phrase(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth,
+    uint8_t volume, Envelope envelope,
+    const ComposerNote* notes, int count
+);
+
+/**
+ * @brief Array-based version of `composer_set_notes()`.
+ *
+ * @param frequencies Array of `count` frequencies, each played for `length_sixteenths`.
+ */
+void composer_set_frequencies(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
+    uint8_t volume, Envelope envelope, bool staccato, bool doubles,
+    const uint16_t* frequencies, int count
+);
+
 void composer_set_slide(
     Channel channel,
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
@@ -61,6 +94,45 @@ void composer_set_slides(
     int count, ... // Variable number of frequency pairs (uint16_t frequency_start, uint16_t frequency_end)
 );
 
+/**
+ * @brief Plays `count` notes of equal length in the space of `length_sixteenths` (e.g. triplets).
+ *
+ * @details The notes are added to the looper's timeline, which must be enabled with
+ * `looper_enable_timeline()`; the grid is set to pauses over the same range.
+ * Table envelopes are not applied to timeline notes, only render-time envelopes.
+ * Each note must be shorter than the loop, so a single note cannot span the whole loop.
+ *
+ * @param frequencies Array of `count` frequencies.
+ * @return false if the timeline is not enabled or the notes are out of bounds or as long as the loop,
+ * true otherwise.
+ */
+bool composer_set_tuplet(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths,
+    uint8_t volume, Envelope envelope, bool staccato,
+    const uint16_t* frequencies, int count
+);
+
+/**
+ * @brief Plays a single note positioned in ticks relative to a sixteenth (e.g. grace notes or swing).
+ *
+ * @details The note is added to the looper's timeline, which must be enabled with
+ * `looper_enable_timeline()`. It is only heard where the grid is silent.
+ * Table envelopes are not applied to timeline notes, only render-time envelopes.
+ *
+ * @param offset_ticks The offset of the note from the start of the sixteenth, in ticks; can be negative.
+ * @param length_ticks The length of the note in ticks, less than the length of the loop (see
+ * `timeline_length_ticks()`).
+ * @return false if the timeline is not enabled, the note is out of bounds or it is as long as the loop,
+ * true otherwise.
+ */
+bool composer_set_tick_note(
+    Channel channel,
+    uint16_t start_beat, uint16_t start_sixteenth, int32_t offset_ticks, uint32_t length_ticks,
+    uint8_t volume, Envelope envelope,
+    uint16_t frequency
+);
+
 void composer_set_rest(
     Channel channel,
     uint16_t start_beat, uint16_t start_sixteenth, uint16_t length_sixteenths
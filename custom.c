@@ -3,30 +3,136 @@
 #include "utils.h"
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-static uint16_t current_sample = 0;
+static uint32_t sample_rate = SAMPLE_RATE;
+static uint32_t current_sample = 0;
 
-static uint8_t* audio_data = NULL;
-static uint16_t audio_data_length = 0;
+// Wavetables of the bank, borrowed from the caller except for the data copied by custom_set_data()
+typedef struct wavetable {
+    const uint8_t* data;
+    uint32_t length;
+} Wavetable;
+
+static Wavetable bank[CUSTOM_MAX_WAVETABLES];
+
+// The selected wavetable
+static uint8_t selected = 0;
+static const uint8_t* audio_data = NULL;
+static uint32_t audio_data_length = 0;
+static uint64_t index_scale = 0; // Converts the phase to a position in audio_data, in Q16 fixed point
+static bool interpolated = false;
+
+// Data copied by custom_set_data()
+static uint8_t* copied_data = NULL;
+static uint16_t copied_data_length = 0;
+static bool owns_copied_data = false; // Whether copied_data was allocated by custom_set_data()
+
+static uint8_t* storage = NULL; // Set by custom_set_storage(), NULL to allocate the data
+static uint32_t storage_capacity = 0;
 
 static uint16_t samples_per_step = 1;
 static uint8_t amplitude = 255;
 
-void custom_set_data(const uint8_t* data, uint16_t length) {
-    audio_data_length = length;
-    audio_data = (uint8_t*)malloc(SAMPLE_RATE * sizeof(uint8_t));
+// Reloads the selected wavetable, after it or the sample rate changed
+static void load_selected(void) {
+    audio_data = bank[selected].data;
+    audio_data_length = bank[selected].length;
+    index_scale = ((uint64_t)audio_data_length << 16) / sample_rate;
+}
+
+bool custom_bank_set(uint8_t index, const uint8_t* data, uint32_t length) {
+    if(index >= CUSTOM_MAX_WAVETABLES || (data && length == 0)) return false;
+
+    bank[index] = data ? (Wavetable){ .data = data, .length = length } : (Wavetable){ .data = NULL, .length = 0 };
+    if(index == selected) load_selected();
+    return true;
+}
+
+const uint8_t* custom_bank_get(uint8_t index, uint32_t* out_length) {
+    if(index >= CUSTOM_MAX_WAVETABLES || !bank[index].data) return NULL;
+    if(out_length) *out_length = bank[index].length;
+    return bank[index].data;
+}
+
+void custom_bank_clear(void) {
+    for(int i = 0; i < CUSTOM_MAX_WAVETABLES; i++) {
+        if(bank[i].data != copied_data) bank[i] = (Wavetable){ .data = NULL, .length = 0 };
+    }
+    load_selected();
+}
+
+bool custom_select(uint8_t index) {
+    if(index >= CUSTOM_MAX_WAVETABLES) return false;
+    if(index == selected) return true;
+
+    selected = index;
+    load_selected();
+    return true;
+}
+
+uint8_t custom_selected(void) {
+    return selected;
+}
+
+bool custom_interpolated(void) {
+    return interpolated;
+}
+
+void custom_set_interpolated(bool enabled) {
+    interpolated = enabled;
+}
+
+void custom_set_storage(uint8_t* buffer, uint32_t capacity) {
+    custom_free();
+    storage = buffer;
+    storage_capacity = buffer ? capacity : 0;
+}
+
+bool custom_set_data(const uint8_t* data, uint16_t length) {
+    if(storage) {
+        if(length > storage_capacity) return false;
+        custom_free();
+        copied_data = storage;
+    } else {
+        custom_free();
+        copied_data = (uint8_t*)malloc(length * sizeof(uint8_t));
+        owns_copied_data = true;
 
-    // Terminate the program if memory allocation fails
-    if(!audio_data) {
-        fprintf(stderr, "Error: Memory allocation failed in custom_set_data()\n");
-        exit(1);
+        // Terminate the program if memory allocation fails
+        if(!copied_data) {
+            fprintf(stderr, "Error: Memory allocation failed in custom_set_data()\n");
+            exit(1);
+        }
     }
+    copied_data_length = length;
 
     for (int i = 0; i < length; i++) {
-        audio_data[i] = data[i];
+        copied_data[i] = data[i];
+    }
+
+    bank[0] = (Wavetable){ .data = copied_data, .length = length };
+    selected = 0;
+    load_selected();
+    return true;
+}
+
+void custom_free(void) {
+    for(int i = 0; copied_data && i < CUSTOM_MAX_WAVETABLES; i++) {
+        if(bank[i].data == copied_data) bank[i] = (Wavetable){ .data = NULL, .length = 0 };
     }
+    if(copied_data && owns_copied_data) free(copied_data);
+    copied_data = NULL;
+    owns_copied_data = false;
+    copied_data_length = 0;
+    load_selected();
+}
+
+uint16_t custom_data_length(void) {
+    return copied_data_length;
 }
 
 uint16_t custom_frequency(void) {
@@ -45,13 +151,70 @@ void custom_set_amplitude(uint8_t amp) {
     amplitude = amp;
 }
 
+uint32_t custom_sample_rate(void) {
+    return sample_rate;
+}
+
+void custom_set_sample_rate(uint32_t rate) {
+    sample_rate = rate;
+    current_sample %= sample_rate;
+    load_selected();
+}
+
+// Reads the selected wavetable at a position in Q16 fixed point, interpolating linearly if enabled
+static inline uint8_t read_wavetable(uint64_t position) {
+    uint32_t index = (uint32_t)(position >> 16);
+    if(!interpolated) return audio_data[index];
+
+    uint32_t next = index + 1 < audio_data_length ? index + 1 : 0;
+    int32_t fraction = (int32_t)(position & 0xFFFF);
+    return (uint8_t)(audio_data[index] + (((int32_t)audio_data[next] - audio_data[index]) * fraction >> 16));
+}
+
 uint8_t custom_step(void) {
-    if (samples_per_step == 0) {
-        return 128; // No sound if samples per cycle is zero
+    if (samples_per_step == 0 || audio_data_length == 0) {
+        return 128; // No sound if samples per cycle is zero or there is no data
     }
 
-    uint8_t output = apply_amplitude(audio_data[current_sample], amplitude);
-    current_sample = (current_sample + samples_per_step) % SAMPLE_RATE;
+    // The phase goes from 0 to sample_rate - 1, so the index is always less than audio_data_length
+    uint8_t output = apply_amplitude(read_wavetable(current_sample * index_scale), amplitude);
+    current_sample = advance_phase(current_sample, samples_per_step, sample_rate);
 
     return output;
-}
\ No newline at end of file
+}
+
+#define FILL_CHUNK 64
+
+void custom_fill(uint8_t* out, uint32_t count) {
+    if (samples_per_step == 0 || audio_data_length == 0) {
+        memset(out, 128, count);
+        return;
+    }
+
+    // The phases are a serial dependency, but reading and interpolating a chunk of them is not
+    uint32_t indices[FILL_CHUNK];
+    uint32_t next_indices[FILL_CHUNK];
+    int32_t fractions[FILL_CHUNK];
+
+    while(count > 0) {
+        uint32_t chunk = count < FILL_CHUNK ? count : FILL_CHUNK;
+
+        for(uint32_t i = 0; i < chunk; i++) {
+            uint64_t position = current_sample * index_scale;
+            indices[i] = (uint32_t)(position >> 16);
+            fractions[i] = interpolated ? (int32_t)(position & 0xFFFF) : 0;
+            current_sample = advance_phase(current_sample, samples_per_step, sample_rate);
+        }
+        for(uint32_t i = 0; i < chunk; i++) {
+            next_indices[i] = indices[i] + 1 < audio_data_length ? indices[i] + 1 : 0;
+        }
+        for(uint32_t i = 0; i < chunk; i++) {
+            int32_t current = audio_data[indices[i]];
+            int32_t value = current + (((int32_t)audio_data[next_indices[i]] - current) * fractions[i] >> 16);
+            out[i] = apply_amplitude((uint8_t)value, amplitude);
+        }
+
+        out += chunk;
+        count -= chunk;
+    }
+}
@@ -5,41 +5,117 @@
  * @brief Header file for custom waveform generator functions.
  * 
  * @details This module provides functions to generate a wave signal based on user-defined data
- * as an unsigned 8-bit integer output. Use the `custom_set_data` function to allocate memory and
- * set the waveform data, and the `custom_free` function to free the allocated memory.
+ * as an unsigned 8-bit integer output. The data comes from a bank of up to `CUSTOM_MAX_WAVETABLES`
+ * wavetables, one of which is selected at a time with `custom_select`; the looper selects them as
+ * the loop plays (see `looper_set_wavetable()`). Wavetables are borrowed, not copied: register them
+ * with `custom_bank_set`, e.g. from static arrays or memory-mapped files, and keep them valid while
+ * they are in the bank.
+ *
+ * Alternatively, `custom_set_data` copies a single waveform into wavetable 0, and `custom_free`
+ * frees it. The data is copied into the buffer given to `custom_set_storage()` if any (the looper
+ * provides one from its arena), and allocated otherwise.
  * 
  * The returned values will be scaled from a range of 0-255 to a range of -`amplitude`/2 to
- * +`amplitude`/2, centered around 128. The samples will be stepped throug at a rate based on
- * the sample rate defined in macros.h and the frequency provided with `custom_set_frequency()`;
- * the frequency refers to how many times per second the waveform will go through `SAMPLE_RATE`
- * samples, not how often the provided data will be looped through. Use the `custom_step` function
- * to retrieve the next sample of the custom waveform.
+ * +`amplitude`/2, centered around 128. The data is a single cycle of the waveform, of any length,
+ * and will be looped through `frequency` times per second, based on the sample rate set with
+ * `custom_set_sample_rate()`. Use the `custom_step` function to retrieve the next sample of the
+ * custom waveform, or `custom_fill` to generate a block of samples. Samples are read from the nearest
+ * position in the wavetable, or interpolated linearly between the two nearest ones with
+ * `custom_set_interpolated`, which suits long sampled timbres played at low frequencies.
  * 
- * @sa `SAMPLE_RATE` defined in macros.h
+ * The sample rate defaults to `SAMPLE_RATE` (defined in macros.h) and is normally set by the looper
+ * with `looper_set_sample_rate()`.
  * 
  * @author Ovidio1005
  * @date 2025-11-16
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /**
- * @brief Set the custom waveform data.
- * @details This function will dynamically allocate memory for the waveform data. `custom_step` should
- * never be called before this function. Previously allocated memory will not be freed automatically;
- * use the `custom_free` function to free it when no longer needed.
- * @param data Pointer to an array of unsigned 8-bit integers representing the waveform data.
- * @param length The number of samples provided in the data array.
+ * @brief Number of wavetables in the bank.
  */
-void custom_set_data(const uint8_t* data, uint16_t length);
+#define CUSTOM_MAX_WAVETABLES 64
+
+/**
+ * @brief Adds a wavetable to the bank, or removes it, without copying its data.
+ * @details If the wavetable is selected, it is played from the next sample.
+ * @param index The index of the wavetable, less than `CUSTOM_MAX_WAVETABLES`.
+ * @param data One cycle of the waveform, which must stay valid while it is in the bank; NULL to remove it.
+ * @param length The number of samples in the data; must be at least 1 if data is not NULL.
+ * @return false if the index or the length is invalid, true otherwise.
+ */
+bool custom_bank_set(uint8_t index, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Retrieves a wavetable of the bank.
+ * @param index The index of the wavetable.
+ * @param out_length Set to the number of samples of the wavetable, if not NULL.
+ * @return The data of the wavetable, or NULL if there is none at that index.
+ */
+const uint8_t* custom_bank_get(uint8_t index, uint32_t* out_length);
+
+/**
+ * @brief Removes all the wavetables from the bank, except the one copied by `custom_set_data`.
+ */
+void custom_bank_clear(void);
+
+/**
+ * @brief Selects the wavetable to play; an empty index plays silence.
+ * @param index The index of the wavetable, less than `CUSTOM_MAX_WAVETABLES`.
+ * @return false if the index is invalid, true otherwise.
+ */
+bool custom_select(uint8_t index);
+
+/**
+ * @brief Get the index of the selected wavetable.
+ */
+uint8_t custom_selected(void);
+
+/**
+ * @brief Check whether samples are interpolated between the positions of the wavetable.
+ */
+bool custom_interpolated(void);
+/**
+ * @brief Enable or disable linear interpolation between the positions of the wavetable.
+ */
+void custom_set_interpolated(bool enabled);
+
+/**
+ * @brief Sets the buffer the waveform data is copied into, instead of allocating it.
+ * @details Any previous data is freed. The buffer must stay valid until this function is called
+ * again; the looper calls it with the storage it reserves.
+ * @param buffer The buffer, or NULL to allocate the data in `custom_set_data`.
+ * @param capacity The size of the buffer, i.e. the maximum length of the data.
+ */
+void custom_set_storage(uint8_t* buffer, uint32_t capacity);
+
+/**
+ * @brief Set the custom waveform data, as wavetable 0, and select it.
+ * @details The data is copied into the buffer set with `custom_set_storage`, or into dynamically
+ * allocated memory if there is none; the previous data is replaced. To play waveforms without copying
+ * them, use `custom_bank_set` instead.
+ * @param data Pointer to an array of unsigned 8-bit integers representing a cycle of the waveform.
+ * @param length The number of samples provided in the data array; must be at least 1.
+ * @return false if the data does not fit in the buffer set with `custom_set_storage`, true otherwise.
+ */
+bool custom_set_data(const uint8_t* data, uint16_t length);
 
 /**
  * @brief Free the memory allocated for the custom waveform data.
  * @details This function should be called to free the memory allocated by `custom_set_data`
- * when the custom waveform is no longer needed, or when the data is to be replaced.
+ * when the custom waveform is no longer needed, or when the data is to be replaced. It is removed
+ * from the bank; borrowed wavetables are not affected.
  */
 void custom_free(void);
 
+/**
+ * @brief Get the length of the data copied by `custom_set_data`.
+ * @return The number of samples, or 0 if no data is set.
+ */
+uint16_t custom_data_length(void);
+
 /**
  * @brief Get the current frequency of the custom waveform.
  * @return The frequency in Hz.
@@ -47,8 +123,7 @@ void custom_free(void);
 uint16_t custom_frequency(void);
 /**
  * @brief Set the frequency of the custom waveform.
- * @details The waveform will loop every `SAMPLE_RATE / frequency` samples.
- * @sa `SAMPLE_RATE` defined in macros.h
+ * @details The waveform will loop every `sample_rate / frequency` samples.
  * @param frequency The desired frequency in Hz.
  */
 void custom_set_frequency(uint16_t frequency);
@@ -65,8 +140,28 @@ uint8_t custom_amplitude(void);
  */
 void custom_set_amplitude(uint8_t amplitude);
 
+/**
+ * @brief Get the sample rate of the custom waveform.
+ * @return The sample rate in Hz.
+ */
+uint32_t custom_sample_rate(void);
+/**
+ * @brief Set the sample rate of the custom waveform.
+ * @details The current phase is kept, wrapped around if it is past the end of the new cycle.
+ * @param sample_rate The sample rate in Hz; must not be 0.
+ */
+void custom_set_sample_rate(uint32_t sample_rate);
+
 /**
  * @brief Get the value for the current sample of the custom waveform, and advance to the next sample.
  * @return The sample value as an unsigned 8-bit integer.
  */
-uint8_t custom_step(void);
\ No newline at end of file
+uint8_t custom_step(void);
+
+/**
+ * @brief Get the values for the next samples of the custom waveform, as `custom_step` would.
+ * @details The frequency, amplitude and wavetable stay the same for the whole block.
+ * @param out The buffer to write the samples to.
+ * @param count The number of samples to generate.
+ */
+void custom_fill(uint8_t* out, uint32_t count);
@@ -0,0 +1,217 @@
+#include "effects.h"
+#include "macros.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define Q16_ONE (1u << 16)
+
+typedef struct effect {
+    EffectType type;
+
+    // Parameters
+    uint16_t time_ms; // Delay
+    uint8_t feedback; // Delay, Q8
+    uint8_t mix; // Delay, Q8
+    uint16_t cutoff; // Low-pass, in Hz
+    uint8_t bits; // Bit-crush
+    uint32_t rate; // Downsample, in Hz
+
+    // Derived from the parameters and the sample rate
+    int32_t* line; // Delay line
+    uint32_t line_length;
+    int32_t coefficient; // Low-pass, Q16
+    uint32_t increment; // Downsample, fraction of a held sample per sample in Q16
+
+    // State
+    uint32_t position; // Delay, write position in the line
+    int64_t level; // Low-pass, output in Q16
+    uint32_t phase; // Downsample, Q16
+    int32_t held; // Downsample
+} Effect;
+
+static Effect chain[EFFECTS_MAX_COUNT];
+static uint8_t chain_length = 0;
+static uint32_t sample_rate = SAMPLE_RATE;
+
+// Computes what depends on the sample rate, reallocating the delay line if needed
+static void configure(Effect* effect) {
+    switch(effect->type) {
+        case EFFECT_DELAY: {
+            uint32_t length = (uint32_t)((uint64_t)effect->time_ms * sample_rate / 1000);
+            if(length == 0) length = 1;
+            if(length != effect->line_length) {
+                free(effect->line);
+                effect->line = (int32_t*)malloc(length * sizeof(int32_t));
+                if(!effect->line) {
+                    fprintf(stderr, "Error: Memory allocation failed in effects_add_delay()\n");
+                    exit(EXIT_FAILURE);
+                }
+                effect->line_length = length;
+            }
+            break;
+        }
+        case EFFECT_LOWPASS: {
+            double cutoff = effect->cutoff < sample_rate / 2 ? effect->cutoff : sample_rate / 2;
+            effect->coefficient = (int32_t)lround((1.0 - exp(-2.0 * M_PI * cutoff / sample_rate)) * Q16_ONE);
+            if(effect->coefficient < 1) effect->coefficient = 1;
+            break;
+        }
+        case EFFECT_DOWNSAMPLE:
+            effect->increment = effect->rate >= sample_rate ? Q16_ONE : (uint32_t)(((uint64_t)effect->rate << 16) / sample_rate);
+            if(effect->increment == 0) effect->increment = 1;
+            break;
+        case EFFECT_BITCRUSH:
+            break;
+    }
+}
+
+static void reset(Effect* effect) {
+    if(effect->line) memset(effect->line, 0, effect->line_length * sizeof(int32_t));
+    effect->position = 0;
+    effect->level = 0;
+    effect->phase = Q16_ONE; // Take the first sample right away
+    effect->held = 0;
+}
+
+static bool add(Effect effect) {
+    if(chain_length >= EFFECTS_MAX_COUNT) return false;
+
+    Effect* added = &chain[chain_length++];
+    *added = effect;
+    configure(added);
+    reset(added);
+    return true;
+}
+
+bool effects_add_delay(uint16_t time_ms, uint8_t feedback, uint8_t mix) {
+    if(time_ms == 0 || time_ms > EFFECTS_MAX_DELAY_MS) return false;
+    return add((Effect){ .type = EFFECT_DELAY, .time_ms = time_ms, .feedback = feedback, .mix = mix });
+}
+
+bool effects_add_lowpass(uint16_t cutoff) {
+    if(cutoff == 0) return false;
+    return add((Effect){ .type = EFFECT_LOWPASS, .cutoff = cutoff });
+}
+
+bool effects_add_bitcrush(uint8_t bits) {
+    if(bits < 1 || bits > 8) return false;
+    return add((Effect){ .type = EFFECT_BITCRUSH, .bits = bits });
+}
+
+bool effects_add_downsample(uint32_t rate) {
+    if(rate == 0) return false;
+    return add((Effect){ .type = EFFECT_DOWNSAMPLE, .rate = rate });
+}
+
+uint8_t effects_count(void) {
+    return chain_length;
+}
+
+EffectType effects_type(uint8_t index) {
+    return chain[index].type;
+}
+
+void effects_clear(void) {
+    for(uint8_t i = 0; i < chain_length; i++) {
+        free(chain[i].line);
+    }
+    chain_length = 0;
+}
+
+void effects_reset(void) {
+    for(uint8_t i = 0; i < chain_length; i++) {
+        reset(&chain[i]);
+    }
+}
+
+void effects_set_sample_rate(uint32_t rate) {
+    sample_rate = rate;
+    for(uint8_t i = 0; i < chain_length; i++) {
+        configure(&chain[i]);
+        reset(&chain[i]);
+    }
+}
+
+static void process_delay(Effect* effect, int32_t* samples, uint32_t count) {
+    int32_t feedback = effect->feedback;
+    int32_t mix = effect->mix;
+
+    // Runs up to the end of the line, so the inner loop has no wrap-around check
+    while(count > 0) {
+        uint32_t run = effect->line_length - effect->position;
+        if(run > count) run = count;
+
+        int32_t* line = effect->line + effect->position;
+        for(uint32_t i = 0; i < run; i++) {
+            int32_t input = samples[i];
+            int32_t delayed = line[i];
+            samples[i] = input + delayed * mix / 256;
+            line[i] = input + delayed * feedback / 256; // Bounded, since the feedback is below 1
+        }
+
+        samples += run;
+        count -= run;
+        effect->position += run;
+        if(effect->position == effect->line_length) effect->position = 0;
+    }
+}
+
+static void process_lowpass(Effect* effect, int32_t* samples, uint32_t count) {
+    int64_t level = effect->level;
+    int64_t coefficient = effect->coefficient;
+
+    for(uint32_t i = 0; i < count; i++) {
+        level += (((int64_t)samples[i] * Q16_ONE - level) * coefficient) / Q16_ONE;
+        samples[i] = (int32_t)(level / Q16_ONE);
+    }
+
+    effect->level = level;
+}
+
+static void process_bitcrush(Effect* effect, int32_t* samples, uint32_t count) {
+    int32_t mask = -(1 << (8 - effect->bits)); // Clears the low bits, rounding down
+
+    for(uint32_t i = 0; i < count; i++) {
+        samples[i] &= mask;
+    }
+}
+
+static void process_downsample(Effect* effect, int32_t* samples, uint32_t count) {
+    if(effect->increment == Q16_ONE) return;
+
+    uint32_t phase = effect->phase;
+    int32_t held = effect->held;
+
+    for(uint32_t i = 0; i < count; i++) {
+        if(phase >= Q16_ONE) {
+            phase -= Q16_ONE;
+            held = samples[i];
+        }
+        samples[i] = held;
+        phase += effect->increment;
+    }
+
+    effect->phase = phase;
+    effect->held = held;
+}
+
+void effects_process(int32_t* samples, uint32_t count) {
+    for(uint8_t i = 0; i < chain_length; i++) {
+        Effect* effect = &chain[i];
+        switch(effect->type) {
+            case EFFECT_DELAY: process_delay(effect, samples, count); break;
+            case EFFECT_LOWPASS: process_lowpass(effect, samples, count); break;
+            case EFFECT_BITCRUSH: process_bitcrush(effect, samples, count); break;
+            case EFFECT_DOWNSAMPLE: process_downsample(effect, samples, count); break;
+        }
+    }
+}
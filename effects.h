@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+ * @file effects.h
+ * @brief Header file for the effects module, a chain of effects applied to the looper's mix.
+ *
+ * @details The effects process the sum of the channels before it is scaled to the output level,
+ * in the same units as the channels themselves: a channel at full volume ranges from -128 to 127.
+ * They only use integer and fixed-point arithmetic, and process whole blocks of samples at a time,
+ * one effect after the other in the order they were added:
+ * - Delay: a feedback delay line, adding echoes of the signal that fade out by the feedback factor.
+ * - Low-pass: a one-pole low-pass filter, softening the sound above its cutoff frequency.
+ * - Bit-crush: reduces the resolution of the samples to fewer bits than a channel's 8.
+ * - Downsample: holds each sample for several output samples, reducing the effective sample rate.
+ *
+ * Memory is only allocated when an effect is added (the delay line) or the sample rate changes, never
+ * while processing. When the chain is empty, the looper skips the effects stage entirely.
+ *
+ * The chain is applied by the looper; `looper_free()` removes every effect, so each song starts
+ * with an empty chain.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-28
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Maximum number of effects in the chain.
+ */
+#define EFFECTS_MAX_COUNT 8
+
+/**
+ * @brief Maximum delay time of a delay effect, in milliseconds.
+ */
+#define EFFECTS_MAX_DELAY_MS 5000
+
+/**
+ * @brief Types of effects.
+ */
+typedef enum effect_type {
+    EFFECT_DELAY,
+    EFFECT_LOWPASS,
+    EFFECT_BITCRUSH,
+    EFFECT_DOWNSAMPLE
+} EffectType;
+
+/**
+ * @brief Adds a feedback delay to the end of the chain.
+ *
+ * @param time_ms The delay time, 1 to `EFFECTS_MAX_DELAY_MS` milliseconds.
+ * @param feedback The fraction of each echo fed back into the delay line, 0-255 for 0 to 255/256.
+ * @param mix The level of the echoes added to the signal, 0-255 for 0 to 255/256.
+ * @return false if the chain is full or the delay time is out of range, true otherwise.
+ */
+bool effects_add_delay(uint16_t time_ms, uint8_t feedback, uint8_t mix);
+
+/**
+ * @brief Adds a one-pole low-pass filter to the end of the chain.
+ * @param cutoff The cutoff frequency in Hz, from 1 to half the sample rate.
+ * @return false if the chain is full or the cutoff is 0, true otherwise.
+ */
+bool effects_add_lowpass(uint16_t cutoff);
+
+/**
+ * @brief Adds a bit-crusher to the end of the chain.
+ * @param bits The resolution of a channel at full volume, 1 to 8 bits.
+ * @return false if the chain is full or the resolution is out of range, true otherwise.
+ */
+bool effects_add_bitcrush(uint8_t bits);
+
+/**
+ * @brief Adds a sample rate reduction to the end of the chain.
+ * @param rate The effective sample rate in Hz; rates at or above the sample rate leave the signal unchanged.
+ * @return false if the chain is full or the rate is 0, true otherwise.
+ */
+bool effects_add_downsample(uint32_t rate);
+
+/**
+ * @brief Retrieves the number of effects in the chain.
+ */
+uint8_t effects_count(void);
+
+/**
+ * @brief Retrieves the type of an effect of the chain.
+ * @param index The position of the effect in the chain; must be less than `effects_count()`.
+ */
+EffectType effects_type(uint8_t index);
+
+/**
+ * @brief Removes every effect from the chain, freeing their memory.
+ */
+void effects_clear(void);
+
+/**
+ * @brief Silences the delay lines and resets the state of every effect, keeping the chain.
+ */
+void effects_reset(void);
+
+/**
+ * @brief Sets the sample rate the effects run at.
+ * @details Delay times and frequencies are kept, and the effects are reset.
+ * @param sample_rate The sample rate in Hz.
+ */
+void effects_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * @brief Applies the chain to a block of samples, in place.
+ * @param samples The samples of the mix, where a channel at full volume ranges from -128 to 127.
+ * @param count The number of samples.
+ */
+void effects_process(int32_t* samples, uint32_t count);
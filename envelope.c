@@ -0,0 +1,358 @@
+#include "envelope.h"
+#include "macros.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BUILTIN_ENVELOPE_COUNT (HIT + 1)
+#define ENVELOPE_COUNT (BUILTIN_ENVELOPE_COUNT + ENVELOPE_MAX_CUSTOM)
+
+typedef struct envelope_table {
+    uint16_t* gains;
+    uint16_t length;
+    uint16_t capacity;
+    uint16_t samples_per_sixteenth; // Tempo the table was built for, 0 if never built
+} EnvelopeTable;
+
+typedef struct custom_envelope {
+    uint8_t* levels;
+    uint16_t length;
+    uint16_t step_samples;
+} CustomEnvelope;
+
+// Number of linear segments used to approximate curved envelopes at render time
+#define RENDER_CURVE_SEGMENTS 16
+
+// Breakpoint of a render-time envelope: the gain ramps linearly to `gain` over `samples` samples (at SAMPLE_RATE)
+typedef struct envelope_point {
+    uint16_t gain;
+    uint32_t samples;
+} EnvelopePoint;
+
+typedef struct render_envelope {
+    EnvelopePoint* points; // Starting from a gain of 0; the last gain is held until the note ends
+    uint16_t count;
+    uint32_t release_samples;
+} RenderEnvelope;
+
+static EnvelopeTable tables[ENVELOPE_COUNT];
+
+static CustomEnvelope custom_envelopes[ENVELOPE_MAX_CUSTOM];
+static uint8_t custom_envelope_count = 0;
+
+static RenderEnvelope render_envelopes[ENVELOPE_MAX_RENDER + 1]; // Indexed by ID, 0 is unused
+static uint8_t render_envelope_count = 0;
+
+// Envelope lengths are stored in samples at SAMPLE_RATE, and converted to the actual sample rate when used
+static uint32_t sample_rate = SAMPLE_RATE;
+
+static uint32_t ms_to_samples(uint16_t ms) {
+    return (uint32_t)ms * SAMPLE_RATE / 1000;
+}
+
+// Converts a length in samples at SAMPLE_RATE to samples at the current sample rate
+static uint32_t to_sample_rate(uint32_t samples) {
+    return sample_rate == SAMPLE_RATE ? samples : (uint32_t)((uint64_t)samples * sample_rate / SAMPLE_RATE);
+}
+
+// Converts a length in samples at the current sample rate to samples at SAMPLE_RATE
+static uint32_t from_sample_rate(uint32_t samples) {
+    return sample_rate == SAMPLE_RATE ? samples : (uint32_t)((uint64_t)samples * SAMPLE_RATE / sample_rate);
+}
+
+// Gain at `sample` samples since the start of the note
+static uint16_t builtin_gain(Envelope envelope, uint32_t sample) {
+    uint16_t min_gain;
+    uint32_t decay_length;
+
+    switch(envelope) {
+        case DECAY_SLOW:
+            min_gain = ENVELOPE_GAIN_ONE / DECAY_VOLUME_FACTOR;
+            decay_length = DECAY_SLOW_SAMPLES;
+            break;
+        case DECAY_MEDIUM:
+            min_gain = ENVELOPE_GAIN_ONE / DECAY_VOLUME_FACTOR;
+            decay_length = DECAY_MEDIUM_SAMPLES;
+            break;
+        case DECAY_FAST:
+            min_gain = ENVELOPE_GAIN_ONE / DECAY_VOLUME_FACTOR;
+            decay_length = DECAY_FAST_SAMPLES;
+            break;
+        case HIT:
+            min_gain = ENVELOPE_GAIN_ONE / HIT_VOLUME_FACTOR;
+            decay_length = HIT_SAMPLES;
+            break;
+        default:
+            return ENVELOPE_GAIN_ONE;
+    }
+
+    if(sample >= decay_length) return min_gain;
+
+    uint64_t range = ENVELOPE_GAIN_ONE - min_gain;
+    if(envelope == HIT) {
+        // Inverse quadratic: fast at first, slowing down towards the end
+        uint64_t inv_pos = decay_length - sample;
+        return min_gain + (uint16_t)(range * inv_pos * inv_pos / ((uint64_t)decay_length * decay_length));
+    } else {
+        return ENVELOPE_GAIN_ONE - (uint16_t)(range * sample / decay_length);
+    }
+}
+
+// Gain at `sample` samples since the start of the note
+static uint16_t custom_gain(const CustomEnvelope* custom, uint32_t sample) {
+    uint32_t index = sample / custom->step_samples;
+    uint32_t level;
+
+    if(index + 1 >= custom->length) {
+        level = custom->levels[custom->length - 1] * 256;
+    } else {
+        uint32_t position = sample % custom->step_samples;
+        int32_t start = custom->levels[index];
+        int32_t end = custom->levels[index + 1];
+        level = start * 256 + (end - start) * 256 * (int32_t)position / custom->step_samples;
+    }
+
+    return (uint16_t)((level * ENVELOPE_GAIN_ONE) / (255 * 256));
+}
+
+// Number of samples after which the envelope stays constant
+static uint32_t envelope_length_samples(Envelope envelope) {
+    switch(envelope) {
+        case CONSTANT: return 0;
+        case DECAY_SLOW: return DECAY_SLOW_SAMPLES;
+        case DECAY_MEDIUM: return DECAY_MEDIUM_SAMPLES;
+        case DECAY_FAST: return DECAY_FAST_SAMPLES;
+        case HIT: return HIT_SAMPLES;
+        default: {
+            const CustomEnvelope* custom = &custom_envelopes[envelope - BUILTIN_ENVELOPE_COUNT];
+            return (uint32_t)(custom->length - 1) * custom->step_samples;
+        }
+    }
+}
+
+static void build_table(Envelope envelope, EnvelopeTable* table, uint16_t samples_per_sixteenth) {
+    // One entry per sixteenth boundary, up to and including the first one past the end of the envelope
+    uint32_t length = (to_sample_rate(envelope_length_samples(envelope)) + samples_per_sixteenth - 1) / samples_per_sixteenth + 1;
+    if(length > UINT16_MAX) length = UINT16_MAX;
+
+    if(length > table->capacity) {
+        uint16_t* gains = (uint16_t*)realloc(table->gains, length * sizeof(uint16_t));
+        if(!gains) {
+            fprintf(stderr, "Error: Memory allocation failed in envelope_table()\n");
+            exit(EXIT_FAILURE);
+        }
+        table->gains = gains;
+        table->capacity = length;
+    }
+
+    for(uint32_t i = 0; i < length; i++) {
+        uint32_t sample = from_sample_rate(i * samples_per_sixteenth);
+        if(envelope < BUILTIN_ENVELOPE_COUNT) {
+            table->gains[i] = builtin_gain(envelope, sample);
+        } else {
+            table->gains[i] = custom_gain(&custom_envelopes[envelope - BUILTIN_ENVELOPE_COUNT], sample);
+        }
+    }
+
+    table->length = length;
+    table->samples_per_sixteenth = samples_per_sixteenth;
+}
+
+Envelope envelope_register(const uint8_t* levels, uint16_t length, uint16_t step_samples) {
+    if(!levels || length == 0 || step_samples == 0 || custom_envelope_count >= ENVELOPE_MAX_CUSTOM) {
+        return ENVELOPE_INVALID;
+    }
+
+    CustomEnvelope* custom = &custom_envelopes[custom_envelope_count];
+    custom->levels = (uint8_t*)malloc(length * sizeof(uint8_t));
+    if(!custom->levels) {
+        fprintf(stderr, "Error: Memory allocation failed in envelope_register()\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(custom->levels, levels, length * sizeof(uint8_t));
+    custom->length = length;
+    custom->step_samples = step_samples;
+
+    return (Envelope)(BUILTIN_ENVELOPE_COUNT + custom_envelope_count++);
+}
+
+const uint16_t* envelope_table(Envelope envelope, uint16_t samples_per_sixteenth, uint16_t* out_length) {
+    if(envelope < 0 || envelope >= BUILTIN_ENVELOPE_COUNT + custom_envelope_count || samples_per_sixteenth == 0) {
+        return NULL;
+    }
+
+    EnvelopeTable* table = &tables[envelope];
+    if(table->samples_per_sixteenth != samples_per_sixteenth) {
+        build_table(envelope, table, samples_per_sixteenth);
+    }
+
+    *out_length = table->length;
+    return table->gains;
+}
+
+// Adds a render-time envelope with `count` uninitialized points, returning its ID or 0 if full
+static uint8_t add_render_envelope(uint16_t count, uint16_t release_ms) {
+    if(render_envelope_count >= ENVELOPE_MAX_RENDER) return 0;
+
+    uint8_t id = ++render_envelope_count;
+    RenderEnvelope* render = &render_envelopes[id];
+    render->points = (EnvelopePoint*)malloc(count * sizeof(EnvelopePoint));
+    if(!render->points) {
+        fprintf(stderr, "Error: Memory allocation failed for render-time envelope\n");
+        exit(EXIT_FAILURE);
+    }
+    render->count = count;
+    render->release_samples = ms_to_samples(release_ms);
+
+    return id;
+}
+
+Envelope envelope_register_adsr(uint16_t attack_ms, uint16_t decay_ms, uint8_t sustain_level, uint16_t release_ms) {
+    uint8_t id = add_render_envelope(2, release_ms);
+    if(id == 0) return ENVELOPE_INVALID;
+
+    EnvelopePoint* points = render_envelopes[id].points;
+    points[0] = (EnvelopePoint){ .gain = ENVELOPE_GAIN_ONE, .samples = ms_to_samples(attack_ms) };
+    points[1] = (EnvelopePoint){ .gain = (uint16_t)(((uint32_t)sustain_level * ENVELOPE_GAIN_ONE) / 255), .samples = ms_to_samples(decay_ms) };
+
+    return (Envelope)(ENVELOPE_RENDER_BASE + id);
+}
+
+Envelope envelope_at_render_time(Envelope envelope, uint16_t release_ms) {
+    if(envelope < 0 || envelope >= BUILTIN_ENVELOPE_COUNT + custom_envelope_count) return ENVELOPE_INVALID;
+
+    uint8_t id;
+    if(envelope >= BUILTIN_ENVELOPE_COUNT) {
+        // Custom envelopes: one segment between each pair of levels
+        const CustomEnvelope* custom = &custom_envelopes[envelope - BUILTIN_ENVELOPE_COUNT];
+        id = add_render_envelope(custom->length, release_ms);
+        if(id == 0) return ENVELOPE_INVALID;
+
+        for(uint16_t i = 0; i < custom->length; i++) {
+            render_envelopes[id].points[i] = (EnvelopePoint){
+                .gain = custom_gain(custom, (uint32_t)i * custom->step_samples),
+                .samples = i == 0 ? 0 : custom->step_samples
+            };
+        }
+    } else {
+        // Built-in envelopes: a jump to full volume followed by either a single linear segment,
+        // or a piecewise linear approximation of the curve
+        uint32_t length = envelope_length_samples(envelope);
+        uint16_t segments = length == 0 ? 0 : (envelope == HIT ? RENDER_CURVE_SEGMENTS : 1);
+        id = add_render_envelope(segments + 1, release_ms);
+        if(id == 0) return ENVELOPE_INVALID;
+
+        render_envelopes[id].points[0] = (EnvelopePoint){ .gain = ENVELOPE_GAIN_ONE, .samples = 0 };
+        uint32_t previous_sample = 0;
+        for(uint16_t i = 1; i <= segments; i++) {
+            uint32_t sample = (uint32_t)((uint64_t)length * i / segments);
+            render_envelopes[id].points[i] = (EnvelopePoint){
+                .gain = builtin_gain(envelope, sample),
+                .samples = sample - previous_sample
+            };
+            previous_sample = sample;
+        }
+    }
+
+    return (Envelope)(ENVELOPE_RENDER_BASE + id);
+}
+
+static void start_segment(EnvelopeState* state, uint16_t target_gain, uint32_t samples) {
+    state->increment = (((int32_t)target_gain << 8) - state->level) / (int32_t)samples;
+    state->remaining = samples;
+}
+
+static void set_idle(EnvelopeState* state) {
+    state->id = 0;
+    state->level = 0;
+    state->increment = 0;
+    state->remaining = UINT32_MAX;
+}
+
+void envelope_note_on(EnvelopeState* state, uint8_t id) {
+    if(id == 0 || id > render_envelope_count) {
+        set_idle(state);
+        return;
+    }
+
+    state->id = id;
+    state->level = 0;
+    state->increment = 0;
+    state->remaining = 0; // The first segment is loaded by the next envelope_step()
+    state->point = 0;
+    state->released = 0;
+}
+
+void envelope_note_off(EnvelopeState* state) {
+    if(state->id == 0 || state->released) return;
+
+    state->released = 1;
+    uint32_t release_samples = to_sample_rate(render_envelopes[state->id].release_samples);
+    if(release_samples == 0) {
+        set_idle(state);
+    } else {
+        start_segment(state, 0, release_samples);
+    }
+}
+
+void envelope_next_segment(EnvelopeState* state) {
+    if(state->id == 0 || state->released) {
+        // Idle, or the release just ended
+        set_idle(state);
+        return;
+    }
+
+    const RenderEnvelope* render = &render_envelopes[state->id];
+
+    // Snap to the end of the segment that just ended, to avoid accumulating rounding errors
+    if(state->point > 0) state->level = (int32_t)render->points[state->point - 1].gain << 8;
+
+    // Zero-length segments jump straight to their gain
+    while(state->point < render->count && to_sample_rate(render->points[state->point].samples) == 0) {
+        state->level = (int32_t)render->points[state->point].gain << 8;
+        state->point++;
+    }
+
+    if(state->point >= render->count) {
+        // Sustain: hold the last gain until note off
+        state->increment = 0;
+        state->remaining = UINT32_MAX;
+        return;
+    }
+
+    const EnvelopePoint* point = &render->points[state->point++];
+    start_segment(state, point->gain, to_sample_rate(point->samples));
+}
+
+uint32_t envelope_sample_rate(void) {
+    return sample_rate;
+}
+
+void envelope_set_sample_rate(uint32_t rate) {
+    if(rate == sample_rate) return;
+    sample_rate = rate;
+
+    // Force the tables to be rebuilt
+    for(int i = 0; i < ENVELOPE_COUNT; i++) {
+        tables[i].samples_per_sixteenth = 0;
+    }
+}
+
+void envelope_free(void) {
+    for(int i = 0; i < ENVELOPE_COUNT; i++) {
+        free(tables[i].gains);
+        tables[i] = (EnvelopeTable){ 0 };
+    }
+    for(int i = 0; i < custom_envelope_count; i++) {
+        free(custom_envelopes[i].levels);
+        custom_envelopes[i] = (CustomEnvelope){ 0 };
+    }
+    custom_envelope_count = 0;
+    for(int i = 1; i <= render_envelope_count; i++) {
+        free(render_envelopes[i].points);
+        render_envelopes[i] = (RenderEnvelope){ 0 };
+    }
+    render_envelope_count = 0;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+/**
+ * @file envelope.h
+ * @brief Header file for the envelope module, which provides precomputed volume envelope tables.
+ *
+ * @details Envelopes describe how the volume of a note changes over time. Since the composer only
+ * needs the envelope's value at each sixteenth boundary of a note, every envelope is stored as a
+ * table of gains indexed by the number of sixteenths since the start of the note. The tables are
+ * built for a given number of samples per sixteenth and rebuilt only when that changes (i.e. when
+ * the tempo changes), so evaluating an envelope is a single table lookup and multiplication.
+ *
+ * Besides the built-in envelopes, custom envelope shapes can be registered as tables of levels
+ * with `envelope_register()`.
+ *
+ * Render-time envelopes are not baked into the notes by the composer: notes only carry the
+ * envelope's ID, and the looper evaluates the envelope for every sample with `envelope_step()`.
+ * Their timing is expressed in samples rather than sixteenths, so they are not affected by tempo
+ * changes. Render-time envelopes are either ADSR envelopes registered with `envelope_register_adsr()`,
+ * or table envelopes converted with `envelope_at_render_time()`.
+ *
+ * All the lengths given in samples (such as `DECAY_SLOW_SAMPLES` or the `step_samples` of custom
+ * envelopes) refer to the default `SAMPLE_RATE`; when the looper runs at a different sample rate
+ * (see `envelope_set_sample_rate()`), they are scaled so that envelopes keep the same duration.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-18
+ */
+
+#include <stdint.h>
+
+#define DECAY_VOLUME_FACTOR 4
+#define HIT_VOLUME_FACTOR 4
+#define DECAY_SLOW_SAMPLES 32000
+#define DECAY_MEDIUM_SAMPLES 16000
+#define DECAY_FAST_SAMPLES 8000
+#define HIT_SAMPLES 4000
+
+/**
+ * @brief Maximum number of custom envelopes that can be registered with `envelope_register()`.
+ */
+#define ENVELOPE_MAX_CUSTOM 16
+
+/**
+ * @brief Maximum number of render-time envelopes.
+ */
+#define ENVELOPE_MAX_RENDER 15
+
+/**
+ * @brief `Envelope` values from this one onwards refer to render-time envelopes.
+ */
+#define ENVELOPE_RENDER_BASE 0x100
+
+/**
+ * @brief Gain value corresponding to full volume in envelope tables (1.0 in Q15 fixed point).
+ */
+#define ENVELOPE_GAIN_ONE 32768
+
+/**
+ * @brief Enumeration of the built-in envelopes.
+ *
+ * @details Values returned by `envelope_register()` come after `HIT` and can be used wherever
+ * an `Envelope` is expected.
+ */
+typedef enum envelope {
+    CONSTANT,
+    DECAY_SLOW,
+    DECAY_MEDIUM,
+    DECAY_FAST,
+    HIT,
+    ENVELOPE_INVALID = -1
+} Envelope;
+
+/**
+ * @brief Registers a custom envelope shape.
+ *
+ * @details The envelope's level at sample `i * step_samples` since the start of the note is
+ * `levels[i]` (0 being silence and 255 being the note's full volume); levels in between are
+ * linearly interpolated, and the last level is held after the end of the table. The levels are
+ * copied, so the array does not need to outlive this call.
+ *
+ * @param levels Array of `length` levels (0-255).
+ * @param length The number of levels in the array; must be at least 1.
+ * @param step_samples The number of samples (at `SAMPLE_RATE`) between two consecutive levels; must be at least 1.
+ * @return The new envelope, or `ENVELOPE_INVALID` if the arguments are invalid or
+ * `ENVELOPE_MAX_CUSTOM` envelopes are already registered.
+ */
+Envelope envelope_register(const uint8_t* levels, uint16_t length, uint16_t step_samples);
+
+/**
+ * @brief Retrieves the gain table of an envelope for the given number of samples per sixteenth.
+ *
+ * @details Entry `i` of the table is the envelope's gain (0 to `ENVELOPE_GAIN_ONE`) after `i`
+ * sixteenths; the envelope keeps the value of the last entry for every later sixteenth.
+ * The table is rebuilt if `samples_per_sixteenth` differs from the value it was last built for,
+ * and stays valid until the next call with a different value.
+ *
+ * @param envelope The envelope to get the table for.
+ * @param samples_per_sixteenth The number of samples per sixteenth note at the current tempo.
+ * @param out_length Set to the number of entries in the table (always at least 1).
+ * @return The gain table, or NULL if the envelope is invalid.
+ */
+const uint16_t* envelope_table(Envelope envelope, uint16_t samples_per_sixteenth, uint16_t* out_length);
+
+/**
+ * @brief Applies an envelope gain to a volume.
+ *
+ * @param volume The full volume of the note (0-255).
+ * @param gain The gain, as stored in envelope tables.
+ * @return The scaled volume.
+ */
+static inline uint8_t envelope_apply_gain(uint8_t volume, uint16_t gain) {
+    return (uint8_t)(((uint32_t)volume * gain) >> 15);
+}
+
+/**
+ * @brief Retrieves the sample rate envelopes are evaluated at.
+ * @return The sample rate in Hz.
+ */
+uint32_t envelope_sample_rate(void);
+
+/**
+ * @brief Sets the sample rate envelopes are evaluated at.
+ *
+ * @details This is called by `looper_set_sample_rate()`. Tables returned by `envelope_table()` are
+ * rebuilt on their next retrieval; render-time envelopes being played switch to the new rate from
+ * their next segment.
+ *
+ * @param sample_rate The sample rate in Hz; must not be 0.
+ */
+void envelope_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * @brief Registers a render-time ADSR envelope.
+ *
+ * @details The gain rises from 0 to full volume in `attack_ms` milliseconds, falls to
+ * `sustain_level` in `decay_ms` milliseconds and stays there while the note plays. When the
+ * note ends (including the pauses added by the staccato and double note flags), the gain falls
+ * to 0 in `release_ms` milliseconds, while the last frequency of the note keeps playing.
+ *
+ * @param attack_ms The attack time in milliseconds.
+ * @param decay_ms The decay time in milliseconds.
+ * @param sustain_level The sustain level (0-255, 255 being the note's full volume).
+ * @param release_ms The release time in milliseconds.
+ * @return The new envelope, or `ENVELOPE_INVALID` if `ENVELOPE_MAX_RENDER` render-time
+ * envelopes are already registered.
+ */
+Envelope envelope_register_adsr(uint16_t attack_ms, uint16_t decay_ms, uint8_t sustain_level, uint16_t release_ms);
+
+/**
+ * @brief Registers a render-time version of a table envelope.
+ *
+ * @details The returned envelope follows the same shape as `envelope` (a built-in envelope or
+ * one registered with `envelope_register()`), but is evaluated for every sample by the looper
+ * instead of being baked into the notes. When the note ends, the gain falls to 0 in `release_ms`
+ * milliseconds.
+ *
+ * @param envelope The table envelope to convert.
+ * @param release_ms The release time in milliseconds.
+ * @return The new envelope, or `ENVELOPE_INVALID` if `envelope` is not a table envelope or
+ * `ENVELOPE_MAX_RENDER` render-time envelopes are already registered.
+ */
+Envelope envelope_at_render_time(Envelope envelope, uint16_t release_ms);
+
+/**
+ * @brief Checks whether an envelope is a render-time envelope.
+ */
+static inline int envelope_is_render_time(Envelope envelope) {
+    return envelope >= ENVELOPE_RENDER_BASE;
+}
+
+/**
+ * @brief Retrieves the ID stored in notes (see `NoteAttributes`) for a render-time envelope.
+ * @return The ID (1 to `ENVELOPE_MAX_RENDER`), or 0 if the envelope is not a render-time envelope.
+ */
+static inline uint8_t envelope_render_id(Envelope envelope) {
+    return envelope_is_render_time(envelope) ? (uint8_t)(envelope - ENVELOPE_RENDER_BASE) : 0;
+}
+
+/**
+ * @brief State of a render-time envelope being played on a channel.
+ */
+typedef struct envelope_state {
+    /** The current gain, as a Q15 gain shifted left by 8 bits for precision. */
+    int32_t level;
+    /** The amount added to `level` at every sample of the current segment. */
+    int32_t increment;
+    /** The number of samples left in the current segment. */
+    uint32_t remaining;
+    /** The index of the next breakpoint of the envelope. */
+    uint16_t point;
+    /** The ID of the envelope being played, 0 if idle. */
+    uint8_t id;
+    /** Whether the envelope is in its release phase. */
+    uint8_t released;
+} EnvelopeState;
+
+/**
+ * @brief Starts (or restarts) a render-time envelope from its beginning.
+ * @param state The envelope state to reset.
+ * @param id The ID of the render-time envelope to play.
+ */
+void envelope_note_on(EnvelopeState* state, uint8_t id);
+
+/**
+ * @brief Moves a render-time envelope to its release phase.
+ * @param state The envelope state to release; idle states are left untouched.
+ */
+void envelope_note_off(EnvelopeState* state);
+
+// Moves `state` to its next segment; used by `envelope_step()`
+void envelope_next_segment(EnvelopeState* state);
+
+/**
+ * @brief Gets the current gain of a render-time envelope, and advances it by one sample.
+ * @param state The envelope state to advance.
+ * @return The gain (0 to `ENVELOPE_GAIN_ONE`), or 0 if the envelope is idle.
+ */
+static inline uint16_t envelope_step(EnvelopeState* state) {
+    if(state->remaining == 0) {
+        envelope_next_segment(state);
+    } else {
+        state->level += state->increment;
+        state->remaining--;
+    }
+    return (uint16_t)(state->level >> 8);
+}
+
+/**
+ * @brief Frees all the envelope tables and unregisters every custom and render-time envelope.
+ */
+void envelope_free(void);
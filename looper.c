@@ -7,156 +7,842 @@
 #include "triangle.h"
 #include "noise.h"
 #include "custom.h"
+#include "envelope.h"
+#include "timeline.h"
+#include "arena.h"
+#include "effects.h"
+#include "bytebeat.h"
+#include "trace.h"
+#include "realtime.h"
+#include "meters.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 static uint16_t loop_length_sixteenths;
-uint32_t loop_length_samples; // Used in looper_step to avoid recalculating it every time
 
-static NoteAttributes *square_notes = NULL;
-static NoteAttributes *sawtooth_notes = NULL;
-static NoteAttributes *triangle_notes = NULL;
-static NoteAttributes *noise_notes = NULL;
-static NoteAttributes *custom_notes = NULL;
+#ifdef LOOPER_COMPACT_NOTES
+// Notes of a page, one array per field so that pauses only touch `control`
+typedef struct note_page {
+    uint8_t control[LOOPER_PAGE_SIXTEENTHS]; // Flags in the low nibble, render-time envelope ID in the high nibble
+    uint16_t pitch[LOOPER_PAGE_SIXTEENTHS]; // Starting pitch, in cents above C0, or ZERO_PITCH for 0 Hz
+    int8_t glide[LOOPER_PAGE_SIXTEENTHS]; // Ending pitch minus starting pitch, in steps of LOOPER_COMPACT_GLIDE_CENTS
+    uint8_t volume[LOOPER_PAGE_SIXTEENTHS]; // Starting volume in the high nibble, ending volume in the low nibble, in steps of 17
+} NotePage;
+
+#define C0_FREQUENCY 16.351597831287414
+#define MAX_PITCH 16383 // Cents above C0, about 42 kHz
+#define ZERO_PITCH 0 // Encodes 0 Hz rather than C0
+
+static uint32_t semitone_ratios_q16[12]; // 2^(semitone / 12) in Q16 fixed point
+static uint32_t cent_ratios_q16[100]; // 2^(cent / 1200) in Q16 fixed point
+
+// Notes being played, decoded once per sixteenth rather than at every sample
+static NoteAttributes decoded_notes[CUSTOM + 1];
+static uint16_t decoded_sixteenths[CUSTOM + 1]; // UINT16_MAX if not decoded
+#else
+// Notes of a page
+typedef struct note_page {
+    NoteAttributes notes[LOOPER_PAGE_SIXTEENTHS];
+} NotePage;
+#endif
+
+// Notes of a channel: for each group of LOOPER_PAGE_SIXTEENTHS sixteenths, the index of its page in `pages`
+typedef struct note_grid {
+    uint16_t* page_table;
+} NoteGrid;
+
+#define EMPTY_PAGE 0 // All pauses, shared by every grid and never written
+#define MIX_BLOCK 256 // Samples mixed at a time when the bytebeat channel or effects are enabled
+
+// Pages are reference counted and shared between sections with the same notes, and copied when
+// written to while shared. There are enough pages for every grid to hold distinct notes, so taking
+// a page from the free list never fails.
+static NotePage* pages = NULL;
+static uint16_t* page_refs = NULL; // Number of page table entries using each page (not kept for EMPTY_PAGE)
+static uint16_t* free_pages = NULL;
+static uint16_t free_page_count = 0;
+static uint16_t page_count = 0; // Including EMPTY_PAGE
+static uint16_t grid_page_count = 0; // Entries in the page table of each grid
+
+// Notes of every channel and data of the custom waveform, carved from the arena by looper_reserve()
+static Arena arena;
+static NoteGrid grids[CUSTOM + 1];
+static uint16_t capacity_sixteenths = 0; // Sixteenths reserved for each channel
+static uint8_t* custom_storage = NULL;
+static uint16_t custom_capacity = 0;
+static bool channel_enabled[CUSTOM + 1];
 
 uint8_t active_channel_count = 0;
+static bool bytebeat_enabled = false; // Whether the bytebeat channel is mixed with the others
+
+// Level meters, updated by looper_render() while enabled; the values of each channel are recorded in
+// channel_blocks by mix_sample() for a block at a time, and measured after it is mixed
+static bool meters_enabled = false;
+static Meter meters[LOOPER_METER_COUNT];
+static int32_t channel_blocks[LOOPER_METER_MASTER][MIX_BLOCK]; // Indexed by channel, then LOOPER_METER_BYTEBEAT
+
+static uint32_t sample_rate = SAMPLE_RATE;
+static float master_gain = LOOPER_DEFAULT_MASTER_GAIN;
+
+// Tempo and length of a sixteenth, in Q16 fixed point
+static uint32_t tempo_bpm_q16;
+static uint32_t samples_per_sixteenth_q16;
 
-static uint16_t samples_per_sixteenth;
+// Sixteenths are either floor or ceil(samples_per_sixteenth_q16) samples long; this accumulates the
+// fractional part, so that the total length of the played sixteenths never drifts from the exact tempo
+static uint32_t sixteenth_fraction_accumulator;
+static uint16_t sixteenth_length; // Length of the current sixteenth in samples
 
-static uint32_t current_sample;
+static uint16_t current_sixteenth;
+static uint16_t sample_in_sixteenth;
+static uint32_t current_sample; // Samples played since the beginning of the loop
+
+// Tempo automation: the tempo ramps linearly from each point to the next one, wrapping around the loop
+typedef struct tempo_point {
+    uint16_t sixteenth;
+    uint32_t tempo_bpm_q16;
+} TempoPoint;
+
+static TempoPoint tempo_points[LOOPER_MAX_TEMPO_POINTS];
+static uint8_t tempo_point_count = 0;
+static uint8_t tempo_segment; // Index of the point the current ramp started from
+static int32_t tempo_increment_q16; // Tempo change per sixteenth in the current ramp
+static uint16_t tempo_segment_remaining; // Sixteenths until the next point
+
+// Wavetable changes of the custom channel, sorted by sixteenth; the wavetable of the last change
+// before a sixteenth, wrapping around the loop, is the one selected while it plays
+typedef struct wavetable_change {
+    uint16_t sixteenth;
+    uint8_t wavetable;
+} WavetableChange;
+
+static WavetableChange wavetable_changes[LOOPER_MAX_WAVETABLE_CHANGES];
+static uint16_t wavetable_change_count = 0;
+static uint16_t next_wavetable_change; // Index of the first change not applied yet since the beginning of the loop
+
+// Sample of the current sixteenth at which the next timeline event is due, UINT16_MAX if not in this sixteenth
+static uint16_t next_event_offset = UINT16_MAX;
+
+// Returns whether the channel is valid and enabled
+static bool grid_enabled(Channel channel) {
+    return channel >= SQUARE && channel <= CUSTOM && channel_enabled[channel];
+}
+
+#ifdef LOOPER_COMPACT_NOTES
+// Pitch 0 is reserved for 0 Hz (e.g. noise changing value at every sample); frequencies up to C0 are pitch 1
+static uint16_t frequency_to_pitch(uint16_t frequency) {
+    if(frequency == 0) return ZERO_PITCH;
+    if(frequency <= C0_FREQUENCY) return 1;
+
+    long pitch = lround(1200.0 * log2(frequency / C0_FREQUENCY));
+    if(pitch < 1) return 1;
+    return pitch > MAX_PITCH ? MAX_PITCH : (uint16_t)pitch;
+}
+
+static uint16_t pitch_to_frequency(int32_t pitch) {
+    if(pitch == ZERO_PITCH) return 0;
+    if(pitch < 1) pitch = 1;
+    if(pitch > MAX_PITCH) pitch = MAX_PITCH;
+
+    uint64_t frequency_q16 = (uint64_t)(C0_FREQUENCY * 65536.0 + 0.5) << (pitch / 1200);
+    frequency_q16 = (frequency_q16 * semitone_ratios_q16[pitch % 1200 / 100]) >> 16;
+    frequency_q16 = (frequency_q16 * cent_ratios_q16[pitch % 100]) >> 16;
+
+    uint64_t frequency = (frequency_q16 + 0x8000) >> 16;
+    return frequency > UINT16_MAX ? UINT16_MAX : (uint16_t)frequency;
+}
+
+static uint8_t volume_to_step(uint8_t volume) {
+    return (uint8_t)((volume * 15 + 127) / 255);
+}
+#endif
+
+static uint16_t page_acquire(void) {
+    uint16_t page = free_pages[--free_page_count];
+    page_refs[page] = 1;
+    return page;
+}
+
+static void page_release(uint16_t page) {
+    if(page != EMPTY_PAGE && --page_refs[page] == 0) free_pages[free_page_count++] = page;
+}
+
+// Carves the page table of a channel from the arena, with all its sixteenths set to pauses
+static void grid_carve(Channel channel) {
+    #ifdef LOOPER_COMPACT_NOTES
+    if(semitone_ratios_q16[0] == 0) {
+        for(int i = 0; i < 12; i++) semitone_ratios_q16[i] = (uint32_t)lround(pow(2.0, i / 12.0) * 65536.0);
+        for(int i = 0; i < 100; i++) cent_ratios_q16[i] = (uint32_t)lround(pow(2.0, i / 1200.0) * 65536.0);
+    }
+
+    decoded_sixteenths[channel] = UINT16_MAX;
+    #endif
+
+    grids[channel].page_table = (uint16_t*)arena_alloc(&arena, grid_page_count * sizeof(uint16_t)); // All EMPTY_PAGE
+}
+
+// Retrieves a page of a channel that can be written without affecting other sections, copying it if shared
+static NotePage* grid_writable_page(Channel channel, uint16_t page_index) {
+    uint16_t* entry = &grids[channel].page_table[page_index];
+
+    if(*entry == EMPTY_PAGE || page_refs[*entry] > 1) {
+        uint16_t copy = page_acquire();
+        memcpy(&pages[copy], &pages[*entry], sizeof(NotePage));
+        page_release(*entry);
+        *entry = copy;
+    }
+
+    return &pages[*entry];
+}
+
+// Makes a page of a channel use the same notes as a page of another (or the same) channel
+static void grid_share_page(Channel src_channel, uint16_t src_page_index, Channel dest_channel, uint16_t dest_page_index) {
+    uint16_t page = grids[src_channel].page_table[src_page_index];
+    uint16_t* entry = &grids[dest_channel].page_table[dest_page_index];
+    if(*entry == page) return;
+
+    if(page != EMPTY_PAGE) page_refs[page]++;
+    page_release(*entry);
+    *entry = page;
+}
+
+// Sets the notes of a channel from `start` (included) to `end` (excluded) to pauses
+static void grid_clear(Channel channel, uint16_t start, uint16_t end) {
+    for(uint32_t page_start = start - start % LOOPER_PAGE_SIXTEENTHS; page_start < end; page_start += LOOPER_PAGE_SIXTEENTHS) {
+        uint16_t page_index = (uint16_t)(page_start / LOOPER_PAGE_SIXTEENTHS);
+        uint16_t* entry = &grids[channel].page_table[page_index];
+        if(*entry == EMPTY_PAGE) continue;
+
+        uint32_t from = start > page_start ? start : page_start;
+        uint32_t to = end < page_start + LOOPER_PAGE_SIXTEENTHS ? end : page_start + LOOPER_PAGE_SIXTEENTHS;
+        if(from == page_start && (to == page_start + LOOPER_PAGE_SIXTEENTHS || to >= capacity_sixteenths)) {
+            // Whole page: the rest of it, if any, is past the reserved length and never played
+            page_release(*entry);
+            *entry = EMPTY_PAGE;
+            continue;
+        }
+
+        NotePage* page = grid_writable_page(channel, page_index);
+        from -= page_start;
+        to -= page_start;
+        #ifdef LOOPER_COMPACT_NOTES
+        memset(page->control + from, 0, (to - from) * sizeof(uint8_t));
+        memset(page->pitch + from, 0, (to - from) * sizeof(uint16_t));
+        memset(page->glide + from, 0, (to - from) * sizeof(int8_t));
+        memset(page->volume + from, 0, (to - from) * sizeof(uint8_t));
+        #else
+        memset(page->notes + from, 0, (to - from) * sizeof(NoteAttributes));
+        #endif
+    }
+
+    #ifdef LOOPER_COMPACT_NOTES
+    decoded_sixteenths[channel] = UINT16_MAX;
+    #endif
+}
+
+static inline const NotePage* grid_page(Channel channel, uint16_t sixteenth) {
+    return &pages[grids[channel].page_table[sixteenth / LOOPER_PAGE_SIXTEENTHS]];
+}
+
+// Retrieves a note of an enabled channel
+static inline NoteAttributes grid_get(Channel channel, uint16_t sixteenth) {
+    const NotePage* page = grid_page(channel, sixteenth);
+    uint16_t i = sixteenth % LOOPER_PAGE_SIXTEENTHS;
+
+    #ifdef LOOPER_COMPACT_NOTES
+    uint8_t control = page->control[i];
+    if((control & 0x01) == 0) return (NoteAttributes){ .flags = control & 0x0F }; // Pause: the other fields are not used
+
+    int32_t pitch = page->pitch[i];
+    uint8_t volume = page->volume[i];
+    return (NoteAttributes){
+        .flags = control & 0x0F,
+        .envelope = control >> 4,
+        .frequency_start = pitch_to_frequency(pitch),
+        .frequency_end = pitch_to_frequency(pitch + page->glide[i] * LOOPER_COMPACT_GLIDE_CENTS),
+        .volume_start = (volume >> 4) * 17,
+        .volume_end = (volume & 0x0F) * 17
+    };
+    #else
+    return page->notes[i];
+    #endif
+}
+
+// Retrieves the note of an enabled channel to play at the current sample
+static inline NoteAttributes grid_play(Channel channel, uint16_t sixteenth) {
+    #ifdef LOOPER_COMPACT_NOTES
+    if(decoded_sixteenths[channel] != sixteenth) {
+        decoded_notes[channel] = grid_get(channel, sixteenth);
+        decoded_sixteenths[channel] = sixteenth;
+    }
+    return decoded_notes[channel];
+    #else
+    return grid_get(channel, sixteenth);
+    #endif
+}
+
+// Stores a note of an enabled channel, quantizing it if notes are compact
+static inline void grid_set(Channel channel, uint16_t sixteenth, NoteAttributes attributes) {
+    NotePage* page = grid_writable_page(channel, sixteenth / LOOPER_PAGE_SIXTEENTHS);
+    uint16_t i = sixteenth % LOOPER_PAGE_SIXTEENTHS;
+
+    #ifdef LOOPER_COMPACT_NOTES
+    uint16_t pitch_start = frequency_to_pitch(attributes.frequency_start);
+    long glide = lround(((double)frequency_to_pitch(attributes.frequency_end) - pitch_start) / LOOPER_COMPACT_GLIDE_CENTS);
+    if(glide < INT8_MIN) glide = INT8_MIN;
+    if(glide > INT8_MAX) glide = INT8_MAX;
+
+    page->control[i] = (uint8_t)((attributes.flags & 0x0F) | (attributes.envelope << 4));
+    page->pitch[i] = pitch_start;
+    page->glide[i] = (int8_t)glide;
+    page->volume[i] = (uint8_t)((volume_to_step(attributes.volume_start) << 4) | volume_to_step(attributes.volume_end));
+
+    if(decoded_sixteenths[channel] == sixteenth) decoded_sixteenths[channel] = UINT16_MAX;
+    #else
+    page->notes[i] = attributes;
+    #endif
+}
+
+// Copies a single note as stored, without quantizing it again if notes are compact
+static inline void grid_copy_note(Channel src_channel, uint16_t src_sixteenth, Channel dest_channel, uint16_t dest_sixteenth) {
+    #ifdef LOOPER_COMPACT_NOTES
+    const NotePage* src = grid_page(src_channel, src_sixteenth);
+    uint16_t i = src_sixteenth % LOOPER_PAGE_SIXTEENTHS;
+    uint8_t control = src->control[i];
+    uint16_t pitch = src->pitch[i];
+    int8_t glide = src->glide[i];
+    uint8_t volume = src->volume[i];
+
+    NotePage* dest = grid_writable_page(dest_channel, dest_sixteenth / LOOPER_PAGE_SIXTEENTHS);
+    uint16_t j = dest_sixteenth % LOOPER_PAGE_SIXTEENTHS;
+    dest->control[j] = control;
+    dest->pitch[j] = pitch;
+    dest->glide[j] = glide;
+    dest->volume[j] = volume;
+    #else
+    grid_set(dest_channel, dest_sixteenth, grid_get(src_channel, src_sixteenth));
+    #endif
+}
+
+// State of a voice playing on a channel, used to evaluate render-time envelopes
+typedef struct voice {
+    EnvelopeState envelope;
+    bool gate; // Whether the voice was playing a note at the previous sample
+    uint16_t frequency; // Last frequency played, kept during the envelope's release
+    uint8_t volume; // Last volume played, kept during the envelope's release
+} Voice;
+
+// Playback state of a channel: one voice for the grid, one for timeline events
+typedef struct channel_state {
+    Voice grid;
+    Voice timeline;
+} ChannelState;
+
+static ChannelState channel_states[CUSTOM + 1];
+
+void compute_attributes(Channel channel, NoteAttributes attributes, uint16_t sample_in_sixteenth, uint16_t* out_frequency, uint8_t* out_amplitude) {
+    Voice* voice = &channel_states[channel].grid;
 
-void compute_attributes(NoteAttributes attributes, uint16_t sample_in_sixteenth, uint16_t* out_frequency, uint8_t* out_amplitude) {
     if(
         // Play flag is false
         ((attributes.flags & 0x01) == 0) ||
         // Staccato: first 7/8 of the note plays, last 1/8 is silence
-        (attributes.flags & 0x02 && sample_in_sixteenth >= (samples_per_sixteenth / 8) * 7) ||
+        (attributes.flags & 0x02 && sample_in_sixteenth >= (sixteenth_length / 8) * 7) ||
         // Double note: first 3/8 plays, next 1/8 is silence, last 4/8 plays
-        (attributes.flags & 0x04 && sample_in_sixteenth >= (samples_per_sixteenth / 8) * 3 && sample_in_sixteenth < (samples_per_sixteenth / 8) * 4)
+        (attributes.flags & 0x04 && sample_in_sixteenth >= (sixteenth_length / 8) * 3 && sample_in_sixteenth < (sixteenth_length / 8) * 4)
     ) {
-        *out_frequency = 0;
-        *out_amplitude = 0;
+        if(voice->gate) {
+            voice->gate = false;
+            envelope_note_off(&voice->envelope);
+        }
+
+        if(voice->envelope.id != 0) {
+            // Release of a render-time envelope: keep playing the last note
+            *out_frequency = voice->frequency;
+            *out_amplitude = envelope_apply_gain(voice->volume, envelope_step(&voice->envelope));
+        } else {
+            *out_frequency = 0;
+            *out_amplitude = 0;
+
+            // The grid is silent: play the timeline voice, if any
+            Voice* timeline_voice = &channel_states[channel].timeline;
+            if(timeline_voice->envelope.id != 0) {
+                *out_frequency = timeline_voice->frequency;
+                *out_amplitude = envelope_apply_gain(timeline_voice->volume, envelope_step(&timeline_voice->envelope));
+            } else if(timeline_voice->gate) {
+                *out_frequency = timeline_voice->frequency;
+                *out_amplitude = timeline_voice->volume;
+            }
+        }
     } else {
         *out_frequency = linear_interpolate_16_short(
             attributes.frequency_start,
             attributes.frequency_end,
             sample_in_sixteenth,
-            samples_per_sixteenth
+            sixteenth_length
         );
 
         *out_amplitude = linear_interpolate_8_short(
             attributes.volume_start,
             attributes.volume_end,
             sample_in_sixteenth,
-            samples_per_sixteenth
+            sixteenth_length
         );
-    }
-}
 
-void looper_init(
-    uint16_t length_beats, uint16_t tempo_bpm_value,
-    bool square_enabled, bool sawtooth_enabled, bool triangle_enabled, bool noise_enabled, bool custom_enabled
-) {
-    loop_length_sixteenths = length_beats * 4;
+        if(attributes.envelope != 0) {
+            if(
+                !voice->gate ||
+                voice->envelope.id != attributes.envelope ||
+                (attributes.flags & 0x08 && sample_in_sixteenth == 0)
+            ) {
+                envelope_note_on(&voice->envelope, attributes.envelope);
+            }
 
-    if(square_enabled) {
-        square_notes = (NoteAttributes *)calloc(loop_length_sixteenths, sizeof(NoteAttributes));
-        if(!square_notes) {
-            fprintf(stderr, "Error: Memory allocation failed for square channel in looper_init()\n");
-            exit(EXIT_FAILURE);
+            voice->frequency = *out_frequency;
+            voice->volume = *out_amplitude;
+            *out_amplitude = envelope_apply_gain(*out_amplitude, envelope_step(&voice->envelope));
+        } else if(voice->envelope.id != 0) {
+            // A note without a render-time envelope cuts the previous one
+            envelope_note_on(&voice->envelope, 0);
         }
-        active_channel_count++;
+
+        voice->gate = true;
     }
-    if(sawtooth_enabled) {
-        sawtooth_notes = (NoteAttributes *)calloc(loop_length_sixteenths, sizeof(NoteAttributes));
-        if(!sawtooth_notes) {
-            fprintf(stderr, "Error: Memory allocation failed for sawtooth channel in looper_init()\n");
-            exit(EXIT_FAILURE);
+}
+
+// Offset within the current sixteenth of a timeline event, UINT16_MAX if it is in a later sixteenth
+static uint16_t event_offset(const TimelineEvent* event) {
+    uint32_t position = event->tick * 4; // In 1/ppqn of a sixteenth
+    uint16_t sixteenth = position / timeline_ppqn();
+
+    if(sixteenth < current_sixteenth) return 0; // Already due
+    if(sixteenth > current_sixteenth) return UINT16_MAX;
+    return (uint16_t)((position % timeline_ppqn()) * sixteenth_length / timeline_ppqn());
+}
+
+static void update_next_event_offset(void) {
+    const TimelineEvent* event = timeline_ppqn() ? timeline_peek() : NULL;
+    next_event_offset = event ? event_offset(event) : UINT16_MAX;
+}
+
+// Moves the timeline cursor to the current position, skipping the events before it
+static void sync_timeline(void) {
+    if(timeline_ppqn() == 0) return;
+
+    // First tick at or after the current sample
+    uint64_t position = (uint64_t)current_sixteenth * sixteenth_length + sample_in_sixteenth;
+    uint64_t samples_per_quarter = (uint64_t)sixteenth_length * 4;
+    timeline_seek((uint32_t)((position * timeline_ppqn() + samples_per_quarter - 1) / samples_per_quarter));
+    update_next_event_offset();
+}
+
+// Applies every timeline event due at or before the current sample
+static void process_timeline_events(void) {
+    const TimelineEvent* event;
+    while((event = timeline_peek()) && event_offset(event) <= sample_in_sixteenth) {
+        Voice* voice = &channel_states[event->channel].timeline;
+
+        if(event->type == TIMELINE_NOTE_ON) {
+            voice->gate = true;
+            voice->frequency = event->frequency;
+            voice->volume = event->volume;
+            envelope_note_on(&voice->envelope, event->envelope);
+        } else {
+            voice->gate = false;
+            envelope_note_off(&voice->envelope);
         }
-        active_channel_count++;
+
+        timeline_advance();
     }
-    if(triangle_enabled) {
-        triangle_notes = (NoteAttributes *)calloc(loop_length_sixteenths, sizeof(NoteAttributes));
-        if(!triangle_notes) {
-            fprintf(stderr, "Error: Memory allocation failed for triangle channel in looper_init()\n");
-            exit(EXIT_FAILURE);
-        }
-        active_channel_count++;
+
+    update_next_event_offset();
+}
+
+// Resets the voices of every channel, e.g. after jumping to a different position
+static void reset_channel_states(void) {
+    for(int i = 0; i <= CUSTOM; i++) {
+        envelope_note_on(&channel_states[i].grid.envelope, 0);
+        channel_states[i].grid.gate = false;
+        envelope_note_on(&channel_states[i].timeline.envelope, 0);
+        channel_states[i].timeline.gate = false;
     }
-    if(noise_enabled) {
-        noise_notes = (NoteAttributes *)calloc(loop_length_sixteenths, sizeof(NoteAttributes));
-        if(!noise_notes) {
-            fprintf(stderr, "Error: Memory allocation failed for noise channel in looper_init()\n");
-            exit(EXIT_FAILURE);
-        }
-        active_channel_count++;
+}
+
+static uint32_t compute_samples_per_sixteenth_q16(uint32_t tempo_q16) {
+    return (uint32_t)(((uint64_t)sample_rate * 60 << 32) / ((uint64_t)tempo_q16 * 4));
+}
+
+// Sets the tempo without changing the length of the sixteenth being played
+static void set_tempo(uint32_t tempo_q16) {
+    // Sixteenths must be shorter than 65536 samples, i.e. samples_per_sixteenth_q16 must fit in 32 bits
+    uint32_t min_tempo_q16 = sample_rate * 15 + 1;
+    if(min_tempo_q16 < LOOPER_MIN_TEMPO_Q16) min_tempo_q16 = LOOPER_MIN_TEMPO_Q16;
+
+    if(tempo_q16 < min_tempo_q16) tempo_q16 = min_tempo_q16;
+    // Sixteenths must also be at least one sample long
+    uint32_t max_tempo_q16 = looper_max_tempo_q16();
+    if(tempo_q16 > max_tempo_q16) tempo_q16 = max_tempo_q16;
+    tempo_bpm_q16 = tempo_q16;
+    samples_per_sixteenth_q16 = compute_samples_per_sixteenth_q16(tempo_q16);
+}
+
+// Computes the length of the current sixteenth from the tempo and the fractional accumulator
+static void start_sixteenth(void) {
+    uint32_t length_q16 = samples_per_sixteenth_q16 + sixteenth_fraction_accumulator;
+    sixteenth_length = length_q16 >> 16;
+    sixteenth_fraction_accumulator = length_q16 & 0xFFFF;
+
+    if(next_wavetable_change < wavetable_change_count && wavetable_changes[next_wavetable_change].sixteenth == current_sixteenth) {
+        custom_select(wavetable_changes[next_wavetable_change++].wavetable);
     }
-    if(custom_enabled) {
-        custom_notes = (NoteAttributes *)calloc(loop_length_sixteenths, sizeof(NoteAttributes));
-        if(!custom_notes) {
-            fprintf(stderr, "Error: Memory allocation failed for custom channel in looper_init()\n");
-            exit(EXIT_FAILURE);
-        }
-        active_channel_count++;
+
+    if(timeline_ppqn()) update_next_event_offset();
+}
+
+// Starts the tempo ramp from the given automation point
+static void start_tempo_segment(uint8_t point) {
+    const TempoPoint* from = &tempo_points[point];
+    const TempoPoint* to = &tempo_points[(point + 1) % tempo_point_count];
+
+    uint16_t length = (to->sixteenth + loop_length_sixteenths - from->sixteenth) % loop_length_sixteenths;
+    if(length == 0) length = loop_length_sixteenths;
+
+    tempo_segment = point;
+    tempo_segment_remaining = length;
+    tempo_increment_q16 = ((int32_t)to->tempo_bpm_q16 - (int32_t)from->tempo_bpm_q16) / (int32_t)length;
+    set_tempo(from->tempo_bpm_q16);
+}
+
+// Moves the tempo automation to the beginning of the loop
+static void restart_tempo_automation(void) {
+    if(tempo_point_count == 0) return;
+
+    // The ramp in progress at sixteenth 0 starts from the last point
+    uint8_t point = tempo_point_count - 1;
+    if(tempo_points[0].sixteenth == 0) point = 0;
+    start_tempo_segment(point);
+
+    // Advance the ramp to sixteenth 0
+    uint16_t elapsed = (loop_length_sixteenths - tempo_points[point].sixteenth) % loop_length_sixteenths;
+    tempo_segment_remaining -= elapsed;
+    set_tempo((uint32_t)((int64_t)tempo_bpm_q16 + (int64_t)tempo_increment_q16 * elapsed));
+}
+
+static void advance_tempo_automation(void) {
+    if(--tempo_segment_remaining == 0) {
+        start_tempo_segment((tempo_segment + 1) % tempo_point_count);
+    } else {
+        set_tempo((uint32_t)((int64_t)tempo_bpm_q16 + tempo_increment_q16));
     }
+}
 
+// Moves to the beginning of the loop, without resetting the voices; the fractional accumulator is
+// kept, so that the loop length does not drift either
+static void rewind_loop(void) {
+    current_sixteenth = 0;
+    sample_in_sixteenth = 0;
     current_sample = 0;
-    samples_per_sixteenth = (SAMPLE_RATE * 60) / (tempo_bpm_value * 4);
-    loop_length_samples = samples_per_sixteenth * loop_length_sixteenths;
+    restart_tempo_automation();
+
+    // The wavetable selected at the end of the loop carries over, unless it changes at sixteenth 0
+    next_wavetable_change = 0;
+    if(wavetable_change_count > 0) custom_select(wavetable_changes[wavetable_change_count - 1].wavetable);
+
+    start_sixteenth();
+    sync_timeline();
 }
 
-void looper_free(void) {
-    if(square_notes) {
-        free(square_notes);
-        square_notes = NULL;
+// Moves to the beginning of the next sixteenth, wrapping around at the end of the loop
+static void next_sixteenth(void) {
+    if(++current_sixteenth >= loop_length_sixteenths) {
+        rewind_loop();
+        return;
     }
-    if(sawtooth_notes) {
-        free(sawtooth_notes);
-        sawtooth_notes = NULL;
+
+    sample_in_sixteenth = 0;
+    if(tempo_point_count > 1) advance_tempo_automation();
+    start_sixteenth();
+}
+
+// Moves to the beginning of the given sixteenth by walking through the ones before it,
+// so that the result is the same as playing from the beginning of the loop
+static void seek_sixteenth(uint16_t sixteenth) {
+    sixteenth_fraction_accumulator = 0;
+    rewind_loop();
+
+    while(current_sixteenth < sixteenth && current_sixteenth + 1 < loop_length_sixteenths) {
+        current_sample += sixteenth_length;
+        next_sixteenth();
     }
-    if(triangle_notes) {
-        free(triangle_notes);
-        triangle_notes = NULL;
+
+    reset_channel_states();
+    sync_timeline();
+}
+
+// Like seek_sixteenth(), but moves to the given sample since the beginning of the loop
+static void seek_sample(uint32_t sample) {
+    sixteenth_fraction_accumulator = 0;
+    rewind_loop();
+
+    while(current_sample + sixteenth_length <= sample && current_sixteenth + 1 < loop_length_sixteenths) {
+        current_sample += sixteenth_length;
+        next_sixteenth();
     }
-    if(noise_notes) {
-        free(noise_notes);
-        noise_notes = NULL;
+
+    uint32_t offset = sample - current_sample;
+    sample_in_sixteenth = (uint16_t)(offset < sixteenth_length ? offset : (uint32_t)sixteenth_length - 1);
+    current_sample += sample_in_sixteenth;
+
+    reset_channel_states();
+    sync_timeline();
+}
+
+// Selects the wavetable of the current sixteenth after the changes were modified
+static void sync_wavetable(void) {
+    next_wavetable_change = 0;
+    while(next_wavetable_change < wavetable_change_count && wavetable_changes[next_wavetable_change].sixteenth <= current_sixteenth) {
+        next_wavetable_change++;
     }
-    if(custom_notes) {
-        free(custom_notes);
-        custom_notes = NULL;
+
+    if(wavetable_change_count == 0) return;
+    uint16_t last = next_wavetable_change > 0 ? next_wavetable_change - 1 : wavetable_change_count - 1;
+    custom_select(wavetable_changes[last].wavetable);
+}
+
+void looper_init(
+    uint16_t length_beats, uint16_t tempo_bpm_value,
+    bool square_enabled, bool sawtooth_enabled, bool triangle_enabled, bool noise_enabled, bool custom_enabled
+) {
+    if(capacity_sixteenths < length_beats * 4 && !looper_reserve(length_beats, LOOPER_DEFAULT_CUSTOM_CAPACITY)) {
+        fprintf(stderr, "Error: Memory allocation failed in looper_init()\n");
+        exit(EXIT_FAILURE);
     }
 
+    loop_length_sixteenths = length_beats * 4;
+    custom_set_storage(custom_storage, custom_capacity);
+
+    const bool enabled[CUSTOM + 1] = { square_enabled, sawtooth_enabled, triangle_enabled, noise_enabled, custom_enabled };
     active_channel_count = 0;
+    bytebeat_enabled = false;
+    for(int channel = SQUARE; channel <= CUSTOM; channel++) {
+        channel_enabled[channel] = enabled[channel];
+        grid_clear((Channel)channel, 0, capacity_sixteenths);
+        if(enabled[channel]) active_channel_count++;
+    }
+
+    tempo_point_count = 0;
+    wavetable_change_count = 0;
+    set_tempo((uint32_t)tempo_bpm_value << 16);
+    sixteenth_fraction_accumulator = 0;
+    reset_channel_states();
+    rewind_loop();
 }
 
-void looper_set_note(uint16_t sixteenth, Channel channel, NoteAttributes attributes) {
-    if(sixteenth >= loop_length_sixteenths) return; // Out of bounds
+bool looper_reserve(uint16_t max_length_beats, uint16_t custom_data_capacity) {
+    if(loop_length_sixteenths > 0 || max_length_beats == 0 || max_length_beats > UINT16_MAX / 4) return false;
+
+    size_t sixteenths = (size_t)max_length_beats * 4;
+    size_t grid_pages = (sixteenths + LOOPER_PAGE_SIXTEENTHS - 1) / LOOPER_PAGE_SIXTEENTHS;
+    size_t pool_pages = grid_pages * (CUSTOM + 1) + 1; // Enough for every grid to be distinct, plus EMPTY_PAGE
+
+    arena_free(&arena);
+    if(!arena_init(&arena,
+        arena_block_size(pool_pages * sizeof(NotePage)) +
+        arena_block_size(pool_pages * sizeof(uint16_t)) * 2 +
+        arena_block_size(grid_pages * sizeof(uint16_t)) * (CUSTOM + 1) +
+        arena_block_size(custom_data_capacity)
+    )) {
+        capacity_sixteenths = 0;
+        return false;
+    }
+
+    // Pages are only written when taken from the free list, so unused ones cost no physical memory
+    pages = (NotePage*)arena_alloc_uninitialized(&arena, pool_pages * sizeof(NotePage));
+    page_refs = (uint16_t*)arena_alloc_uninitialized(&arena, pool_pages * sizeof(uint16_t));
+    free_pages = (uint16_t*)arena_alloc_uninitialized(&arena, pool_pages * sizeof(uint16_t));
+    memset(&pages[EMPTY_PAGE], 0, sizeof(NotePage));
+    page_count = (uint16_t)pool_pages;
+    free_page_count = 0;
+    for(uint16_t page = page_count - 1; page > EMPTY_PAGE; page--) free_pages[free_page_count++] = page;
+
+    grid_page_count = (uint16_t)grid_pages;
+    for(int channel = SQUARE; channel <= CUSTOM; channel++) {
+        grid_carve((Channel)channel);
+    }
+    custom_storage = (uint8_t*)arena_alloc(&arena, custom_data_capacity);
+    custom_capacity = custom_data_capacity;
+    capacity_sixteenths = (uint16_t)sixteenths;
+
+    return true;
+}
+
+bool looper_resize(uint16_t length_beats) {
+    uint32_t length = (uint32_t)length_beats * 4;
+    if(loop_length_sixteenths == 0 || length == 0 || length > capacity_sixteenths) return false;
 
+    // Sixteenths added at the end are pauses, whatever they contained before the loop was shortened
+    for(int channel = SQUARE; channel <= CUSTOM; channel++) {
+        grid_clear((Channel)channel, loop_length_sixteenths, (uint16_t)length);
+    }
+
+    uint16_t position = current_sixteenth < length ? current_sixteenth : 0;
+    loop_length_sixteenths = (uint16_t)length;
+
+    while(tempo_point_count > 0 && tempo_points[tempo_point_count - 1].sixteenth >= length) tempo_point_count--;
+    while(wavetable_change_count > 0 && wavetable_changes[wavetable_change_count - 1].sixteenth >= length) wavetable_change_count--;
+    if(timeline_ppqn()) timeline_resize(length_beats);
+
+    seek_sixteenth(position);
+    return true;
+}
+
+bool looper_set_channel_enabled(Channel channel, bool enabled) {
+    if(loop_length_sixteenths == 0 || channel < SQUARE || channel > CUSTOM) return false;
+    if(channel_enabled[channel] == enabled) return true;
+
+    // The notes are kept either way, so that disabling a channel mutes it until it is enabled again
+    if(enabled) active_channel_count++;
+    else active_channel_count--;
+    channel_enabled[channel] = enabled;
+
+    envelope_note_on(&channel_states[channel].grid.envelope, 0);
+    channel_states[channel].grid.gate = false;
+    envelope_note_on(&channel_states[channel].timeline.envelope, 0);
+    channel_states[channel].timeline.gate = false;
+
+    return true;
+}
+
+bool looper_channel_enabled(Channel channel) {
+    return grid_enabled(channel);
+}
+
+void looper_memory_usage(LooperMemory* out) {
+    uint16_t loop_pages = (loop_length_sixteenths + LOOPER_PAGE_SIXTEENTHS - 1) / LOOPER_PAGE_SIXTEENTHS;
+    for(int channel = SQUARE; channel <= CUSTOM; channel++) {
+        size_t used_pages = 0;
+        for(uint16_t i = 0; channel_enabled[channel] && i < loop_pages; i++) {
+            if(grids[channel].page_table[i] != EMPTY_PAGE) used_pages++;
+        }
+        out->channel_bytes[channel] = used_pages * sizeof(NotePage);
+    }
+    out->note_bytes = page_count > 0 ? (size_t)(page_count - 1 - free_page_count) * sizeof(NotePage) : 0;
+    out->custom_data_bytes = custom_data_length();
+    out->used_bytes = arena.used;
+    out->reserved_bytes = arena.capacity;
+}
+
+size_t looper_prefault(void) {
+    size_t bytes = realtime_prefault(arena.base, arena.capacity);
+    for(uint8_t i = 0; i < CUSTOM_MAX_WAVETABLES; i++) {
+        uint32_t length;
+        const uint8_t* data = custom_bank_get(i, &length);
+        if(data) bytes += realtime_prefault_readonly(data, length);
+    }
+    return bytes;
+}
+
+void looper_free(void) {
+    custom_free();
+    custom_set_storage(NULL, 0);
+    arena_free(&arena);
+    memset(grids, 0, sizeof(grids));
+    pages = NULL;
+    page_refs = NULL;
+    free_pages = NULL;
+    page_count = 0;
+    free_page_count = 0;
+    grid_page_count = 0;
+    memset(channel_enabled, 0, sizeof(channel_enabled));
+    capacity_sixteenths = 0;
+    custom_storage = NULL;
+    custom_capacity = 0;
+    loop_length_sixteenths = 0;
+
+    timeline_free();
+    next_event_offset = UINT16_MAX;
+    tempo_point_count = 0;
+    wavetable_change_count = 0;
+    effects_clear();
+
+    active_channel_count = 0;
+    bytebeat_enabled = false;
+}
+
+void looper_set_band_limited(Channel channel, bool band_limited) {
     switch(channel) {
         case SQUARE:
-            square_notes[sixteenth] = attributes;
+            square_set_band_limited(band_limited);
             break;
         case SAWTOOTH:
-            sawtooth_notes[sixteenth] = attributes;
+            sawtooth_set_band_limited(band_limited);
             break;
         case TRIANGLE:
-            triangle_notes[sixteenth] = attributes;
-            break;
-        case NOISE:
-            noise_notes[sixteenth] = attributes;
-            break;
-        case CUSTOM:
-            custom_notes[sixteenth] = attributes;
+            triangle_set_band_limited(band_limited);
             break;
         default:
-            return; // Invalid channel
+            return; // Not supported
     }
 }
 
+void looper_enable_bytebeat(bool enabled) {
+    if(enabled == bytebeat_enabled) return;
+
+    bytebeat_enabled = enabled;
+    if(enabled) {
+        active_channel_count++;
+    } else {
+        active_channel_count--;
+    }
+}
+
+bool looper_bytebeat_enabled(void) {
+    return bytebeat_enabled;
+}
+
+void looper_enable_timeline(uint16_t ppqn) {
+    timeline_free();
+    timeline_init(ppqn, loop_length_sixteenths / 4);
+    sync_timeline();
+}
+
+bool looper_add_timeline_note(Channel channel, uint32_t tick, uint32_t length_ticks, uint16_t frequency, uint8_t volume, uint8_t envelope) {
+    uint32_t length = timeline_length_ticks();
+    // A note as long as the loop would end on the tick it starts on, so it would never end
+    if(!grid_enabled(channel) || tick >= length || length_ticks == 0 || length_ticks >= length) return false;
+
+    TimelineEvent note_on = {
+        .tick = tick,
+        .frequency = frequency,
+        .volume = volume,
+        .envelope = envelope,
+        .channel = channel,
+        .type = TIMELINE_NOTE_ON
+    };
+    // Notes that go past the end of the loop end after it wraps around
+    TimelineEvent note_off = {
+        .tick = (uint32_t)(((uint64_t)tick + length_ticks) % length),
+        .channel = channel,
+        .type = TIMELINE_NOTE_OFF
+    };
+
+    if(!timeline_insert(&note_on) || !timeline_insert(&note_off)) return false;
+
+    update_next_event_offset();
+    return true;
+}
+
+void looper_set_note(uint16_t sixteenth, Channel channel, NoteAttributes attributes) {
+    if(!grid_enabled(channel) || sixteenth >= loop_length_sixteenths) return; // Out of bounds or channel not enabled
+
+    grid_set(channel, sixteenth, attributes);
+}
+
 void looper_set_notes_equal(uint16_t start_sixteenth, uint16_t length_sixteenths, Channel channel, NoteAttributes attributes) {
     uint16_t end_sixteenth = start_sixteenth + length_sixteenths;
     if(end_sixteenth > loop_length_sixteenths) end_sixteenth = loop_length_sixteenths;
@@ -167,149 +853,405 @@ void looper_set_notes_equal(uint16_t start_sixteenth, uint16_t length_sixteenths
 }
 
 void looper_set_notes(uint16_t start_sixteenth, uint16_t length_sixteenths, Channel channel, NoteAttributes* notes_array) {
-    uint16_t end_sixteenth = start_sixteenth + length_sixteenths;
-    if(end_sixteenth > loop_length_sixteenths) end_sixteenth = loop_length_sixteenths;
+    if(!grid_enabled(channel) || start_sixteenth >= loop_length_sixteenths) return; // Out of bounds or channel not enabled
 
-    for(uint16_t i = start_sixteenth; i < end_sixteenth; i++) {
-        looper_set_note(i, channel, notes_array[i - start_sixteenth]);
+    uint16_t available = loop_length_sixteenths - start_sixteenth;
+    if(length_sixteenths > available) length_sixteenths = available;
+
+    for(uint16_t i = 0; i < length_sixteenths; i++) {
+        grid_set(channel, start_sixteenth + i, notes_array[i]);
     }
 }
 
 uint16_t looper_read_notes(uint16_t start_sixteenth, uint16_t length_sixteenths, Channel channel, NoteAttributes* out_notes_array){
-    NoteAttributes* source_array = NULL;
-    switch(channel) {
-        case SQUARE:
-            source_array = square_notes;
-            break;
-        case SAWTOOTH:
-            source_array = sawtooth_notes;
-            break;
-        case TRIANGLE:
-            source_array = triangle_notes;
-            break;
-        case NOISE:
-            source_array = noise_notes;
-            break;
-        case CUSTOM:
-            source_array = custom_notes;
-            break;
-        default:
-            return 0; // Invalid channel
+    if(!grid_enabled(channel) || start_sixteenth >= loop_length_sixteenths) return 0; // Out of bounds or channel not enabled
+
+    uint16_t available = loop_length_sixteenths - start_sixteenth;
+    if(length_sixteenths > available) length_sixteenths = available;
+
+    for(uint16_t i = 0; i < length_sixteenths; i++) {
+        out_notes_array[i] = grid_get(channel, start_sixteenth + i);
     }
 
-    if(!source_array || start_sixteenth >= loop_length_sixteenths) return 0; // Out of bounds or channel not enabled
+    return length_sixteenths; // Number of notes read
+}
 
-    uint16_t available = loop_length_sixteenths - start_sixteenth;
-    uint16_t i;
-    for(i = 0; i < length_sixteenths && i < available; i++) {
-        out_notes_array[i] = source_array[start_sixteenth + i];
+uint16_t looper_copy_notes(
+    Channel src_channel, uint16_t src_start_sixteenth,
+    Channel dest_channel, uint16_t dest_start_sixteenth,
+    uint16_t length_sixteenths
+) {
+    if(!grid_enabled(src_channel) || !grid_enabled(dest_channel)) return 0; // Channel not enabled
+    if(src_start_sixteenth >= loop_length_sixteenths || dest_start_sixteenth >= loop_length_sixteenths) return 0; // Out of bounds
+
+    uint16_t available = loop_length_sixteenths - (src_start_sixteenth > dest_start_sixteenth ? src_start_sixteenth : dest_start_sixteenth);
+    if(length_sixteenths > available) length_sixteenths = available;
+
+    // Whole pages are shared when both sections have the same offset within their pages
+    bool aligned = src_start_sixteenth % LOOPER_PAGE_SIXTEENTHS == dest_start_sixteenth % LOOPER_PAGE_SIXTEENTHS;
+    #define PAGE_START(i) (aligned && (src_start_sixteenth + (i)) % LOOPER_PAGE_SIXTEENTHS == 0)
+
+    if(src_channel != dest_channel || dest_start_sixteenth <= src_start_sixteenth) {
+        uint16_t i = 0;
+        while(i < length_sixteenths) {
+            if(PAGE_START(i) && length_sixteenths - i >= LOOPER_PAGE_SIXTEENTHS) {
+                grid_share_page(
+                    src_channel, (src_start_sixteenth + i) / LOOPER_PAGE_SIXTEENTHS,
+                    dest_channel, (dest_start_sixteenth + i) / LOOPER_PAGE_SIXTEENTHS
+                );
+                i += LOOPER_PAGE_SIXTEENTHS;
+            } else {
+                grid_copy_note(src_channel, src_start_sixteenth + i, dest_channel, dest_start_sixteenth + i);
+                i++;
+            }
+        }
+    } else {
+        // Overlapping sections in the same channel: copy backwards, so that notes are read before being overwritten
+        uint16_t i = length_sixteenths;
+        while(i > 0) {
+            if(i >= LOOPER_PAGE_SIXTEENTHS && PAGE_START(i - LOOPER_PAGE_SIXTEENTHS)) {
+                i -= LOOPER_PAGE_SIXTEENTHS;
+                grid_share_page(
+                    src_channel, (src_start_sixteenth + i) / LOOPER_PAGE_SIXTEENTHS,
+                    dest_channel, (dest_start_sixteenth + i) / LOOPER_PAGE_SIXTEENTHS
+                );
+            } else {
+                i--;
+                grid_copy_note(src_channel, src_start_sixteenth + i, dest_channel, dest_start_sixteenth + i);
+            }
+        }
     }
 
-    return i; // Number of notes read
+    #undef PAGE_START
+
+    #ifdef LOOPER_COMPACT_NOTES
+    decoded_sixteenths[dest_channel] = UINT16_MAX;
+    #endif
+
+    return length_sixteenths; // Number of notes copied
+}
+
+bool looper_set_sample_rate(uint32_t rate) {
+    if(rate < LOOPER_MIN_SAMPLE_RATE || rate > LOOPER_MAX_SAMPLE_RATE) return false;
+    if(rate == sample_rate) return true;
+
+    sample_rate = rate;
+    square_set_sample_rate(rate);
+    sawtooth_set_sample_rate(rate);
+    triangle_set_sample_rate(rate);
+    noise_set_sample_rate(rate);
+    custom_set_sample_rate(rate);
+    envelope_set_sample_rate(rate);
+    effects_set_sample_rate(rate);
+    bytebeat_set_sample_rate(rate);
+
+    set_tempo(tempo_bpm_q16);
+    seek_sixteenth(current_sixteenth);
+    return true;
+}
+
+uint32_t looper_sample_rate(void) {
+    return sample_rate;
 }
 
 void looper_change_tempo(uint16_t new_tempo_bpm) {
-    uint16_t new_samples_per_sixteenth = (SAMPLE_RATE * 60) / (new_tempo_bpm * 4);
+    looper_change_tempo_q16((uint32_t)new_tempo_bpm << 16);
+}
+
+void looper_change_tempo_q16(uint32_t new_tempo_bpm_q16) {
+    tempo_point_count = 0; // A fixed tempo replaces the automation
+
+    set_tempo(new_tempo_bpm_q16);
+
+    // Keep the same relative position within the current sixteenth
+    uint16_t old_length = sixteenth_length;
+    sixteenth_length = samples_per_sixteenth_q16 >> 16;
+    sample_in_sixteenth = old_length > 0 ? (uint32_t)sample_in_sixteenth * sixteenth_length / old_length : 0;
+    if(timeline_ppqn()) update_next_event_offset();
+}
+
+uint32_t looper_max_tempo_q16(void) {
+    // 4 sixteenths per beat, each sample_rate / (tempo * 4 / 60) >= 1 samples long
+    uint64_t max_tempo_q16 = (uint64_t)sample_rate * 15 << 16;
+    return max_tempo_q16 < UINT32_MAX ? (uint32_t)max_tempo_q16 : UINT32_MAX;
+}
+
+uint32_t looper_tempo_q16(void) {
+    return tempo_bpm_q16;
+}
 
-    // Adjust current_sample to maintain position in the loop
-    current_sample = (uint32_t)((uint64_t)current_sample * samples_per_sixteenth / new_samples_per_sixteenth);
+bool looper_add_tempo_point(uint16_t sixteenth, uint32_t tempo_bpm_q16_value) {
+    if(sixteenth >= loop_length_sixteenths) return false;
+    if(tempo_bpm_q16_value < LOOPER_MIN_TEMPO_Q16) tempo_bpm_q16_value = LOOPER_MIN_TEMPO_Q16;
+
+    // Keep the points sorted, replacing any point on the same sixteenth
+    uint8_t index = 0;
+    while(index < tempo_point_count && tempo_points[index].sixteenth < sixteenth) index++;
+
+    if(index == tempo_point_count || tempo_points[index].sixteenth != sixteenth) {
+        if(tempo_point_count >= LOOPER_MAX_TEMPO_POINTS) return false;
+        memmove(&tempo_points[index + 1], &tempo_points[index], (tempo_point_count - index) * sizeof(TempoPoint));
+        tempo_point_count++;
+    }
+    tempo_points[index] = (TempoPoint){ .sixteenth = sixteenth, .tempo_bpm_q16 = tempo_bpm_q16_value };
+
+    // Recompute the tempo at the current position
+    uint16_t previous_sample_in_sixteenth = sample_in_sixteenth;
+    seek_sixteenth(current_sixteenth);
+    sample_in_sixteenth = previous_sample_in_sixteenth < sixteenth_length ? previous_sample_in_sixteenth : sixteenth_length - 1;
+    current_sample += sample_in_sixteenth;
+    return true;
+}
 
-    samples_per_sixteenth = new_samples_per_sixteenth;
-    loop_length_samples = samples_per_sixteenth * loop_length_sixteenths;
+void looper_clear_tempo_automation(void) {
+    tempo_point_count = 0;
+}
+
+bool looper_set_wavetable(uint16_t sixteenth, uint8_t wavetable) {
+    if(sixteenth >= loop_length_sixteenths || wavetable >= CUSTOM_MAX_WAVETABLES) return false;
+
+    // Keep the changes sorted, replacing any change on the same sixteenth
+    uint16_t index = 0;
+    while(index < wavetable_change_count && wavetable_changes[index].sixteenth < sixteenth) index++;
+
+    if(index == wavetable_change_count || wavetable_changes[index].sixteenth != sixteenth) {
+        if(wavetable_change_count >= LOOPER_MAX_WAVETABLE_CHANGES) return false;
+        memmove(&wavetable_changes[index + 1], &wavetable_changes[index], (wavetable_change_count - index) * sizeof(WavetableChange));
+        wavetable_change_count++;
+    }
+    wavetable_changes[index] = (WavetableChange){ .sixteenth = sixteenth, .wavetable = wavetable };
+
+    sync_wavetable();
+    return true;
+}
+
+void looper_clear_wavetables(void) {
+    wavetable_change_count = 0;
+    next_wavetable_change = 0;
 }
 
 uint16_t looper_samples_per_sixteenth(void) {
-    return samples_per_sixteenth;
+    return (samples_per_sixteenth_q16 + 0x8000) >> 16;
 }
 
-uint8_t looper_step(void) {
-    uint16_t note_index = looper_current_sixteenth() % loop_length_sixteenths;
+uint32_t looper_samples_per_sixteenth_q16(void) {
+    return samples_per_sixteenth_q16;
+}
+
+// Renders the next sample, returning the sum of the channels' values centered around 0 (-128 to 127 each).
+// If channel_values is not NULL, the value of each enabled channel is stored at channel_values[channel * MIX_BLOCK].
+static int32_t mix_sample(int32_t* channel_values) {
+    if(sample_in_sixteenth >= next_event_offset) process_timeline_events();
 
-    uint16_t sample_in_sixteenth = current_sample % samples_per_sixteenth;
+    uint16_t note_index = current_sixteenth;
 
-    uint16_t value = 0;
+    int32_t sum = 0;
     
-    if(square_notes) {
+    if(grid_enabled(SQUARE)) {
         uint16_t frequency;
         uint8_t amplitude;
-        compute_attributes(square_notes[note_index], sample_in_sixteenth, &frequency, &amplitude);
+        compute_attributes(SQUARE, grid_play(SQUARE, note_index), sample_in_sixteenth, &frequency, &amplitude);
 
         square_set_frequency(frequency);
         square_set_amplitude(amplitude);
 
-        value += square_step();
+        int32_t value = square_step() - 128;
+        if(channel_values) channel_values[SQUARE * MIX_BLOCK] = value;
+        sum += value;
     }
-    if(sawtooth_notes) {
+    if(grid_enabled(SAWTOOTH)) {
         uint16_t frequency;
         uint8_t amplitude;
-        compute_attributes(sawtooth_notes[note_index], sample_in_sixteenth, &frequency, &amplitude);
+        compute_attributes(SAWTOOTH, grid_play(SAWTOOTH, note_index), sample_in_sixteenth, &frequency, &amplitude);
 
         sawtooth_set_frequency(frequency);
         sawtooth_set_amplitude(amplitude);
 
-        value += sawtooth_step();
+        int32_t value = sawtooth_step() - 128;
+        if(channel_values) channel_values[SAWTOOTH * MIX_BLOCK] = value;
+        sum += value;
     }
-    if(triangle_notes) {
+    if(grid_enabled(TRIANGLE)) {
         uint16_t frequency;
         uint8_t amplitude;
-        compute_attributes(triangle_notes[note_index], sample_in_sixteenth, &frequency, &amplitude);
+        compute_attributes(TRIANGLE, grid_play(TRIANGLE, note_index), sample_in_sixteenth, &frequency, &amplitude);
 
         triangle_set_frequency(frequency);
         triangle_set_amplitude(amplitude);
 
-        value += triangle_step();
+        int32_t value = triangle_step() - 128;
+        if(channel_values) channel_values[TRIANGLE * MIX_BLOCK] = value;
+        sum += value;
     }
-    if(noise_notes) {
-        uint16_t frequency; // Frequency not used for noise, but needed for compute_attributes
+    if(grid_enabled(NOISE)) {
+        uint16_t frequency; // Clock rate of the noise, 0 for a new value at every sample
         uint8_t amplitude;
-        compute_attributes(noise_notes[note_index], sample_in_sixteenth, &frequency, &amplitude);
+        compute_attributes(NOISE, grid_play(NOISE, note_index), sample_in_sixteenth, &frequency, &amplitude);
 
+        noise_set_frequency(frequency);
         noise_set_amplitude(amplitude);
 
-        value += noise_step();
+        int32_t value = noise_step() - 128;
+        if(channel_values) channel_values[NOISE * MIX_BLOCK] = value;
+        sum += value;
     }
-    if(custom_notes) {
+    if(grid_enabled(CUSTOM)) {
         uint16_t frequency;
         uint8_t amplitude;
-        compute_attributes(custom_notes[note_index], sample_in_sixteenth, &frequency, &amplitude);
+        compute_attributes(CUSTOM, grid_play(CUSTOM, note_index), sample_in_sixteenth, &frequency, &amplitude);
 
         custom_set_frequency(frequency);
         custom_set_amplitude(amplitude);
 
-        value += custom_step();
+        int32_t value = custom_step() - 128;
+        if(channel_values) channel_values[CUSTOM * MIX_BLOCK] = value;
+        sum += value;
     }
 
-    current_sample = (current_sample + 1) % loop_length_samples;
+    current_sample++;
+    if(++sample_in_sixteenth >= sixteenth_length) next_sixteenth();
+
+    return sum;
+}
+
+uint8_t looper_step(void) {
+    uint32_t position = current_sample;
+    int32_t sum = mix_sample(NULL);
+    if(bytebeat_enabled) {
+        uint8_t value;
+        bytebeat_fill(&position, &value, 1);
+        sum += value - 128;
+    }
+    if(effects_count() > 0) effects_process(&sum, 1);
+    if(active_channel_count == 0) return 128;
 
-    value /= active_channel_count;
+    // Average of the channels' unsigned values
+    int32_t value = (sum + 128 * active_channel_count) / active_channel_count;
     if(value > 255) value = 255; // Clamp to 8-bit range
+    if(value < 0) value = 0;
     return value;
 }
 
+// Smallest absolute value of the mix that exceeds the range of the output (-1.0 to 1.0) once scaled by the master gain
+static uint32_t master_clip_level(void) {
+    if(master_gain <= 0) return METER_NO_CLIP;
+    double level = floor(128.0 / master_gain) + 1;
+    return level < UINT32_MAX ? (uint32_t)level : UINT32_MAX;
+}
+
+void looper_render(float* out, uint32_t count) {
+    const float scale = master_gain / 128.0f;
+
+    if(!bytebeat_enabled && effects_count() == 0 && !meters_enabled) {
+        TRACE_BEGIN("mix channels");
+        for(uint32_t i = 0; i < count; i++) {
+            out[i] = (float)mix_sample(NULL) * scale;
+        }
+        TRACE_END("mix channels");
+        return;
+    }
+
+    // Mix a block, add the bytebeat channel, run it through the effects, meter it, then scale it
+    int32_t block[MIX_BLOCK];
+    uint32_t positions[MIX_BLOCK];
+    uint8_t bytebeat_block[MIX_BLOCK];
+    if(meters_enabled) {
+        for(uint8_t meter = 0; meter < LOOPER_METER_COUNT; meter++) meter_start_block(&meters[meter]);
+    }
+    while(count > 0) {
+        uint32_t block_count = count < MIX_BLOCK ? count : MIX_BLOCK;
+        TRACE_BEGIN("mix channels");
+        for(uint32_t i = 0; i < block_count; i++) {
+            positions[i] = current_sample;
+            block[i] = mix_sample(meters_enabled ? &channel_blocks[0][i] : NULL);
+        }
+        TRACE_END("mix channels");
+
+        if(bytebeat_enabled) {
+            TRACE_BEGIN("bytebeat");
+            bytebeat_fill(positions, bytebeat_block, block_count);
+            int32_t* bytebeat_values = channel_blocks[LOOPER_METER_BYTEBEAT];
+            for(uint32_t i = 0; i < block_count; i++) {
+                bytebeat_values[i] = bytebeat_block[i] - 128;
+                block[i] += bytebeat_values[i];
+            }
+            TRACE_END("bytebeat");
+        }
+        if(effects_count() > 0) {
+            TRACE_BEGIN("effects");
+            effects_process(block, block_count);
+            TRACE_END("effects");
+        }
+        if(meters_enabled) {
+            TRACE_BEGIN("meters");
+            // Only the mix can clip, when it exceeds the range of the output; a channel at full scale does not
+            for(int channel = SQUARE; channel <= CUSTOM; channel++) {
+                if(channel_enabled[channel]) meter_process(&meters[channel], channel_blocks[channel], block_count, METER_NO_CLIP);
+            }
+            if(bytebeat_enabled) meter_process(&meters[LOOPER_METER_BYTEBEAT], channel_blocks[LOOPER_METER_BYTEBEAT], block_count, METER_NO_CLIP);
+            meter_process(&meters[LOOPER_METER_MASTER], block, block_count, master_clip_level());
+            TRACE_END("meters");
+        }
+
+        for(uint32_t i = 0; i < block_count; i++) {
+            out[i] = (float)block[i] * scale;
+        }
+        out += block_count;
+        count -= block_count;
+    }
+}
+
+void looper_enable_meters(bool enabled) {
+    if(enabled && !meters_enabled) looper_reset_meters();
+    meters_enabled = enabled;
+}
+
+bool looper_meters_enabled(void) {
+    return meters_enabled;
+}
+
+void looper_reset_meters(void) {
+    for(uint8_t meter = 0; meter < LOOPER_METER_COUNT; meter++) meter_reset(&meters[meter]);
+}
+
+void looper_read_meter(uint8_t meter, MeterReading* out) {
+    // The mix is read in units of the output, so that levels above 1.0 are clipped
+    float full_scale = meter == LOOPER_METER_MASTER ? 128.0f / master_gain : 128.0f;
+    meter_read(&meters[meter], full_scale, out);
+}
+
+void looper_set_master_gain(float gain) {
+    master_gain = gain;
+}
+
+float looper_master_gain(void) {
+    return master_gain;
+}
+
 uint32_t looper_current_sample(void) {
     return current_sample;
 }
 
 uint16_t looper_current_sixteenth(void) {
-    return current_sample / samples_per_sixteenth;
+    return current_sixteenth;
 }
 
 uint16_t looper_current_beat(void) {
-    return current_sample / (samples_per_sixteenth * 4);
+    return current_sixteenth / 4;
 }
 
 void looper_to_sample(uint32_t sample) {
-    current_sample = sample;
+    seek_sample(sample);
 }
 
 void looper_to_sixteenth(uint16_t sixteenth) {
-    current_sample = (uint32_t)sixteenth * samples_per_sixteenth;
+    seek_sixteenth(sixteenth);
 }
 
 void looper_to_beat(uint16_t beat) {
-    current_sample = (uint32_t)beat * samples_per_sixteenth * 4;
+    seek_sixteenth(beat * 4);
 }
 
 void looper_restart(void) {
-    current_sample = 0;
-}
\ No newline at end of file
+    seek_sixteenth(0);
+}
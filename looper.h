@@ -7,7 +7,18 @@
  * This module allows for the creation and manipulation of a musical looper with multiple waveform channels.
  * Each channel can have its own set of notes defined by various attributes such as frequency and volume.
  * The looper supports real-time tempo changes and provides functions to step through the audio samples.
- * Note that the chosen BPM is only approximate, as the looper is limited to having an integer number of samples per sixteenth note.
+ *
+ * The tempo can be fractional, and the length of a sixteenth note is tracked in Q16 fixed point:
+ * individual sixteenths are a whole number of samples long, but the fractional part is carried over
+ * to the following ones, so the loop does not drift from the exact tempo over time. The tempo can also
+ * be automated with `looper_add_tempo_point()`, ramping linearly between points.
+ *
+ * Notes can either have their envelope baked into `volume_start` and `volume_end` by the composer,
+ * or reference a render-time envelope (see envelope.h), which the looper evaluates for every sample
+ * starting from the note on; render-time envelopes are not affected by tempo changes.
+ *
+ * The looper renders at `SAMPLE_RATE` by default; `looper_set_sample_rate()` changes the sample rate
+ * at runtime, for the looper and every module it drives (oscillators, envelopes and wavetables).
  * 
  * @author Ovidio1005
  * @date 2025-11-15
@@ -18,8 +29,80 @@
 // - Get rid of the channel-amplitude logic - we already have volume per note
 // - Condense `play`, `is_double`, and `staccato` into a single `uint8_t` bitmask to save 2 bytes per note
 
+#include "meters.h"
+
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Maximum number of tempo automation points.
+ */
+#define LOOPER_MAX_TEMPO_POINTS 64
+
+/**
+ * @brief Maximum number of wavetable changes of the custom channel, see `looper_set_wavetable()`.
+ */
+#define LOOPER_MAX_WAVETABLE_CHANGES 256
+
+/**
+ * @brief Converts a (possibly fractional) tempo in BPM to Q16 fixed point.
+ */
+#define LOOPER_TEMPO_Q16(bpm) ((uint32_t)((bpm) * 65536.0 + 0.5))
+
+/**
+ * @brief Minimum supported tempo, in Q16 fixed point; lower tempos are clamped to this value.
+ *
+ * @details At high sample rates the minimum tempo is higher, so that a sixteenth is always shorter
+ * than 65536 samples.
+ */
+#define LOOPER_MIN_TEMPO_Q16 LOOPER_TEMPO_Q16(16)
+
+/**
+ * @brief Default master gain of the mix bus (see `looper_set_master_gain()`).
+ */
+#define LOOPER_DEFAULT_MASTER_GAIN 0.25f
+
+/**
+ * @brief Minimum sample rate supported by `looper_set_sample_rate()`, in Hz.
+ */
+#define LOOPER_MIN_SAMPLE_RATE 1000
+
+/**
+ * @brief Maximum sample rate supported by `looper_set_sample_rate()`, in Hz.
+ */
+#define LOOPER_MAX_SAMPLE_RATE 192000
+
+/**
+ * @brief Capacity for the custom waveform reserved by `looper_init()`, in samples.
+ */
+#define LOOPER_DEFAULT_CUSTOM_CAPACITY 8192
+
+/**
+ * @brief Number of sixteenths in a page of notes; must be at least 8.
+ *
+ * @details The notes of each channel are stored in pages shared by all the channels. Sections that
+ * contain the same notes, such as the copies made by `looper_copy_notes()`, point to the same pages,
+ * and a page is only copied when one of the sections using it is modified. Pages that only contain
+ * pauses take no memory. Copies share whole pages when the source and the destination start at the
+ * same offset within a page, e.g. when both start on a bar for 4/4 loops.
+ */
+#define LOOPER_PAGE_SIXTEENTHS 64
+
+/**
+ * @brief Step of the pitch slides of compact notes, in cents.
+ *
+ * @details When `LOOPER_COMPACT_NOTES` is defined at compile time, the looper stores each note in
+ * 4 bytes instead of `sizeof(NoteAttributes)`, in one array per field so that rendering a pause only
+ * reads its flags: the flags and the render-time envelope share a byte, the starting frequency is
+ * stored as a pitch in cents above C0 (i.e. note index * 100 + cents), the ending frequency as the
+ * difference from it in steps of `LOOPER_COMPACT_GLIDE_CENTS` (up to about ±32 semitones), and the
+ * volumes in 16 steps each. Notes read back with `looper_read_notes()` are quantized accordingly:
+ * frequencies are within 1 cent of the original ones (plus half a glide step for ending frequencies),
+ * except that frequencies up to C0 become C0 and 0 Hz (noise changing value at every sample) is kept
+ * exactly, and volumes within 8.
+ */
+#define LOOPER_COMPACT_GLIDE_CENTS 25
 
 /**
  * @brief Attributes defining a (portion of a) musical note.
@@ -30,8 +113,11 @@ typedef struct note_attributes {
      * Bit 0: Play - If set to false (0), the note represents a pause and every other attribute is ignored.
      * Bit 1: Staccato - Set to false (0) to chain multiple notes into a single, longer note; set to true (1) to add a short pause between notes.
      * Bit 2: Double Note - If set to true (1), a small pause is added to the middle of the note, effectively turning it into two shorter notes.
+     * Bit 3: Note On - If set to true (1), the render-time envelope restarts at the beginning of this sixteenth, even if the previous one was playing.
      */
     uint8_t flags;
+    /** The ID of the render-time envelope applied to the note (see `envelope_render_id()`), or 0 to use `volume_start` and `volume_end` as they are. */
+    uint8_t envelope;
 
     /** The starting frequency of the note in Hz. */
     uint16_t frequency_start;
@@ -54,14 +140,50 @@ typedef enum channel {
     CUSTOM
 } Channel;
 
+/**
+ * @brief Memory used by the looper, see `looper_memory_usage()`.
+ */
+typedef struct looper_memory {
+    /**
+     * Bytes of the pages holding the notes of each channel, indexed by `Channel`; 0 for disabled channels.
+     * Pages shared with other sections are counted every time they are used.
+     */
+    size_t channel_bytes[CUSTOM + 1];
+    /** Bytes of the pages holding notes, counting shared pages once. */
+    size_t note_bytes;
+    /** Bytes used by the data of the custom waveform. */
+    size_t custom_data_bytes;
+    /** Bytes of the looper's arena taken by the notes and the custom waveform, at their maximum size. */
+    size_t used_bytes;
+    /** Total size of the looper's arena, in bytes. */
+    size_t reserved_bytes;
+} LooperMemory;
+
+/**
+ * @brief Allocates, in a single block, the memory the looper needs for loops up to a given length.
+ *
+ * @details Notes for all the channels, enabled or not, and the data of the custom waveform are carved
+ * from this block, so that `looper_resize()` and `looper_set_channel_enabled()` never allocate, and
+ * `looper_init()` does not either if the loop fits. Must be called before `looper_init()` (or after
+ * `looper_free()`), which otherwise reserves memory for the length it is given.
+ *
+ * @param max_length_beats The maximum length of the loop, in beats.
+ * @param custom_data_capacity The maximum length of the custom waveform (see `custom_set_data()`), in samples.
+ * @return false if the memory could not be allocated or the looper is initialized, true otherwise.
+ */
+bool looper_reserve(uint16_t max_length_beats, uint16_t custom_data_capacity);
+
 /**
  * @brief Initializes the looper with the specified length and tempo.
  * 
- * @details This function allocate the necessary memory and sets the current step to the beginning of the loop.
- * It must be called before any other function in this module.
+ * @details This function sets the current step to the beginning of the loop, and must be called before
+ * any other function in this module except `looper_reserve()`. Memory is taken from the block reserved
+ * with `looper_reserve()` if the loop fits in it; otherwise a block just big enough for this loop (and
+ * `LOOPER_DEFAULT_CUSTOM_CAPACITY` samples of custom waveform) is reserved, and the program terminates
+ * if that fails.
  * 
  * The contents of the loop for each active channel are set to all pauses by default.
- * Memory for the inactive channels is not allocated, so they should not be used.
+ * Inactive channels ignore the notes set on them until they are enabled.
  * The number of active channels is used to scale the final waveform output.
  * 
  * This function does not free any previously allocated memory;
@@ -87,7 +209,8 @@ void looper_init(
  * @brief Frees all allocated resources used by the looper.
  * 
  * @details This function should be called when the looper is no longer needed, to avoid memory leaks.
- * It frees all memory allocated by looper_init(), and should be called before calling looper_init() again.
+ * It frees all memory reserved by looper_reserve() or looper_init(), including the data of the custom
+ * waveform, and should be called before calling looper_init() again.
  * 
  * Once this function is called, no other functions in this module should be used until looper_init() is called again.
  * 
@@ -95,6 +218,55 @@ void looper_init(
  */
 void looper_free(void);
 
+/**
+ * @brief Changes the length of the loop, keeping its notes.
+ *
+ * @details No memory is allocated: the new length must fit in the memory reserved by `looper_reserve()`
+ * or `looper_init()`. Notes, tempo automation points and timeline events past the new end are removed,
+ * and sixteenths added at the end are pauses. Playback continues from the same sixteenth, or from the
+ * beginning of the loop if that sixteenth was removed.
+ *
+ * @param length_beats The new length of the loop, in beats.
+ * @return false if the looper is not initialized or the length does not fit, true otherwise.
+ */
+bool looper_resize(uint16_t length_beats);
+
+/**
+ * @brief Enables or disables a channel, without allocating memory.
+ *
+ * @details Disabling a channel mutes it: it keeps its notes, and the pages holding them, and plays them
+ * again once it is enabled (the notes of a disabled channel cannot be changed meanwhile). No memory is
+ * released, since the notes of every channel are reserved up front (see `looper_reserve()`). Channels
+ * that were never enabled since `looper_init()` hold only pauses.
+ *
+ * `looper_render()` mixes the channels at a fixed gain (see `looper_set_master_gain()`), so the level
+ * of the other channels does not change; `looper_step()` averages the enabled channels instead.
+ *
+ * @param channel The channel.
+ * @param enabled Whether the channel is played.
+ * @return false if the looper is not initialized or the channel is invalid, true otherwise.
+ */
+bool looper_set_channel_enabled(Channel channel, bool enabled);
+
+/**
+ * @brief Checks whether a channel is enabled.
+ */
+bool looper_channel_enabled(Channel channel);
+
+/**
+ * @brief Retrieves the memory used by the looper.
+ * @param out Set to the memory used per channel and in total.
+ */
+void looper_memory_usage(LooperMemory* out);
+
+/**
+ * @brief Faults in the memory read and written while rendering, see `realtime_prefault()`.
+ * @details Covers the whole arena, including its unused part, and the wavetables of the custom channel,
+ * which may be memory-mapped files that were never read. Call it again after changing the song.
+ * @return The number of bytes prefaulted, counting wavetables used more than once each time.
+ */
+size_t looper_prefault(void);
+
 /**
  * @brief Sets the note attributes for a specific sixteenth note on a given channel.
  * 
@@ -135,6 +307,159 @@ void looper_set_notes(uint16_t start_sixteenth, uint16_t length_sixteenths, Chan
  */
 uint16_t looper_read_notes(uint16_t start_sixteenth, uint16_t length_sixteenths, Channel channel, NoteAttributes* out_notes_array);
 
+/**
+ * @brief Copies the notes of a section to another section of the same or another channel.
+ *
+ * @details The sections may overlap. Whole pages of notes (see `LOOPER_PAGE_SIXTEENTHS`) are shared
+ * rather than copied, so copying a long page-aligned section takes time proportional to its number
+ * of pages and no memory until either section is modified. The copy stops at the end of the loop.
+ *
+ * @param src_channel The channel to copy the notes from.
+ * @param src_start_sixteenth The first sixteenth of the section to copy.
+ * @param dest_channel The channel to copy the notes to.
+ * @param dest_start_sixteenth The first sixteenth of the destination section.
+ * @param length_sixteenths The number of sixteenths to copy.
+ * @return The number of notes copied.
+ */
+uint16_t looper_copy_notes(
+    Channel src_channel, uint16_t src_start_sixteenth,
+    Channel dest_channel, uint16_t dest_start_sixteenth,
+    uint16_t length_sixteenths
+);
+
+/**
+ * @brief Selects whether a channel's oscillator uses band-limited wavetables (see bandlimited.h).
+ *
+ * @details Only the square, sawtooth and triangle channels support band-limited output;
+ * for the other channels this function does nothing.
+ *
+ * @param channel The waveform channel to configure.
+ * @param band_limited true to use band-limited wavetables, false to use the naive waveform.
+ */
+void looper_set_band_limited(Channel channel, bool band_limited);
+
+/**
+ * @brief Enables or disables the bytebeat channel, which is mixed with the other channels.
+ *
+ * @details The bytebeat channel does not play notes from the grid: it plays the formula set with
+ * `bytebeat_set_formula()`, with `t` counting from the beginning of the loop (see bytebeat.h). It is
+ * counted as an active channel by `looper_step()`, and is disabled by `looper_init()`.
+ *
+ * @param enabled Whether the channel is enabled.
+ */
+void looper_enable_bytebeat(bool enabled);
+
+/**
+ * @brief Retrieves whether the bytebeat channel is enabled.
+ */
+bool looper_bytebeat_enabled(void);
+
+/**
+ * @brief Index of the meter of the bytebeat channel, after those of the channels (indexed by `Channel`).
+ */
+#define LOOPER_METER_BYTEBEAT (CUSTOM + 1)
+
+/**
+ * @brief Index of the meter of the mix, after effects and before the master gain.
+ */
+#define LOOPER_METER_MASTER (CUSTOM + 2)
+
+/**
+ * @brief Number of meters of the looper.
+ */
+#define LOOPER_METER_COUNT (CUSTOM + 3)
+
+/**
+ * @brief Enables or disables the level meters of the channels and of the mix.
+ *
+ * @details While enabled, `looper_render()` measures the peak and RMS level of every enabled channel and
+ * of the mix, a block at a time (see meters.h); `looper_step()` is not metered. Only the mix counts clipped
+ * samples: those that exceed the range of the output once scaled by the master gain, which would
+ * otherwise be clamped silently. Channels are never clipped on their own, so their count stays 0.
+ * Enabling the meters resets them.
+ *
+ * @param enabled Whether the meters are enabled; they are disabled by default.
+ */
+void looper_enable_meters(bool enabled);
+
+/**
+ * @brief Retrieves whether the level meters are enabled.
+ */
+bool looper_meters_enabled(void);
+
+/**
+ * @brief Resets the level meters.
+ */
+void looper_reset_meters(void);
+
+/**
+ * @brief Reads a level meter.
+ *
+ * @details Channels are read relative to their full scale, and the mix relative to the range of the
+ * output, so that the mix clips above 1.0. The momentary levels are those of the last call to
+ * `looper_render()`.
+ *
+ * @param meter The meter: a `Channel`, `LOOPER_METER_BYTEBEAT` or `LOOPER_METER_MASTER`.
+ * @param out Set to the levels of the meter; all 0 for channels that were not played.
+ */
+void looper_read_meter(uint8_t meter, MeterReading* out);
+
+/**
+ * @brief Enables the timeline, which plays notes positioned in ticks on top of the grid.
+ *
+ * @details The timeline has the same length as the loop, and holds notes that do not fit the grid
+ * of sixteenths, such as triplets, swing and grace notes. On each channel, timeline notes are only
+ * heard while the grid is silent (i.e. during pauses), and only cost memory and time for the notes
+ * that actually use them. Any previous timeline notes are removed.
+ *
+ * @sa timeline.h
+ *
+ * @param ppqn The resolution of the timeline, in ticks per quarter note (e.g. 96 or 480).
+ */
+void looper_enable_timeline(uint16_t ppqn);
+
+/**
+ * @brief Adds a note to the timeline.
+ *
+ * @details Notes that extend past the end of the loop end after it wraps around.
+ * Timeline notes have a constant volume, unless they use a render-time envelope.
+ *
+ * @param channel The waveform channel to play the note on; must be enabled.
+ * @param tick The start of the note, in ticks since the beginning of the loop.
+ * @param length_ticks The length of the note in ticks, less than the length of the loop (see
+ * `timeline_length_ticks()`).
+ * @param frequency The frequency of the note in Hz.
+ * @param volume The volume of the note (0-255).
+ * @param envelope The ID of the render-time envelope of the note (see `envelope_render_id()`), or 0 for none.
+ * @return false if the timeline is not enabled, the note is out of bounds or it is as long as the loop,
+ * true otherwise.
+ */
+bool looper_add_timeline_note(Channel channel, uint32_t tick, uint32_t length_ticks, uint16_t frequency, uint8_t volume, uint8_t envelope);
+
+/**
+ * @brief Changes the sample rate the looper renders at.
+ *
+ * @details The new sample rate is propagated to the oscillators and envelopes, and the tables that
+ * depend on it are rebuilt; this is relatively expensive, so it should not be done while playing.
+ * The length of the sixteenths is recomputed and playback restarts from the beginning of the current
+ * sixteenth. The sample rate is kept across `looper_free()` and `looper_init()`, and can also be set
+ * before `looper_init()`.
+ *
+ * Envelope lengths expressed in samples refer to `SAMPLE_RATE`, and are scaled to keep the same
+ * duration (see envelope.h).
+ *
+ * @param sample_rate The sample rate in Hz, between `LOOPER_MIN_SAMPLE_RATE` and `LOOPER_MAX_SAMPLE_RATE`.
+ * @return false if the sample rate is out of range, true otherwise.
+ */
+bool looper_set_sample_rate(uint32_t sample_rate);
+
+/**
+ * @brief Retrieves the sample rate the looper renders at.
+ *
+ * @return The sample rate in Hz.
+ */
+uint32_t looper_sample_rate(void);
+
 /**
  * @brief Changes the tempo of the looper.
  * 
@@ -142,13 +467,86 @@ uint16_t looper_read_notes(uint16_t start_sixteenth, uint16_t length_sixteenths,
  */
 void looper_change_tempo(uint16_t new_tempo_bpm);
 
+/**
+ * @brief Changes the tempo of the looper to a fractional value.
+ *
+ * @details Any tempo automation is removed. The position within the current sixteenth is scaled
+ * to the new tempo, so the loop keeps its musical position.
+ *
+ * @sa `LOOPER_TEMPO_Q16()`
+ *
+ * @param new_tempo_bpm_q16 The new tempo in beats per minute, in Q16 fixed point.
+ */
+void looper_change_tempo_q16(uint32_t new_tempo_bpm_q16);
+
+/**
+ * @brief Retrieves the current tempo of the looper.
+ *
+ * @return The tempo in beats per minute, in Q16 fixed point.
+ */
+uint32_t looper_tempo_q16(void);
+
+/**
+ * @brief Retrieves the maximum tempo at the current sample rate, at which a sixteenth lasts one sample.
+ * @details Higher tempos are clamped to this value, e.g. 15000 BPM at 1000 Hz.
+ * @return The tempo in beats per minute, in Q16 fixed point.
+ */
+uint32_t looper_max_tempo_q16(void);
+
+/**
+ * @brief Adds a point to the tempo automation track.
+ *
+ * @details The tempo ramps linearly from each point to the next one, one sixteenth at a time, and
+ * from the last point back to the first one across the end of the loop; a single point sets a
+ * constant tempo. A point on the same sixteenth as an existing one replaces it.
+ * The automation is evaluated incrementally while playing; adding a point resets the render-time
+ * envelopes, so the automation should be set up before playback.
+ *
+ * @param sixteenth The sixteenth note index within the loop at which the tempo is reached.
+ * @param tempo_bpm_q16 The tempo in beats per minute, in Q16 fixed point.
+ * @return false if the sixteenth is out of bounds or there are already `LOOPER_MAX_TEMPO_POINTS` points, true otherwise.
+ */
+bool looper_add_tempo_point(uint16_t sixteenth, uint32_t tempo_bpm_q16);
+
+/**
+ * @brief Removes every tempo automation point, keeping the current tempo.
+ */
+void looper_clear_tempo_automation(void);
+
+/**
+ * @brief Selects the wavetable the custom channel plays from a sixteenth onwards.
+ *
+ * @details The wavetable stays selected until the next change, wrapping around the loop, so a
+ * change at the first sixteenth of each note selects a timbre per note. Wavetables are registered
+ * with `custom_bank_set()`. Without any change, the channel plays the wavetable selected with
+ * `custom_select()` (by default wavetable 0, which is also where `custom_set_data()` puts its data).
+ *
+ * @param sixteenth The sixteenth note index within the loop at which the wavetable is selected.
+ * @param wavetable The index of the wavetable in the bank.
+ * @return false if the sixteenth or the wavetable is out of bounds, or there are already
+ * `LOOPER_MAX_WAVETABLE_CHANGES` changes, true otherwise.
+ */
+bool looper_set_wavetable(uint16_t sixteenth, uint8_t wavetable);
+
+/**
+ * @brief Removes every wavetable change, keeping the selected wavetable.
+ */
+void looper_clear_wavetables(void);
+
 /**
  * @brief Retrieves the number of samples per sixteenth note at the current tempo.
  * 
- * @return The number of samples per sixteenth note.
+ * @return The number of samples per sixteenth note, rounded to the nearest integer.
  */
 uint16_t looper_samples_per_sixteenth(void);
 
+/**
+ * @brief Retrieves the exact number of samples per sixteenth note at the current tempo.
+ * 
+ * @return The number of samples per sixteenth note, in Q16 fixed point.
+ */
+uint32_t looper_samples_per_sixteenth_q16(void);
+
 // TODO: remove after changing the rest of the documentation (kept for reference for now)
 // /**
 //  * @brief Sets the amplitude for a specific waveform channel.
@@ -174,6 +572,39 @@ uint16_t looper_samples_per_sixteenth(void);
  */
 uint8_t looper_step(void);
 
+/**
+ * @brief Renders a block of samples on the mix bus, advancing the looper by `count` samples.
+ *
+ * @details Unlike `looper_step()`, the channels are not averaged: each channel's value is centered
+ * around 0 and the sum is scaled by the master gain (see `looper_set_master_gain()`), so the level of
+ * a channel does not depend on how many channels are enabled. The samples are floats where 1.0 is
+ * full scale; the sum can go past it, and is only clipped by the output format conversion
+ * (see output.h).
+ *
+ * If the bytebeat channel is enabled (see `looper_enable_bytebeat()`) or the effects chain is not
+ * empty (see effects.h), the sum is mixed in blocks: the bytebeat channel is evaluated for a whole
+ * block at once and added to it, then the block goes through the effects before being scaled.
+ *
+ * @param out The buffer for the samples; must have room for `count` samples.
+ * @param count The number of samples to render.
+ */
+void looper_render(float* out, uint32_t count);
+
+/**
+ * @brief Sets the gain applied to the sum of the channels by `looper_render()`.
+ *
+ * @details With a gain of 1, a single channel playing at full volume reaches full scale. The default,
+ * `LOOPER_DEFAULT_MASTER_GAIN`, leaves enough headroom for four channels at full volume.
+ *
+ * @param gain The master gain.
+ */
+void looper_set_master_gain(float gain);
+
+/**
+ * @brief Retrieves the gain applied to the sum of the channels by `looper_render()`.
+ */
+float looper_master_gain(void);
+
 /**
  * @brief Retrieves the current position within the loop.
  * 
@@ -2,18 +2,33 @@
 #include "looper.h"
 #include "composer.h"
 #include "custom.h"
+#include "bench.h"
+#include "resampler.h"
+#include "output.h"
+#include "wav.h"
+#include "writer.h"
+#include "shmring.h"
+#include "server.h"
+#include "batch.h"
+#include "trace.h"
+#include "realtime.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <signal.h>
 #if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
 #else
-#include <linux/time.h>
+#include <time.h>
 #endif
 
 #define BPM 117
 #define BEATS 16
 #define SIXTEENTHS (BEATS * 4)
 
+#define BLOCKS_PER_SECOND 100 // Blocks of samples rendered at a time, 10ms each
+
 #define USE_LOOPER_4
 
 #ifdef USE_LOOPER_1
@@ -153,7 +168,7 @@ void setup_looper(void){
  * @brief Sets up the looper to test the custom waveform with a sine wave.
  */
 void setup_looper(void){
-    uint8_t sine_samples[8000] = {
+    static const uint8_t sine_samples[8000] = {
         128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 129, 129, 129, 129, 129, 129, 129, 129, 129, 129, 130, 130, 130, 130, 130, 130, 130, 130, 130, 130, 131, 131, 131, 131, 131, 131, 131, 131, 131, 131, 132, 132, 132, 132, 132, 132, 132, 132, 132, 132, 133, 133, 133, 133, 133, 133, 133, 133, 133, 133, 134, 134, 134, 134, 134, 134, 134, 134, 134, 134, 135, 135, 135, 135, 135, 135, 135, 135, 135, 135,
         136, 136, 136, 136, 136, 136, 136, 136, 136, 136, 137, 137, 137, 137, 137, 137, 137, 137, 137, 137, 138, 138, 138, 138, 138, 138, 138, 138, 138, 138, 139, 139, 139, 139, 139, 139, 139, 139, 139, 139, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 141, 141, 141, 141, 141, 141, 141, 141, 141, 141, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143,
         144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 146, 146, 146, 146, 146, 146, 146, 146, 146, 146, 147, 147, 147, 147, 147, 147, 147, 147, 147, 147, 148, 148, 148, 148, 148, 148, 148, 148, 148, 148, 149, 149, 149, 149, 149, 149, 149, 149, 149, 149, 150, 150, 150, 150, 150, 150, 150, 150, 150, 150, 150, 151, 151, 151, 151, 151, 151, 151, 151, 151,
@@ -257,7 +272,7 @@ void setup_looper(void){
     };
 
     looper_init(1, 30, false, false, false, false, true);
-    custom_set_data(sine_samples, 8000);
+    custom_bank_set(0, sine_samples, 8000); // Borrowed, not copied
 
     NoteAttributes n1 = {
         .flags = 1,
@@ -323,52 +338,494 @@ void setup_looper() {
 #error "Either USE_LOOPER_1, USE_LOOPER_2, or USE_LOOPER_3 must be defined for main.c"
 #endif
 
+static uint32_t render_rate = SAMPLE_RATE;
+static uint32_t output_rate = 0; // 0 if the same as render_rate
+static uint32_t block_samples = SAMPLE_RATE / BLOCKS_PER_SECOND;
+static OutputFormat output_format = OUTPUT_U8;
+static float* mix_block = NULL;
+static float* resampler_output = NULL;
+
+static const char* wav_path = NULL; // NULL to write raw samples to stdout
+static int wav_flags = 0;
+static const char* shm_name = NULL; // NULL to not publish to a shared-memory ring
+static uint32_t shm_blocks = SHMRING_DEFAULT_BLOCKS;
+static const char* server_path = NULL; // NULL to not serve the output on a Unix domain socket
+static uint32_t client_queue_blocks = SERVER_DEFAULT_QUEUE_BLOCKS;
+static uint32_t duration_seconds = 0; // 0 to play in real time until interrupted
+
+static uint32_t ring_blocks = WRITER_DEFAULT_BLOCKS;
+static uint32_t low_watermark = 1;
+static uint32_t high_watermark = 0; // 0 for the whole ring
+static bool print_metrics = false;
+static bool print_meters = false;
+static const char* trace_path = NULL; // NULL to not record a trace
+static uint8_t* dropped_block = NULL; // Where blocks are rendered when the ring is full
+
+static bool realtime = false;
+static RealtimePolicy realtime_policy = REALTIME_FIFO;
+static int realtime_priority = REALTIME_DEFAULT_PRIORITY;
+static int render_cpu = -1; // -1 to let the render thread run on any CPU
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int signal_number) {
+    (void)signal_number;
+    running = 0;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--render-rate <internal sample rate>] [--rate <output sample rate>]\n", program);
+    fprintf(stderr, "       %*s [--format u8|s16le|f32le] [--gain <master gain>]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %*s [--wav <path or ->] [--wav-direct] [--wav-sequential] [--duration <seconds>]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %*s [--ring-blocks <blocks>] [--low-watermark <blocks>] [--high-watermark <blocks>] [--metrics] [--meters]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %*s [--trace <path>]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %*s [--realtime] [--realtime-policy fifo|rr] [--realtime-priority <priority>] [--cpu <index>]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %*s [--shm <name>] [--shm-blocks <blocks>] [--serve <socket path>] [--client-queue <blocks>]\n", (int)strlen(program), "");
+    fprintf(stderr, "       %s shm-read <name>\n", program);
+    fprintf(stderr, "       %s [--render-rate, --rate, --format, --gain, --wav-*] batch [--jobs <count>] [--out-dir <directory>] [--loops <count>] <song file>...\n", program);
+    fprintf(stderr, "       %s bench\n", program);
+}
+
+/**
+ * @brief Renders a block of `block_samples` samples at the internal sample rate, resampling it to the
+ * output rate if needed and converting it to the output format.
+ * @param out The buffer for the output samples.
+ * @return The number of bytes written.
+ */
+static size_t render_block(uint8_t* out) {
+    TRACE_BEGIN("render block");
+    looper_render(mix_block, block_samples);
+
+    const float* samples = mix_block;
+    uint32_t count = block_samples;
+    if(output_rate != render_rate) {
+        TRACE_BEGIN("resample");
+        count = resampler_process(mix_block, block_samples, resampler_output);
+        TRACE_END("resample");
+        samples = resampler_output;
+    }
+
+    TRACE_BEGIN("convert");
+    output_convert(output_format, samples, count, out);
+    TRACE_END("convert");
+    TRACE_END("render block");
+    return count * output_sample_size(output_format);
+}
+
+/**
+ * @brief Gives the render thread real-time scheduling, if requested; threads started afterwards inherit it.
+ */
+static void request_realtime_scheduling(void) {
+    if(!realtime) return;
+
+    char error[128];
+    if(realtime_set_scheduling(realtime_policy, realtime_priority, error, sizeof(error))) {
+        fprintf(stderr, "Real-time: %s priority %d granted\n", realtime_policy_name(realtime_policy), realtime_priority);
+    } else {
+        fprintf(stderr, "Real-time: %s priority %d not granted (%s), running at normal priority\n", realtime_policy_name(realtime_policy), realtime_priority, error);
+    }
+}
+
+/**
+ * @brief Pins the render thread to its CPU and faults in and locks the memory used while rendering, as
+ * requested, once every buffer is allocated.
+ * @param block_size The size of an output block, in bytes.
+ */
+static void prepare_realtime_rendering(size_t block_size) {
+    char error[128];
+    if(render_cpu >= 0) {
+        if(realtime_pin_thread((uint32_t)render_cpu, error, sizeof(error))) {
+            fprintf(stderr, "Real-time: render thread pinned to CPU %d\n", render_cpu);
+        } else {
+            fprintf(stderr, "Real-time: render thread not pinned to CPU %d (%s)\n", render_cpu, error);
+        }
+    }
+    if(!realtime) return;
+
+    realtime_prefault_stack();
+    size_t bytes = REALTIME_STACK_PREFAULT;
+    bytes += realtime_prefault(mix_block, block_samples * sizeof(float));
+    if(resampler_output) bytes += realtime_prefault(resampler_output, resampler_max_output(block_samples) * sizeof(float));
+    bytes += realtime_prefault(dropped_block, block_size);
+    bytes += looper_prefault();
+    bytes += writer_prefault();
+    fprintf(stderr, "Real-time: %zu KiB of buffers prefaulted\n", (bytes + 1023) / 1024);
+
+    if(realtime_lock_memory(error, sizeof(error))) {
+        fprintf(stderr, "Real-time: memory locked\n");
+    } else {
+        fprintf(stderr, "Real-time: memory not locked (%s)\n", error);
+    }
+}
+
+/**
+ * @brief Prints the levels of every meter that measured samples to `stderr`.
+ */
+static void print_meter_readings(void) {
+    static const char* METER_NAMES[LOOPER_METER_COUNT] = { "square", "sawtooth", "triangle", "noise", "custom", "bytebeat", "master" };
+
+    fprintf(stderr, "Meters (dBFS):\n");
+    for(uint8_t meter = 0; meter < LOOPER_METER_COUNT; meter++) {
+        MeterReading reading;
+        looper_read_meter(meter, &reading);
+        if(reading.samples == 0) continue;
+
+        fprintf(stderr, "  %-8s peak %6.1f, RMS %6.1f", METER_NAMES[meter], meter_to_dbfs(reading.peak), meter_to_dbfs(reading.rms));
+        // Only the mix can clip
+        if(meter == LOOPER_METER_MASTER) {
+            fprintf(stderr, ", %llu of %llu samples clipped", (unsigned long long)reading.clipped, (unsigned long long)reading.samples);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+static bool write_output(const uint8_t* data, size_t size) {
+    if(shm_name) return shmring_publish(data, size);
+    if(server_path) return server_publish(data, size);
+    if(wav_path) return wav_write(data, size);
+    return fwrite(data, 1, size, stdout) == size && fflush(stdout) == 0;
+}
+
+/**
+ * @brief Copies the blocks published to a shared-memory ring to `stdout`, until the ring is closed.
+ * @param name The name of the ring.
+ * @return The exit code of the program.
+ */
+static int read_shared_memory(const char* name) {
+    if(!shmring_attach(name)) {
+        fprintf(stderr, "Error: Could not attach to the shared-memory ring %s\n", name);
+        return EXIT_FAILURE;
+    }
+
+    const ShmringHeader* header = shmring_header();
+    fprintf(stderr, "Reading %s: %u Hz, format %u\n", name, header->sample_rate, header->format);
+
+    uint64_t sequence = header->published; // Start from the next block
+    uint64_t lost = 0;
+    const uint8_t* data;
+    size_t size;
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    while(running) {
+        ShmringStatus status = shmring_read(&sequence, &data, &size, true);
+        if(status == SHMRING_CLOSED) break;
+        if(status == SHMRING_LATE) {
+            lost++;
+            continue;
+        }
+
+        if(fwrite(data, 1, size, stdout) != size || fflush(stdout) != 0) break;
+        if(!shmring_valid(sequence)) lost++; // Overwritten while it was being written
+        sequence++;
+    }
+
+    if(lost > 0) fprintf(stderr, "Lost blocks %llu times\n", (unsigned long long)lost);
+
+    shmring_detach();
+    return 0;
+}
+
+/**
+ * @brief Renders a block into the writer's ring.
+ *
+ * @details When the ring is at the high watermark and `wait` is false, the block is still rendered, so
+ * that the song keeps its timing, but it is dropped.
+ *
+ * @param wait Whether to wait for the writer thread when the ring is at the high watermark.
+ * @return false if the writer failed, true otherwise.
+ */
+static bool produce_block(bool wait) {
+    uint8_t* slot = writer_acquire(wait);
+    if(slot) {
+        writer_commit(render_block(slot));
+    } else {
+        render_block(dropped_block);
+    }
+
+    return !writer_failed();
+}
+
+/**
+ * @brief Parses the arguments of the batch command and renders the songs.
+ * @param argc The number of arguments after "batch".
+ * @param argv The arguments after "batch".
+ * @param program The name of the program, for the usage message.
+ * @return The exit code of the program.
+ */
+static int run_batch(int argc, char* argv[], const char* program) {
+    BatchOptions options = {
+        .render_rate = render_rate,
+        .output_rate = output_rate,
+        .format = output_format,
+        .master_gain = looper_master_gain(),
+        .loops = 1,
+        .jobs = 0,
+        .output_directory = ".",
+        .wav_flags = wav_flags
+    };
+
+    int i = 0;
+    for(; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if(strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            options.jobs = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+            options.output_directory = argv[++i];
+        } else if(strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            options.loops = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            print_usage(program);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(i == argc) {
+        print_usage(program);
+        return EXIT_FAILURE;
+    }
+
+    return batch_run(&options, argv + i, argc - i) == 0 ? 0 : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[]) {
+    int batch_index = 0; // Index of the arguments of the batch command, 0 if not batch rendering
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "batch") == 0) {
+            batch_index = i + 1;
+            break;
+        } else if(strcmp(argv[i], "bench") == 0) {
+            bench_run();
+            return 0;
+        } else if(strcmp(argv[i], "shm-read") == 0 && i + 1 < argc) {
+            return read_shared_memory(argv[i + 1]);
+        } else if(strcmp(argv[i], "--render-rate") == 0 && i + 1 < argc) {
+            render_rate = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            output_rate = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            output_format = output_format_from_name(argv[++i]);
+            if(output_format == OUTPUT_FORMAT_INVALID) {
+                fprintf(stderr, "Error: Unknown output format %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[i], "--wav") == 0 && i + 1 < argc) {
+            wav_path = argv[++i];
+        } else if(strcmp(argv[i], "--wav-direct") == 0) {
+            wav_flags |= WAV_DIRECT;
+        } else if(strcmp(argv[i], "--wav-sequential") == 0) {
+            wav_flags |= WAV_SEQUENTIAL;
+        } else if(strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if(strcmp(argv[i], "--shm-blocks") == 0 && i + 1 < argc) {
+            shm_blocks = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if(strcmp(argv[i], "--client-queue") == 0 && i + 1 < argc) {
+            client_queue_blocks = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration_seconds = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--gain") == 0 && i + 1 < argc) {
+            looper_set_master_gain(strtof(argv[++i], NULL));
+        } else if(strcmp(argv[i], "--ring-blocks") == 0 && i + 1 < argc) {
+            ring_blocks = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--low-watermark") == 0 && i + 1 < argc) {
+            low_watermark = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--high-watermark") == 0 && i + 1 < argc) {
+            high_watermark = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--metrics") == 0) {
+            print_metrics = true;
+        } else if(strcmp(argv[i], "--meters") == 0) {
+            print_meters = true;
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if(strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if(strcmp(argv[i], "--realtime-policy") == 0 && i + 1 < argc) {
+            realtime = true;
+            if(!realtime_policy_from_name(argv[++i], &realtime_policy)) {
+                fprintf(stderr, "Error: Unknown scheduling policy %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if(strcmp(argv[i], "--realtime-priority") == 0 && i + 1 < argc) {
+            realtime = true;
+            realtime_priority = (int)strtol(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            render_cpu = (int)strtol(argv[++i], NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(!looper_set_sample_rate(render_rate)) {
+        fprintf(stderr, "Error: Unsupported internal sample rate %u\n", render_rate);
+        return EXIT_FAILURE;
+    }
+    if(output_rate == 0) output_rate = render_rate;
+    if(batch_index > 0) return run_batch(argc - batch_index, argv + batch_index, argv[0]);
+
+    if(trace_path) {
+        trace_start(TRACE_DEFAULT_EVENTS);
+        trace_set_thread_name("render");
+    }
+    block_samples = render_rate / BLOCKS_PER_SECOND;
+
+    uint32_t block_capacity = block_samples;
+    mix_block = (float*)malloc(block_samples * sizeof(float));
+    if(!mix_block) {
+        fprintf(stderr, "Error: Memory allocation failed in main()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(output_rate != render_rate) {
+        if(!resampler_init(render_rate, output_rate)) {
+            fprintf(stderr, "Error: Unsupported output sample rate %u\n", output_rate);
+            return EXIT_FAILURE;
+        }
+
+        block_capacity = resampler_max_output(block_samples);
+        resampler_output = (float*)malloc(block_capacity * sizeof(float));
+        if(!resampler_output) {
+            fprintf(stderr, "Error: Memory allocation failed in main()\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    dropped_block = (uint8_t*)malloc(block_capacity * output_sample_size(output_format));
+    if(!dropped_block) {
+        fprintf(stderr, "Error: Memory allocation failed in main()\n");
+        exit(EXIT_FAILURE);
+    }
+
     setup_looper();
+    if(print_meters) looper_enable_meters(true);
 
-    #if defined(_WIN32) || defined(_WIN64)
-    const uint64_t interval_us = 1000000 / SAMPLE_RATE;
+    if((shm_name != NULL) + (wav_path != NULL) + (server_path != NULL) > 1) {
+        fprintf(stderr, "Error: Only one of --wav, --shm and --serve can be used\n");
+        return EXIT_FAILURE;
+    }
 
-    LARGE_INTEGER freq;
-    LARGE_INTEGER next;
-    QueryPerformanceFrequency(&freq);
-    QueryPerformanceCounter(&next);
+    if(server_path && !server_start(server_path, client_queue_blocks)) {
+        fprintf(stderr, "Error: Could not listen on %s\n", server_path);
+        return EXIT_FAILURE;
+    }
 
-    while (1) {
-        uint8_t value = looper_step();
-        fputc(value, stdout);
-        fflush(stdout);
+    if(shm_name && !shmring_create(shm_name, output_rate, output_format, shm_blocks, block_capacity * output_sample_size(output_format))) {
+        fprintf(stderr, "Error: Could not create the shared-memory ring %s\n", shm_name);
+        return EXIT_FAILURE;
+    }
 
-        // advance next deadline
-        next.QuadPart += (interval_us * freq.QuadPart) / 1000000;
+    if(wav_path && !wav_open(wav_path, output_rate, output_format, wav_flags)) {
+        fprintf(stderr, "Error: Could not open %s\n", wav_path);
+        return EXIT_FAILURE;
+    }
+
+    request_realtime_scheduling(); // Before starting the writer, so it inherits the scheduling
 
-        // busy-wait cause I can't be arsed to do better for Windows
-        LARGE_INTEGER now;
-        do {
-            QueryPerformanceCounter(&now);
-        } while (now.QuadPart < next.QuadPart);
+    if(high_watermark == 0) high_watermark = ring_blocks;
+    if(!writer_start(write_output, ring_blocks, block_capacity * output_sample_size(output_format), low_watermark, high_watermark)) {
+        fprintf(stderr, "Error: Invalid ring size or watermarks (1 <= low <= high <= blocks)\n");
+        return EXIT_FAILURE;
     }
-    #else
-    const __useconds_t interval_us = 1000000 / SAMPLE_RATE;
-    struct timespec next;
-    clock_gettime(CLOCK_MONOTONIC, &next);
-
-    while (1) {
-        uint8_t value = looper_step();
-        fputc(value, stdout);
-        fflush(stdout);
-
-        // advance next deadline
-        next.tv_nsec += interval_us * 1000;
-        while (next.tv_nsec >= 1000000000) {
-            next.tv_nsec -= 1000000000;
-            next.tv_sec++;
+
+    prepare_realtime_rendering(block_capacity * output_sample_size(output_format));
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    if(duration_seconds > 0) {
+        // Offline render: as fast as possible
+        for(uint64_t i = 0; running && i < (uint64_t)duration_seconds * BLOCKS_PER_SECOND; i++) {
+            if(!produce_block(true)) break;
+        }
+    } else {
+        #if defined(_WIN32) || defined(_WIN64)
+        LARGE_INTEGER freq;
+        LARGE_INTEGER next;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&next);
+
+        while (running) {
+            if(!produce_block(false)) break;
+
+            // advance next deadline
+            next.QuadPart += (block_samples * freq.QuadPart) / render_rate;
+
+            // busy-wait cause I can't be arsed to do better for Windows
+            TRACE_BEGIN("sleep");
+            LARGE_INTEGER now;
+            do {
+                QueryPerformanceCounter(&now);
+            } while (now.QuadPart < next.QuadPart);
+            TRACE_END("sleep");
         }
+        #else
+        const uint64_t interval_ns = (uint64_t)block_samples * 1000000000 / render_rate;
+        struct timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+
+        while (running) {
+            if(!produce_block(false)) break;
+
+            // advance next deadline
+            next.tv_nsec += interval_ns;
+            while (next.tv_nsec >= 1000000000) {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+
+            // sleep until that absolute time
+            TRACE_BEGIN("sleep");
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+            TRACE_END("sleep");
+        }
+        #endif
+    }
+
+    writer_stop();
+
+    if(trace_path) {
+        if(!trace_write(trace_path)) fprintf(stderr, "Error: Could not write the trace to %s\n", trace_path);
+        uint64_t dropped = trace_dropped_events();
+        if(dropped > 0) fprintf(stderr, "Trace: %llu events dropped (buffers full)\n", (unsigned long long)dropped);
+        trace_stop();
+    }
+
+    if(print_meters) print_meter_readings();
+
+    if(print_metrics) {
+        WriterMetrics metrics;
+        writer_metrics(&metrics);
+        fprintf(stderr, "Ring: %u blocks, low watermark %u, high watermark %u\n", metrics.block_count, metrics.low_watermark, metrics.high_watermark);
+        fprintf(stderr, "Peak fill: %u blocks, high watermark reached %llu times\n", metrics.peak_fill, (unsigned long long)metrics.high_watermark_hits);
+        fprintf(stderr, "Written: %llu blocks, %llu bytes, longest write %llu us\n", (unsigned long long)metrics.blocks_written, (unsigned long long)metrics.bytes_written, (unsigned long long)metrics.max_write_us);
+        fprintf(stderr, "Dropped: %llu blocks\n", (unsigned long long)metrics.blocks_dropped);
+
+        LooperMemory memory;
+        looper_memory_usage(&memory);
+        size_t unshared_bytes = 0;
+        for(int channel = SQUARE; channel <= CUSTOM; channel++) unshared_bytes += memory.channel_bytes[channel];
+        fprintf(stderr, "Looper memory: %zu of %zu bytes reserved, notes %zu bytes (%zu without sharing), custom waveform %zu bytes\n", memory.used_bytes, memory.reserved_bytes, memory.note_bytes, unshared_bytes, memory.custom_data_bytes);
+
+        if(server_path) {
+            ServerMetrics server;
+            server_metrics(&server);
+            fprintf(stderr, "Clients: %llu accepted, %llu evicted, peak queue %u blocks\n", (unsigned long long)server.clients_accepted, (unsigned long long)server.clients_evicted, server.peak_queue);
+        }
+    }
+
+    if(writer_failed()) {
+        fprintf(stderr, "Error: Could not write the output\n");
+    }
+
+    if(shm_name) shmring_destroy();
+    if(server_path) server_stop();
 
-        // sleep until that absolute time
-        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    if(wav_path && !wav_close()) {
+        fprintf(stderr, "Error: Could not finish writing %s\n", wav_path);
+        return EXIT_FAILURE;
     }
-    #endif
 
     return 0;
-}
\ No newline at end of file
+}
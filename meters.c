@@ -0,0 +1,73 @@
+#include "meters.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#define METER_LANES 16
+
+void meter_reset(Meter* meter) {
+    *meter = (Meter){ 0 };
+}
+
+void meter_start_block(Meter* meter) {
+    meter->block_peak = 0;
+    meter->block_square_sum = 0;
+    meter->block_samples = 0;
+}
+
+void meter_process(Meter* meter, const int32_t* samples, uint32_t count, uint32_t clip_level) {
+    // Independent totals per lane, so that every lane of a group of samples is measured at once
+    uint32_t peaks[METER_LANES] = { 0 };
+    float square_sums[METER_LANES] = { 0 }; // A block's worth, added to the double totals afterwards
+    uint32_t clipped[METER_LANES] = { 0 };
+
+    uint32_t i = 0;
+    for(; i + METER_LANES <= count; i += METER_LANES) {
+        for(uint32_t lane = 0; lane < METER_LANES; lane++) {
+            int32_t value = samples[i + lane];
+            uint32_t magnitude = (uint32_t)(value < 0 ? -value : value);
+            peaks[lane] = magnitude > peaks[lane] ? magnitude : peaks[lane];
+            square_sums[lane] += (float)value * (float)value;
+            clipped[lane] += magnitude >= clip_level;
+        }
+    }
+    for(uint32_t lane = 0; i < count; i++, lane++) {
+        int32_t value = samples[i];
+        uint32_t magnitude = (uint32_t)(value < 0 ? -value : value);
+        peaks[lane] = magnitude > peaks[lane] ? magnitude : peaks[lane];
+        square_sums[lane] += (float)value * (float)value;
+        clipped[lane] += magnitude >= clip_level;
+    }
+
+    uint32_t peak = 0;
+    double square_sum = 0;
+    uint32_t clipped_count = 0;
+    for(uint32_t lane = 0; lane < METER_LANES; lane++) {
+        if(peaks[lane] > peak) peak = peaks[lane];
+        square_sum += square_sums[lane];
+        clipped_count += clipped[lane];
+    }
+
+    if(peak > meter->peak) meter->peak = peak;
+    meter->square_sum += square_sum;
+    meter->clipped += clipped_count;
+    meter->samples += count;
+
+    if(peak > meter->block_peak) meter->block_peak = peak;
+    meter->block_square_sum += square_sum;
+    meter->block_samples += count;
+}
+
+void meter_read(const Meter* meter, float full_scale, MeterReading* out) {
+    out->peak = meter->peak / full_scale;
+    out->rms = meter->samples > 0 ? (float)(sqrt(meter->square_sum / (double)meter->samples) / full_scale) : 0;
+    out->block_peak = meter->block_peak / full_scale;
+    out->block_rms = meter->block_samples > 0 ? (float)(sqrt(meter->block_square_sum / meter->block_samples) / full_scale) : 0;
+    out->clipped = meter->clipped;
+    out->samples = meter->samples;
+}
+
+float meter_to_dbfs(float level) {
+    return level > 0 ? 20.0f * log10f(level) : -INFINITY;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * @file meters.h
+ * @brief Header file for the level meters, which measure the peak, RMS level and clipping of a stream of
+ * samples.
+ *
+ * @details A `Meter` is fed blocks of integer samples centered around 0 with `meter_process()`, which
+ * measures groups of 16 samples at once with independent totals per lane, in loops without branches
+ * that the compiler can vectorize; sums of squares are kept in single precision within a call, so
+ * blocks should be at most a few thousand samples long. It keeps both the totals since it was
+ * reset and those of the current block (see `meter_start_block()`), for momentary readings. Samples whose
+ * absolute value reaches the clip level given by the caller are counted as clipped.
+ *
+ * The looper keeps a meter per channel and one for the master mix (see `looper_enable_meters()`).
+ *
+ * @author Ovidio1005
+ * @date 2025-11-30
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Clip level of `meter_process()` for streams that cannot clip, such as the channels before
+ * they are mixed; no sample counts as clipped.
+ */
+#define METER_NO_CLIP UINT32_MAX
+
+/**
+ * @brief Level meter; all fields are read-only outside of meters.c.
+ */
+typedef struct meter {
+    /** The highest absolute value since the meter was reset. */
+    uint32_t peak;
+    /** The sum of the squares of the samples since the meter was reset. */
+    double square_sum;
+    /** The number of clipped samples since the meter was reset. */
+    uint64_t clipped;
+    /** The number of samples since the meter was reset. */
+    uint64_t samples;
+    /** The highest absolute value in the current block. */
+    uint32_t block_peak;
+    /** The sum of the squares of the samples of the current block. */
+    double block_square_sum;
+    /** The number of samples of the current block. */
+    uint32_t block_samples;
+} Meter;
+
+/**
+ * @brief Levels measured by a meter, relative to full scale (1.0).
+ */
+typedef struct meter_reading {
+    /** The highest absolute value since the meter was reset. */
+    float peak;
+    /** The RMS level since the meter was reset. */
+    float rms;
+    /** The highest absolute value in the current block. */
+    float block_peak;
+    /** The RMS level of the current block. */
+    float block_rms;
+    /** The number of clipped samples since the meter was reset. */
+    uint64_t clipped;
+    /** The number of samples since the meter was reset. */
+    uint64_t samples;
+} MeterReading;
+
+/**
+ * @brief Clears the totals and the current block of a meter.
+ */
+void meter_reset(Meter* meter);
+
+/**
+ * @brief Starts a new block, whose levels are the momentary readings of the meter.
+ */
+void meter_start_block(Meter* meter);
+
+/**
+ * @brief Measures a block of samples, adding it to the totals and to the current block.
+ * @param meter The meter.
+ * @param samples The samples, centered around 0; their absolute values must be less than 2^16.
+ * @param count The number of samples.
+ * @param clip_level The absolute value from which samples count as clipped, or `METER_NO_CLIP`.
+ */
+void meter_process(Meter* meter, const int32_t* samples, uint32_t count, uint32_t clip_level);
+
+/**
+ * @brief Reads the levels of a meter.
+ * @param meter The meter.
+ * @param full_scale The absolute value of a sample at full scale, greater than 0.
+ * @param out Set to the levels; all 0 if the meter has not measured any sample.
+ */
+void meter_read(const Meter* meter, float full_scale, MeterReading* out);
+
+/**
+ * @brief Converts a level relative to full scale to decibels relative to full scale (dBFS).
+ * @return The level in dBFS, `-INFINITY` for silence.
+ */
+float meter_to_dbfs(float level);
@@ -3,18 +3,99 @@
 /**
  * @file noise.h
  * @brief Header file for noise waveform generator functions.
- * 
+ *
  * @details This module provides functions to generate a noise waveform signal as an
  * unsigned 8-bit integer output. The returned values will be between -`amplitude`/2
- * and +`amplitude`/2, centered around 128. Unlike other waveforms, noise does not have
- * a defined frequency. Use the `noise_step` function to retrieve the next sample of the
- * noise waveform.
- * 
+ * and +`amplitude`/2, centered around 128. Use the `noise_step` function to retrieve the
+ * next sample of the noise waveform, or `noise_fill` to generate a block of samples.
+ *
+ * The noise is generated without tables, like the noise channels of classic sound chips: a new
+ * random value is produced at the frequency of the noise (the "clock") and held until the next one,
+ * so lower frequencies give darker noise. A frequency of 0 produces a new value at every sample.
+ * Two modes are available:
+ * - `NOISE_MODE_LONG` produces white noise that does not repeat in practice, from four interleaved
+ *   xorshift generators; interleaving them lets `noise_fill` produce four values at once.
+ * - `NOISE_MODE_SHORT` produces 1-bit noise from a 15-bit LFSR that repeats every 93 clocks,
+ *   which sounds metallic and has a recognizable pitch.
+ *
+ * The sequence only depends on the seed, so renders are deterministic. `NoiseGenerator` and the
+ * `noise_generator_*` functions allow independent instances, each with its own seed; the other
+ * functions drive the instance played by the looper's noise channel.
+ *
  * @author Ovidio1005
- * @date 2025-11-16
+ * @date 2025-11-27
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Seed used by the noise channel until `noise_set_seed()` is called.
+ */
+#define NOISE_DEFAULT_SEED 0x2545F491u
+
+/**
+ * @brief Period modes of the noise.
+ */
+typedef enum noise_mode {
+    /** White noise with a very long period. */
+    NOISE_MODE_LONG,
+    /** 1-bit noise repeating every 93 clocks. */
+    NOISE_MODE_SHORT
+} NoiseMode;
+
+/**
+ * @brief State of a noise generator; all fields are read-only outside of noise.c.
+ */
+typedef struct noise_generator {
+    /** States of the interleaved xorshift generators (long mode). */
+    uint32_t lanes[4];
+    /** Number of clocks so far, selecting the next lane (long mode). */
+    uint32_t clock_count;
+    /** State of the LFSR (short mode). */
+    uint16_t lfsr;
+    /** The value held until the next clock, 0-255. */
+    uint8_t value;
+    /** The mode, as a `NoiseMode` value. */
+    uint8_t mode;
+    /** Fraction of the current clock elapsed, in Q16 fixed point. */
+    uint32_t phase;
+    /** Fraction of a clock per sample, in Q16 fixed point; 1 << 16 to clock at every sample. */
+    uint32_t increment;
+} NoiseGenerator;
+
+/**
+ * @brief Initializes a noise generator, clocked at every sample.
+ * @param generator The generator.
+ * @param seed The seed; generators with the same seed and mode produce the same sequence.
+ * @param mode The period mode.
+ */
+void noise_generator_init(NoiseGenerator* generator, uint32_t seed, NoiseMode mode);
+
+/**
+ * @brief Sets the clock frequency of a noise generator.
+ * @param generator The generator.
+ * @param frequency The number of new values per second, or 0 for a new value at every sample.
+ * @param sample_rate The sample rate the generator runs at, in Hz.
+ */
+void noise_generator_set_frequency(NoiseGenerator* generator, uint16_t frequency, uint32_t sample_rate);
+
+/**
+ * @brief Gets the next sample of a noise generator, at full amplitude.
+ * @param generator The generator.
+ * @return The sample value, 0-255.
+ */
+uint8_t noise_generator_step(NoiseGenerator* generator);
+
+/**
+ * @brief Gets the next samples of a noise generator, at full amplitude.
+ * @details The samples are the same `noise_generator_step()` would return, but are generated faster:
+ * several at a time in long mode, and as runs of equal values at low frequencies.
+ * @param generator The generator.
+ * @param out The buffer to write the samples to.
+ * @param count The number of samples to generate.
+ */
+void noise_generator_fill(NoiseGenerator* generator, uint8_t* out, uint32_t count);
 
 /**
  * @brief Get the current amplitude of the noise waveform.
@@ -28,8 +109,51 @@ uint8_t noise_amplitude(void);
  */
 void noise_set_amplitude(uint8_t amplitude);
 
+/**
+ * @brief Get the current frequency of the noise waveform.
+ * @return The number of new values per second, or 0 if there is one at every sample.
+ */
+uint16_t noise_frequency(void);
+/**
+ * @brief Set the frequency of the noise waveform.
+ * @param frequency The number of new values per second, or 0 for a new value at every sample.
+ */
+void noise_set_frequency(uint16_t frequency);
+
+/**
+ * @brief Get the current period mode of the noise waveform.
+ */
+NoiseMode noise_mode(void);
+/**
+ * @brief Set the period mode of the noise waveform, restarting its sequence from the current seed.
+ */
+void noise_set_mode(NoiseMode mode);
+
+/**
+ * @brief Set the seed of the noise waveform, restarting its sequence.
+ * @param seed The seed; the default is `NOISE_DEFAULT_SEED`.
+ */
+void noise_set_seed(uint32_t seed);
+
+/**
+ * @brief Get the sample rate of the noise waveform.
+ */
+uint32_t noise_sample_rate(void);
+/**
+ * @brief Set the sample rate of the noise waveform.
+ * @param sample_rate The sample rate in Hz; the frequency is kept.
+ */
+void noise_set_sample_rate(uint32_t sample_rate);
+
 /**
  * @brief Get the value for the current sample of the noise waveform, and advance to the next sample.
  * @return The sample value as an unsigned 8-bit integer.
  */
-uint8_t noise_step(void);
\ No newline at end of file
+uint8_t noise_step(void);
+
+/**
+ * @brief Get the values for the next samples of the noise waveform, as `noise_step` would.
+ * @param out The buffer to write the samples to.
+ * @param count The number of samples to generate.
+ */
+void noise_fill(uint8_t* out, uint32_t count);
@@ -0,0 +1,111 @@
+#include "output.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OUTPUT_SSE2
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define OUTPUT_BIG_ENDIAN
+#endif
+
+static int32_t round_and_clamp(float value, int32_t min, int32_t max) {
+    int32_t rounded = (int32_t)lrintf(value);
+    if(rounded < min) return min;
+    if(rounded > max) return max;
+    return rounded;
+}
+
+static void convert_u8(const float* in, uint32_t count, uint8_t* out) {
+    uint32_t i = 0;
+
+    #ifdef OUTPUT_SSE2
+    const __m128 scale = _mm_set1_ps(128.0f);
+    const __m128i offset = _mm_set1_epi16(128);
+    for(; i + 16 <= count; i += 16) {
+        // Saturating packs clip to -32768..32767, then 0..255 after adding the offset
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        __m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 8), scale));
+        __m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 12), scale));
+        __m128i low = _mm_adds_epi16(_mm_packs_epi32(a, b), offset);
+        __m128i high = _mm_adds_epi16(_mm_packs_epi32(c, d), offset);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(low, high));
+    }
+    #endif
+
+    for(; i < count; i++) {
+        out[i] = (uint8_t)(round_and_clamp(in[i] * 128.0f, -128, 127) + 128);
+    }
+}
+
+static void convert_s16le(const float* in, uint32_t count, uint8_t* out) {
+    uint32_t i = 0;
+
+    #if defined(OUTPUT_SSE2) && !defined(OUTPUT_BIG_ENDIAN)
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    for(; i + 8 <= count; i += 8) {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        _mm_storeu_si128((__m128i*)(out + i * 2), _mm_packs_epi32(a, b));
+    }
+    #endif
+
+    for(; i < count; i++) {
+        int32_t value = round_and_clamp(in[i] * 32768.0f, INT16_MIN, INT16_MAX);
+        out[i * 2] = (uint8_t)(value & 0xFF);
+        out[i * 2 + 1] = (uint8_t)((value >> 8) & 0xFF);
+    }
+}
+
+static void convert_f32le(const float* in, uint32_t count, uint8_t* out) {
+    #ifdef OUTPUT_BIG_ENDIAN
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t bits;
+        memcpy(&bits, &in[i], sizeof(bits));
+        out[i * 4] = (uint8_t)bits;
+        out[i * 4 + 1] = (uint8_t)(bits >> 8);
+        out[i * 4 + 2] = (uint8_t)(bits >> 16);
+        out[i * 4 + 3] = (uint8_t)(bits >> 24);
+    }
+    #else
+    memcpy(out, in, count * sizeof(float));
+    #endif
+}
+
+OutputFormat output_format_from_name(const char* name) {
+    if(strcmp(name, "u8") == 0) return OUTPUT_U8;
+    if(strcmp(name, "s16le") == 0) return OUTPUT_S16LE;
+    if(strcmp(name, "f32le") == 0) return OUTPUT_F32LE;
+    return OUTPUT_FORMAT_INVALID;
+}
+
+size_t output_sample_size(OutputFormat format) {
+    switch(format) {
+        case OUTPUT_U8: return 1;
+        case OUTPUT_S16LE: return 2;
+        case OUTPUT_F32LE: return 4;
+        default: return 0;
+    }
+}
+
+void output_convert(OutputFormat format, const float* in, uint32_t count, void* out) {
+    switch(format) {
+        case OUTPUT_U8:
+            convert_u8(in, count, (uint8_t*)out);
+            break;
+        case OUTPUT_S16LE:
+            convert_s16le(in, count, (uint8_t*)out);
+            break;
+        case OUTPUT_F32LE:
+            convert_f32le(in, count, (uint8_t*)out);
+            break;
+        default:
+            break;
+    }
+}
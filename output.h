@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * @file output.h
+ * @brief Header file for the conversion of the mix bus to the output sample formats.
+ *
+ * @details The looper mixes its channels into float samples (see `looper_render()`), where 1.0 is
+ * full scale. This module converts blocks of those samples to the format written on the output:
+ * unsigned 8-bit, signed 16-bit little endian or 32-bit float little endian. Integer formats are
+ * rounded and clipped to their range; float samples are written as they are, keeping any headroom.
+ *
+ * The conversions work on whole blocks, and use SIMD instructions where available.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-24
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Output sample formats.
+ */
+typedef enum output_format {
+    /** Unsigned 8-bit, centered around 128. */
+    OUTPUT_U8,
+    /** Signed 16-bit, little endian. */
+    OUTPUT_S16LE,
+    /** 32-bit IEEE float, little endian. */
+    OUTPUT_F32LE,
+    OUTPUT_FORMAT_INVALID = -1
+} OutputFormat;
+
+/**
+ * @brief Parses the name of a format, as used by `ffmpeg`/`ffplay` (`u8`, `s16le` or `f32le`).
+ * @param name The name of the format.
+ * @return The format, or `OUTPUT_FORMAT_INVALID` if the name is not recognized.
+ */
+OutputFormat output_format_from_name(const char* name);
+
+/**
+ * @brief Retrieves the size of a sample in the given format.
+ * @return The size in bytes.
+ */
+size_t output_sample_size(OutputFormat format);
+
+/**
+ * @brief Converts a block of samples from the mix bus to an output format.
+ * @param format The output format.
+ * @param in The samples to convert.
+ * @param count The number of samples.
+ * @param out The buffer for the converted samples; must have room for
+ * `count * output_sample_size(format)` bytes.
+ */
+void output_convert(OutputFormat format, const float* in, uint32_t count, void* out);
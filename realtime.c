@@ -0,0 +1,134 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For pthread_setaffinity_np()
+#endif
+
+#include "realtime.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+
+bool realtime_policy_from_name(const char* name, RealtimePolicy* out) {
+    if(strcmp(name, "fifo") == 0) *out = REALTIME_FIFO;
+    else if(strcmp(name, "rr") == 0) *out = REALTIME_RR;
+    else return false;
+    return true;
+}
+
+const char* realtime_policy_name(RealtimePolicy policy) {
+    return policy == REALTIME_RR ? "SCHED_RR" : "SCHED_FIFO";
+}
+
+bool realtime_set_scheduling(RealtimePolicy policy, int priority, char* error, size_t error_size) {
+    #if defined(_WIN32) || defined(_WIN64)
+    (void)policy;
+    (void)priority;
+    if(!SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) ||
+        !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        snprintf(error, error_size, "Windows error %lu", (unsigned long)GetLastError());
+        return false;
+    }
+    return true;
+    #else
+    int native_policy = policy == REALTIME_RR ? SCHED_RR : SCHED_FIFO;
+    int min = sched_get_priority_min(native_policy);
+    int max = sched_get_priority_max(native_policy);
+    if(priority < min || priority > max) {
+        snprintf(error, error_size, "priority must be between %d and %d", min, max);
+        return false;
+    }
+
+    struct sched_param parameters = { .sched_priority = priority };
+    int result = pthread_setschedparam(pthread_self(), native_policy, &parameters);
+    if(result != 0) {
+        snprintf(error, error_size, "%s", strerror(result));
+        return false;
+    }
+    return true;
+    #endif
+}
+
+bool realtime_lock_memory(char* error, size_t error_size) {
+    #if defined(_WIN32) || defined(_WIN64)
+    snprintf(error, error_size, "not supported on Windows");
+    return false;
+    #else
+    if(mlockall(MCL_CURRENT) != 0) {
+        snprintf(error, error_size, "%s", strerror(errno));
+        return false;
+    }
+    return true;
+    #endif
+}
+
+bool realtime_pin_thread(uint32_t cpu, char* error, size_t error_size) {
+    #if defined(_WIN32) || defined(_WIN64)
+    if(cpu >= sizeof(DWORD_PTR) * 8) {
+        snprintf(error, error_size, "no CPU %u", cpu);
+        return false;
+    }
+    if(SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) == 0) {
+        snprintf(error, error_size, "Windows error %lu", (unsigned long)GetLastError());
+        return false;
+    }
+    return true;
+    #elif defined(__linux__)
+    if(cpu >= CPU_SETSIZE) {
+        snprintf(error, error_size, "no CPU %u", cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(result != 0) {
+        snprintf(error, error_size, "%s", result == EINVAL ? "no such CPU available" : strerror(result));
+        return false;
+    }
+    return true;
+    #else
+    (void)cpu;
+    snprintf(error, error_size, "not supported on this system");
+    return false;
+    #endif
+}
+
+size_t realtime_prefault(void* memory, size_t size) {
+    volatile uint8_t* bytes = (volatile uint8_t*)memory;
+    if(!bytes || size == 0) return 0;
+
+    for(size_t i = 0; i < size; i += REALTIME_PAGE_SIZE) {
+        bytes[i] = bytes[i];
+    }
+    bytes[size - 1] = bytes[size - 1]; // The last page, if the buffer does not start on a page
+    return size;
+}
+
+size_t realtime_prefault_readonly(const void* memory, size_t size) {
+    const volatile uint8_t* bytes = (const volatile uint8_t*)memory;
+    if(!bytes || size == 0) return 0;
+
+    for(size_t i = 0; i < size; i += REALTIME_PAGE_SIZE) {
+        (void)bytes[i];
+    }
+    (void)bytes[size - 1];
+    return size;
+}
+
+void realtime_prefault_stack(void) {
+    volatile uint8_t stack[REALTIME_STACK_PREFAULT];
+    for(size_t i = 0; i < sizeof(stack); i += REALTIME_PAGE_SIZE) {
+        stack[i] = 0;
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/**
+ * @file realtime.h
+ * @brief Header file for the real-time module, which asks the operating system to run the render
+ * thread with real-time priority and without page faults.
+ *
+ * @details On a busy host, a normal-priority render thread can be preempted for longer than the output
+ * ring lasts, and the first touch of a page of a buffer costs a page fault that can take tens of
+ * microseconds. Both show up as late or dropped blocks. The functions of this module are opt-in
+ * (`--realtime` and `--cpu` on the command line), and each of them only asks: unprivileged processes
+ * are usually refused real-time scheduling and can only lock a little memory (`RLIMIT_MEMLOCK`), so
+ * they report why they failed and the caller carries on without the guarantee.
+ *
+ * On Windows, scheduling raises the priority of the process and of the calling thread instead of
+ * using a policy, and memory cannot be locked.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-30
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Default real-time priority of `realtime_set_scheduling()`, in the middle of the range of
+ * Linux (1 to 99), below the interrupt threads of the kernel.
+ */
+#define REALTIME_DEFAULT_PRIORITY 50
+
+/**
+ * @brief Number of bytes of stack touched by `realtime_prefault_stack()`.
+ */
+#define REALTIME_STACK_PREFAULT (256 * 1024)
+
+/**
+ * @brief Smallest page size of the supported systems; touching one byte every this many bytes faults
+ * in every page of a buffer.
+ */
+#define REALTIME_PAGE_SIZE 4096
+
+/**
+ * @brief Real-time scheduling policies.
+ */
+typedef enum realtime_policy {
+    /** First in, first out: the thread runs until it blocks or a higher priority thread is ready. */
+    REALTIME_FIFO,
+    /** Round robin: like `REALTIME_FIFO`, but threads of the same priority take turns. */
+    REALTIME_RR,
+} RealtimePolicy;
+
+/**
+ * @brief Gets a policy from its name.
+ * @param name "fifo" or "rr".
+ * @param out The policy; only set if the function returns true.
+ * @return false if the name is unknown, true otherwise.
+ */
+bool realtime_policy_from_name(const char* name, RealtimePolicy* out);
+
+/**
+ * @brief Gets the name of a policy, as used by the operating system (e.g. "SCHED_FIFO").
+ */
+const char* realtime_policy_name(RealtimePolicy policy);
+
+/**
+ * @brief Gives the calling thread a real-time scheduling policy.
+ *
+ * @details Threads created afterwards by the calling thread inherit the policy, so calling this before
+ * starting the writer thread gives it the same priority as the render thread.
+ *
+ * @param policy The policy; ignored on Windows.
+ * @param priority The priority, from 1 to 99 on Linux; ignored on Windows.
+ * @param error Buffer for the reason of a failure, e.g. "Operation not permitted".
+ * @param error_size The size of the error buffer.
+ * @return false if the policy was not granted, leaving the scheduling unchanged, true otherwise.
+ */
+bool realtime_set_scheduling(RealtimePolicy policy, int priority, char* error, size_t error_size);
+
+/**
+ * @brief Locks every page currently mapped by the process in memory, so it is never paged out.
+ * @details Pages that are not resident yet are faulted in by the call. Memory mapped afterwards is not
+ * locked, so that later allocations cannot fail because of the limit on locked memory: call this once
+ * the buffers used while rendering are allocated.
+ * @param error Buffer for the reason of a failure, e.g. "Cannot allocate memory" when the process may
+ * lock less memory than it uses.
+ * @param error_size The size of the error buffer.
+ * @return false if the memory could not be locked (always on Windows), true otherwise.
+ */
+bool realtime_lock_memory(char* error, size_t error_size);
+
+/**
+ * @brief Restricts the calling thread to a CPU.
+ *
+ * @details Threads created afterwards by the calling thread inherit the restriction on Linux, so call
+ * this after starting the threads that should run anywhere.
+ *
+ * @param cpu The index of the CPU, from 0.
+ * @param error Buffer for the reason of a failure.
+ * @param error_size The size of the error buffer.
+ * @return false if the thread could not be pinned (always on systems other than Linux and Windows),
+ * true otherwise.
+ */
+bool realtime_pin_thread(uint32_t cpu, char* error, size_t error_size);
+
+/**
+ * @brief Faults in every page of a buffer that will be written while rendering.
+ *
+ * @details Writes each page with its own contents, which makes the system allocate a private page even
+ * for memory that was never written and would otherwise map a shared page of zeros. The buffer must
+ * not be written by other threads during the call.
+ *
+ * @param memory The buffer, or NULL.
+ * @param size The size of the buffer in bytes.
+ * @return `size` (0 for NULL), to add up the prefaulted bytes.
+ */
+size_t realtime_prefault(void* memory, size_t size);
+
+/**
+ * @brief Faults in every page of a buffer that will only be read while rendering, such as a
+ * memory-mapped file.
+ * @return `size`, to add up the prefaulted bytes.
+ */
+size_t realtime_prefault_readonly(const void* memory, size_t size);
+
+/**
+ * @brief Touches `REALTIME_STACK_PREFAULT` bytes of the stack of the calling thread, so that calls made
+ * while rendering do not fault in stack pages.
+ */
+void realtime_prefault_stack(void);
@@ -0,0 +1,164 @@
+#include "resampler.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define MAX_TAPS 128
+#define CUTOFF 0.9 // Filter cutoff relative to the lower Nyquist frequency
+#define CHUNK_SAMPLES 256 // Input samples buffered at a time
+
+static uint32_t upsample = 0; // L
+static uint32_t downsample = 0; // M
+static uint32_t taps = 0; // Multiple of 4
+
+// taps coefficients per phase, in the same order as the history so each output is a contiguous dot product
+static float* coefficients = NULL;
+
+static float history[MAX_TAPS + CHUNK_SAMPLES];
+static uint32_t buffered = 0; // Samples in history
+static uint32_t position = 0; // Index in history of the newest sample used by the next output
+static uint32_t phase = 0;
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while(b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static float dot_product(const float* a, const float* b, uint32_t count) {
+    #ifdef RESAMPLER_SSE
+    __m128 sum = _mm_setzero_ps();
+    for(uint32_t i = 0; i < count; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+    #else
+    // Four independent sums, which compilers can map to vector registers
+    float sums[4] = { 0, 0, 0, 0 };
+    for(uint32_t i = 0; i < count; i += 4) {
+        for(uint32_t j = 0; j < 4; j++) {
+            sums[j] += a[i + j] * b[i + j];
+        }
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    #endif
+}
+
+bool resampler_init(uint32_t input_rate, uint32_t output_rate) {
+    if(input_rate == 0 || output_rate == 0) return false;
+
+    uint32_t divisor = gcd(input_rate, output_rate);
+    upsample = output_rate / divisor;
+    downsample = input_rate / divisor;
+    if(upsample > RESAMPLER_MAX_PHASES) return false;
+
+    // When downsampling the cutoff is lower, so the filter needs to be proportionally longer
+    taps = RESAMPLER_TAPS;
+    if(downsample > upsample) taps = (RESAMPLER_TAPS * downsample + upsample - 1) / upsample;
+    if(taps > MAX_TAPS) taps = MAX_TAPS;
+    taps = (taps + 3) & ~3u;
+
+    coefficients = (float*)malloc((size_t)upsample * taps * sizeof(float));
+    if(!coefficients) {
+        fprintf(stderr, "Error: Memory allocation failed in resampler_init()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Windowed sinc low-pass at the upsampled rate, cutoff in cycles per upsampled sample
+    uint32_t length = upsample * taps;
+    double cutoff = CUTOFF * 0.5 / (upsample > downsample ? upsample : downsample);
+    double center = (length - 1) / 2.0;
+    for(uint32_t p = 0; p < upsample; p++) {
+        float* phase_coefficients = &coefficients[p * taps];
+        double sum = 0;
+
+        for(uint32_t k = 0; k < taps; k++) {
+            double x = (double)k * upsample + p - center;
+            double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+            double window = 0.42 + 0.5 * cos(2 * M_PI * x / length) + 0.08 * cos(4 * M_PI * x / length); // Blackman
+            double value = sinc * window;
+
+            // Tap k multiplies the input sample k steps in the past, which is at history index taps - 1 - k
+            phase_coefficients[taps - 1 - k] = (float)value;
+            sum += value;
+        }
+
+        // Normalize every phase to unity gain, so a constant input gives a constant output
+        for(uint32_t k = 0; k < taps; k++) {
+            phase_coefficients[k] = (float)(phase_coefficients[k] / sum);
+        }
+    }
+
+    memset(history, 0, sizeof(history));
+    buffered = taps - 1;
+    position = taps - 1;
+    phase = 0;
+
+    return true;
+}
+
+void resampler_free(void) {
+    if(coefficients) {
+        free(coefficients);
+        coefficients = NULL;
+    }
+
+    upsample = 0;
+    downsample = 0;
+    taps = 0;
+}
+
+uint32_t resampler_max_output(uint32_t input_count) {
+    if(downsample == 0) return 0;
+    return (uint32_t)(((uint64_t)input_count * upsample + downsample - 1) / downsample) + 1;
+}
+
+uint32_t resampler_process(const float* input, uint32_t input_count, float* output) {
+    uint32_t produced = 0;
+
+    while(input_count > 0) {
+        uint32_t chunk = MAX_TAPS + CHUNK_SAMPLES - buffered;
+        if(chunk > input_count) chunk = input_count;
+        memcpy(&history[buffered], input, chunk * sizeof(float));
+        buffered += chunk;
+        input += chunk;
+        input_count -= chunk;
+
+        while(position < buffered) {
+            output[produced++] = dot_product(&history[position + 1 - taps], &coefficients[phase * taps], taps);
+
+            phase += downsample;
+            while(phase >= upsample) {
+                phase -= upsample;
+                position++;
+            }
+        }
+
+        // Keep only the samples still needed by the next outputs
+        uint32_t first_needed = position + 1 - taps;
+        if(first_needed > buffered) first_needed = buffered; // Downsampling can skip past the buffered samples
+        memmove(history, &history[first_needed], (buffered - first_needed) * sizeof(float));
+        buffered -= first_needed;
+        position -= first_needed;
+    }
+
+    return produced;
+}
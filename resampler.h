@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * @file resampler.h
+ * @brief Header file for the output sample rate converter.
+ *
+ * @details The looper renders at the internal sample rate, which is kept low to make rendering cheap.
+ * This module converts blocks of rendered samples to an arbitrary output rate, so the output can be
+ * played or encoded directly without a separate conversion step.
+ *
+ * The conversion uses a polyphase FIR filter. The ratio between the two rates is reduced to
+ * L/M (upsample by L, downsample by M), and a windowed sinc low-pass filter with a cutoff just below
+ * the lower of the two Nyquist frequencies is designed for the upsampled rate and split into L phases.
+ * Each output sample is then a single dot product between the most recent input samples and one of
+ * the phases, which is computed with SIMD instructions where available.
+ *
+ * Samples are processed as floats between -1 and 1. Like the other modules, the resampler is a
+ * singleton; `resampler_free()` must be called before initializing it again.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-23
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Maximum number of filter phases, i.e. maximum value of L once the ratio is reduced.
+ */
+#define RESAMPLER_MAX_PHASES 4096
+
+/**
+ * @brief Number of filter taps per phase when upsampling; more taps are used when downsampling.
+ */
+#define RESAMPLER_TAPS 16
+
+/**
+ * @brief Initializes the resampler.
+ *
+ * @details The filter coefficients are allocated dynamically. Previously allocated memory will not be
+ * freed automatically; use `resampler_free()` to free it when no longer needed.
+ *
+ * @param input_rate The sample rate of the input, in Hz.
+ * @param output_rate The sample rate of the output, in Hz.
+ * @return false if either rate is 0 or the reduced ratio needs more than `RESAMPLER_MAX_PHASES`
+ * phases, true otherwise.
+ */
+bool resampler_init(uint32_t input_rate, uint32_t output_rate);
+
+/**
+ * @brief Frees the memory allocated by `resampler_init()`.
+ */
+void resampler_free(void);
+
+/**
+ * @brief Retrieves the maximum number of output samples `resampler_process()` can produce from a
+ * block of input samples.
+ * @param input_count The number of input samples.
+ */
+uint32_t resampler_max_output(uint32_t input_count);
+
+/**
+ * @brief Resamples a block of samples.
+ *
+ * @details All the input samples are consumed; the filter state is carried over to the next call, so
+ * a continuous stream can be converted one block at a time. The output is delayed by half the filter
+ * length.
+ *
+ * @param input The input samples.
+ * @param input_count The number of input samples.
+ * @param output The buffer for the output samples; it must have room for at least
+ * `resampler_max_output(input_count)` samples.
+ * @return The number of output samples written.
+ */
+uint32_t resampler_process(const float* input, uint32_t input_count, float* output);
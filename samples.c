@@ -0,0 +1,323 @@
+#include "samples.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#define SAMPLES_MMAP 0
+#else
+#define SAMPLES_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// A file in the cache
+typedef struct loaded_file {
+    char* path;
+    uint64_t device; // Identifies the file along with `inode`, if `has_id`
+    uint64_t inode;
+    bool has_id;
+
+    const uint8_t* data;
+    uint32_t length;
+
+    void* mapping; // The mapped file, if still mapped
+    size_t mapping_size;
+    uint8_t* buffer; // The allocated memory holding the file or the converted samples, if any
+} LoadedFile;
+
+static LoadedFile* files = NULL;
+static uint32_t file_count = 0;
+static uint32_t file_capacity = 0;
+
+static uint16_t get_u16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)get_u16(in) | ((uint32_t)get_u16(in + 2) << 16);
+}
+
+// Format of the data chunk of a WAV file
+typedef struct wav_format {
+    uint16_t format; // WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+    uint16_t channels;
+    uint16_t bits;
+    uint16_t block_align;
+    size_t data_offset;
+    size_t data_size;
+} WavFormat;
+
+// Parses and validates the header of a WAV file, returning NULL or a description of the problem
+static const char* parse_wav(const uint8_t* file, size_t size, WavFormat* out) {
+    bool has_format = false;
+
+    // Chunk sizes are not trusted: the data chunk may be open-ended (0xFFFFFFFF) if written to a pipe
+    size_t offset = 12;
+    while(offset + 8 <= size) {
+        const uint8_t* chunk = file + offset;
+        size_t chunk_size = get_u32(chunk + 4);
+        size_t available = size - offset - 8;
+
+        if(memcmp(chunk, "fmt ", 4) == 0) {
+            if(chunk_size < 16 || chunk_size > available) return "truncated format chunk";
+            out->format = get_u16(chunk + 8);
+            out->channels = get_u16(chunk + 10);
+            out->block_align = get_u16(chunk + 20);
+            out->bits = get_u16(chunk + 22);
+            if(out->format == WAVE_FORMAT_EXTENSIBLE) {
+                if(chunk_size < 40) return "truncated format chunk";
+                out->format = get_u16(chunk + 32); // First bytes of the sub-format GUID
+            }
+            has_format = true;
+        } else if(memcmp(chunk, "data", 4) == 0) {
+            if(!has_format) return "data chunk before the format chunk";
+            out->data_offset = offset + 8;
+            out->data_size = chunk_size < available ? chunk_size : available;
+            break;
+        }
+
+        if(chunk_size > available) return "truncated chunk";
+        offset += 8 + chunk_size + (chunk_size & 1); // Chunks are padded to an even size
+    }
+
+    if(!has_format) return "no format chunk";
+    if(offset + 8 > size) return "no data chunk";
+
+    bool pcm = out->format == WAVE_FORMAT_PCM && (out->bits == 8 || out->bits == 16 || out->bits == 24);
+    bool ieee_float = out->format == WAVE_FORMAT_IEEE_FLOAT && out->bits == 32;
+    if(!pcm && !ieee_float) return "unsupported sample format (expected 8, 16 or 24-bit PCM, or 32-bit float)";
+    if(out->channels == 0 || out->block_align != out->channels * (out->bits / 8)) return "inconsistent block alignment";
+    if(out->data_size < out->block_align) return "no samples";
+    if(out->data_size / out->block_align > SAMPLES_MAX_LENGTH) return "too many samples";
+
+    return NULL;
+}
+
+// Reads a sample of a WAV file as a value from -32768 to 32767
+static inline int32_t read_sample(const uint8_t* in, const WavFormat* format) {
+    if(format->format == WAVE_FORMAT_IEEE_FLOAT) {
+        uint32_t bits = get_u32(in);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if(!(value > -1.0f)) value = -1.0f; // Also catches NaN
+        if(value > 1.0f) value = 1.0f;
+        return (int32_t)(value * 32767.0f);
+    }
+
+    switch(format->bits) {
+        case 8: return ((int32_t)in[0] - 128) << 8;
+        case 16: return (int16_t)get_u16(in);
+        default: return (int16_t)get_u16(in + 1); // 24-bit: the two most significant bytes
+    }
+}
+
+// Converts the data chunk of a WAV file to unsigned 8-bit mono samples
+static void convert_wav(const uint8_t* data, const WavFormat* format, uint8_t* out, uint32_t length) {
+    if(format->format == WAVE_FORMAT_PCM && format->bits == 16 && format->channels == 1) {
+        // The most common case: the high byte, made unsigned, in a loop the compiler can vectorize
+        for(uint32_t i = 0; i < length; i++) {
+            out[i] = data[i * 2 + 1] ^ 0x80;
+        }
+        return;
+    }
+
+    uint16_t sample_size = format->bits / 8;
+    for(uint32_t i = 0; i < length; i++) {
+        const uint8_t* frame = data + (size_t)i * format->block_align;
+        int32_t sum = 0;
+        for(uint16_t channel = 0; channel < format->channels; channel++) {
+            sum += read_sample(frame + channel * sample_size, format);
+        }
+        out[i] = (uint8_t)((sum / format->channels >> 8) + 128);
+    }
+}
+
+static void* allocate(size_t size) {
+    void* memory = malloc(size);
+    if(!memory) {
+        fprintf(stderr, "Error: Memory allocation failed in samples_load()\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+// Adds a file to the cache, or finds the one with the same identity
+static LoadedFile* find_file(const char* path, bool has_id, uint64_t device, uint64_t inode) {
+    for(uint32_t i = 0; i < file_count; i++) {
+        LoadedFile* file = &files[i];
+        if(has_id ? (file->has_id && file->device == device && file->inode == inode) : strcmp(file->path, path) == 0) {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+static LoadedFile* add_file(const char* path, bool has_id, uint64_t device, uint64_t inode) {
+    if(file_count == file_capacity) {
+        uint32_t new_capacity = file_capacity == 0 ? 16 : file_capacity * 2;
+        LoadedFile* new_files = (LoadedFile*)realloc(files, new_capacity * sizeof(LoadedFile));
+        if(!new_files) {
+            fprintf(stderr, "Error: Memory allocation failed in samples_load()\n");
+            exit(EXIT_FAILURE);
+        }
+        files = new_files;
+        file_capacity = new_capacity;
+    }
+
+    LoadedFile* file = &files[file_count++];
+    *file = (LoadedFile){ .has_id = has_id, .device = device, .inode = inode };
+    file->path = (char*)allocate(strlen(path) + 1);
+    strcpy(file->path, path);
+    return file;
+}
+
+static void release_file(LoadedFile* file) {
+    #if SAMPLES_MMAP
+    if(file->mapping) munmap(file->mapping, file->mapping_size);
+    #endif
+    free(file->buffer);
+    free(file->path);
+}
+
+const uint8_t* samples_load(const char* path, uint32_t* out_length, char* error, size_t error_size) {
+    bool has_id = false;
+    uint64_t device = 0, inode = 0;
+    size_t size;
+
+    #if SAMPLES_MMAP
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        if(fd >= 0) close(fd);
+        snprintf(error, error_size, "%s: could not open the file", path);
+        return NULL;
+    }
+    has_id = true;
+    device = (uint64_t)info.st_dev;
+    inode = (uint64_t)info.st_ino;
+    size = (size_t)info.st_size;
+    #endif
+
+    LoadedFile* cached = find_file(path, has_id, device, inode);
+    if(cached) {
+        #if SAMPLES_MMAP
+        close(fd);
+        #endif
+        *out_length = cached->length;
+        return cached->data;
+    }
+
+    // Map or read the whole file
+    void* mapping = NULL;
+    uint8_t* buffer = NULL;
+    const uint8_t* contents;
+
+    #if SAMPLES_MMAP
+    if(size > 0) mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(size > 0 && mapping == MAP_FAILED) {
+        snprintf(error, error_size, "%s: could not map the file", path);
+        return NULL;
+    }
+    contents = (const uint8_t*)mapping;
+    #else
+    FILE* stream = fopen(path, "rb");
+    long stream_size = -1;
+    if(stream && fseek(stream, 0, SEEK_END) == 0) stream_size = ftell(stream);
+    if(stream_size < 0 || fseek(stream, 0, SEEK_SET) != 0) {
+        if(stream) fclose(stream);
+        snprintf(error, error_size, "%s: could not open the file", path);
+        return NULL;
+    }
+    size = (size_t)stream_size;
+    buffer = (uint8_t*)allocate(size > 0 ? size : 1);
+    bool read_ok = fread(buffer, 1, size, stream) == size;
+    fclose(stream);
+    if(!read_ok) {
+        free(buffer);
+        snprintf(error, error_size, "%s: could not read the file", path);
+        return NULL;
+    }
+    contents = buffer;
+    #endif
+
+    const uint8_t* data = NULL;
+    uint32_t length = 0;
+    const char* problem = NULL;
+
+    if(size >= 12 && memcmp(contents, "RIFF", 4) == 0 && memcmp(contents + 8, "WAVE", 4) == 0) {
+        WavFormat format;
+        problem = parse_wav(contents, size, &format);
+        if(!problem) {
+            length = (uint32_t)(format.data_size / format.block_align);
+            if(format.format == WAVE_FORMAT_PCM && format.bits == 8 && format.channels == 1) {
+                data = contents + format.data_offset; // Already in the internal format
+            } else {
+                uint8_t* converted = (uint8_t*)allocate(length);
+                convert_wav(contents + format.data_offset, &format, converted, length);
+
+                // Only the converted samples are needed from now on
+                #if SAMPLES_MMAP
+                munmap(mapping, size);
+                mapping = NULL;
+                #else
+                free(buffer);
+                #endif
+                buffer = converted;
+                data = converted;
+            }
+        }
+    } else if(size == 0) {
+        problem = "empty file";
+    } else if(size > SAMPLES_MAX_LENGTH) {
+        problem = "too many samples";
+    } else {
+        data = contents; // Raw unsigned 8-bit samples
+        length = (uint32_t)size;
+    }
+
+    if(problem) {
+        snprintf(error, error_size, "%s: %s", path, problem);
+        #if SAMPLES_MMAP
+        if(mapping) munmap(mapping, size);
+        #endif
+        free(buffer);
+        return NULL;
+    }
+
+    LoadedFile* file = add_file(path, has_id, device, inode);
+    file->data = data;
+    file->length = length;
+    file->mapping = mapping;
+    file->mapping_size = size;
+    file->buffer = buffer;
+
+    *out_length = length;
+    return data;
+}
+
+uint32_t samples_loaded_count(void) {
+    return file_count;
+}
+
+void samples_unload_all(void) {
+    for(uint32_t i = 0; i < file_count; i++) {
+        release_file(&files[i]);
+    }
+
+    free(files);
+    files = NULL;
+    file_count = 0;
+    file_capacity = 0;
+}
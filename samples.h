@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * @file samples.h
+ * @brief Header file for the sample loader, which loads wavetables for the custom channel from files.
+ *
+ * @details Files are memory-mapped rather than read, so loading a large library only maps it: the
+ * operating system reads the pages of a wavetable when it is first played, and shares them between
+ * processes rendering songs that use the same files. Two formats are supported:
+ * - WAV files (detected by their `RIFF`/`WAVE` header), with 8-bit unsigned, 16-bit signed, 24-bit
+ *   signed or 32-bit float PCM samples and any number of channels. The header is validated, and the
+ *   whole data chunk is one cycle of the waveform.
+ * - Any other file is raw data: one cycle of unsigned 8-bit samples.
+ *
+ * Raw files and 8-bit mono WAV files are used in place, without any copy. Other WAV files are
+ * converted once to unsigned 8-bit mono (mixing the channels) into an allocated buffer, and the file
+ * is unmapped. The sample rate of a WAV file is ignored: the custom channel plays the data as a single
+ * cycle at the frequency of each note, whatever its length.
+ *
+ * Loaded files are cached until `samples_unload_all()`, so loading the same file again (e.g. from
+ * several songs) returns the same data; files are identified by device and inode where available, and
+ * by path otherwise. On Windows, files are read into allocated memory instead of being mapped.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-28
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Maximum length of a wavetable, in samples.
+ */
+#define SAMPLES_MAX_LENGTH (1u << 30)
+
+/**
+ * @brief Loads a wavetable from a file, or retrieves it from the cache.
+ *
+ * @details The data stays valid until `samples_unload_all()` is called, and can be registered in the
+ * custom channel's bank with `custom_bank_set()`.
+ *
+ * @param path The path of the file.
+ * @param out_length Set to the number of samples of the wavetable.
+ * @param error Buffer for a description of the error, if the file could not be loaded.
+ * @param error_size The size of the error buffer.
+ * @return The samples, unsigned 8-bit mono, or NULL on error.
+ */
+const uint8_t* samples_load(const char* path, uint32_t* out_length, char* error, size_t error_size);
+
+/**
+ * @brief Retrieves the number of files in the cache.
+ */
+uint32_t samples_loaded_count(void);
+
+/**
+ * @brief Unmaps or frees every loaded file, invalidating the data returned by `samples_load()`.
+ *
+ * @details Wavetables registered in the custom channel's bank must be removed first, e.g. with
+ * `custom_bank_clear()`.
+ */
+void samples_unload_all(void);
@@ -1,22 +1,47 @@
 #include "sawtooth.h"
 #include "macros.h"
 #include "utils.h"
+#include "bandlimited.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-static uint16_t current_sample = 0;
+static uint32_t sample_rate = SAMPLE_RATE;
+static uint32_t current_sample = 0;
+static uint64_t sample_rate_reciprocal = RECIPROCAL(SAMPLE_RATE);
 
 static uint16_t samples_per_step = 1;
 static uint8_t amplitude = 255;
 
+static bool band_limited = false;
+static const int16_t* table = NULL; // Band-limited table for the current frequency
+static uint32_t index_scale = 0; // Converts the phase to a wavetable index, see bandlimited_index_scale()
+
 uint16_t sawtooth_frequency(void) {
     return samples_per_step;
 }
 
 void sawtooth_set_frequency(uint16_t frequency) {
+    if(band_limited && frequency != samples_per_step) {
+        table = bandlimited_table(BANDLIMITED_SAWTOOTH, frequency);
+    }
     samples_per_step = frequency;
 }
 
+bool sawtooth_band_limited(void) {
+    return band_limited;
+}
+
+void sawtooth_set_band_limited(bool enabled) {
+    if(enabled) {
+        bandlimited_init(sample_rate);
+        index_scale = bandlimited_index_scale(sample_rate);
+        table = bandlimited_table(BANDLIMITED_SAWTOOTH, samples_per_step);
+    }
+    band_limited = enabled;
+}
+
 uint8_t sawtooth_amplitude(void) {
     return amplitude;
 }
@@ -25,13 +50,31 @@ void sawtooth_set_amplitude(uint8_t amp) {
     amplitude = amp;
 }
 
+uint32_t sawtooth_sample_rate(void) {
+    return sample_rate;
+}
+
+void sawtooth_set_sample_rate(uint32_t rate) {
+    sample_rate = rate;
+    sample_rate_reciprocal = RECIPROCAL(rate);
+    current_sample %= sample_rate;
+
+    if(band_limited) sawtooth_set_band_limited(true);
+}
+
 uint8_t sawtooth_step(void) {
     if (samples_per_step == 0) {
         return 128; // No sound if samples per cycle is zero
     }
 
-    uint8_t output = apply_amplitude(255 * current_sample / SAMPLE_RATE, amplitude);
-    current_sample = (current_sample + samples_per_step) % SAMPLE_RATE;
+    uint8_t output;
+    if(band_limited) {
+        uint16_t index = bandlimited_index(current_sample, index_scale);
+        output = apply_amplitude(bandlimited_to_u8(table[index]), amplitude);
+    } else {
+        output = apply_amplitude(reciprocal_divide(255 * current_sample, sample_rate_reciprocal), amplitude);
+    }
+    current_sample = advance_phase(current_sample, samples_per_step, sample_rate);
 
     return output;
 }
\ No newline at end of file
@@ -0,0 +1,308 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For accept4()
+#endif
+
+#include "server.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define MAX_EVENTS 64
+
+// A published block, shared by the queues of all the clients
+typedef struct shared_block {
+    uint32_t references;
+    size_t size;
+    uint8_t data[];
+} SharedBlock;
+
+typedef struct client {
+    int fd;
+    SharedBlock** queue; // Circular queue of queue_blocks blocks
+    uint32_t head;
+    uint32_t count;
+    size_t offset; // Bytes of the first block already sent
+    bool polling_output; // Whether EPOLLOUT is enabled
+    bool input_closed; // Whether the client shut down its sending side, so EPOLLIN is disabled
+} Client;
+
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static char* socket_path = NULL;
+static uint32_t queue_blocks = SERVER_DEFAULT_QUEUE_BLOCKS;
+
+static Client** clients = NULL;
+static uint32_t client_count = 0;
+static uint32_t client_capacity = 0;
+
+static uint64_t clients_accepted = 0;
+static uint64_t clients_evicted = 0;
+static uint32_t peak_queue = 0;
+
+#ifdef __linux__
+static void release_block(SharedBlock* block) {
+    if(--block->references == 0) free(block);
+}
+
+static void remove_client(Client* client) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+
+    for(uint32_t i = 0; i < client->count; i++) {
+        release_block(client->queue[(client->head + i) % queue_blocks]);
+    }
+    free(client->queue);
+
+    for(uint32_t i = 0; i < client_count; i++) {
+        if(clients[i] == client) {
+            clients[i] = clients[--client_count];
+            break;
+        }
+    }
+    free(client);
+}
+
+static void update_polling(Client* client) {
+    struct epoll_event event = {0};
+    event.events = (client->input_closed ? 0 : EPOLLIN) | (client->polling_output ? EPOLLOUT : 0);
+    event.data.ptr = client;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+static void set_polling_output(Client* client, bool enabled) {
+    if(client->polling_output == enabled) return;
+
+    client->polling_output = enabled;
+    update_polling(client);
+}
+
+// Sends as much of the queue as the socket accepts; returns false if the client must be removed
+static bool flush_client(Client* client) {
+    while(client->count > 0) {
+        SharedBlock* block = client->queue[client->head];
+        ssize_t sent = send(client->fd, block->data + client->offset, block->size - client->offset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(sent < 0) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                set_polling_output(client, true);
+                return true;
+            }
+            return false;
+        }
+
+        client->offset += (size_t)sent;
+        if(client->offset == block->size) {
+            release_block(block);
+            client->head = (client->head + 1) % queue_blocks;
+            client->count--;
+            client->offset = 0;
+        }
+    }
+
+    set_polling_output(client, false);
+    return true;
+}
+
+static void accept_clients(void) {
+    while(true) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno == EINTR) continue;
+            return; // EAGAIN, or an error the next poll will report again
+        }
+
+        Client* client = (Client*)calloc(1, sizeof(Client));
+        SharedBlock** queue = client ? (SharedBlock**)malloc(queue_blocks * sizeof(SharedBlock*)) : NULL;
+        if(!client || !queue) {
+            fprintf(stderr, "Error: Memory allocation failed in accept_clients()\n");
+            exit(EXIT_FAILURE);
+        }
+        client->fd = fd;
+        client->queue = queue;
+
+        if(client_count == client_capacity) {
+            uint32_t new_capacity = client_capacity == 0 ? 16 : client_capacity * 2;
+            Client** new_clients = (Client**)realloc(clients, new_capacity * sizeof(Client*));
+            if(!new_clients) {
+                fprintf(stderr, "Error: Memory allocation failed in accept_clients()\n");
+                exit(EXIT_FAILURE);
+            }
+            clients = new_clients;
+            client_capacity = new_capacity;
+        }
+
+        struct epoll_event event = {0};
+        event.events = EPOLLIN;
+        event.data.ptr = client;
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            free(queue);
+            free(client);
+            continue;
+        }
+
+        clients[client_count++] = client;
+        clients_accepted++;
+    }
+}
+
+// Handles the pending events without waiting: new connections, disconnections and writable sockets
+static void poll_events(void) {
+    struct epoll_event events[MAX_EVENTS];
+    int count;
+
+    do {
+        count = epoll_wait(epoll_fd, events, MAX_EVENTS, 0);
+        for(int i = 0; i < count; i++) {
+            Client* client = (Client*)events[i].data.ptr;
+            if(!client) {
+                accept_clients();
+                continue;
+            }
+
+            // A client that only shut down its sending side (EPOLLRDHUP) is still listening, so it is only
+            // removed once the connection is closed, a send fails or its queue is full
+            bool keep = !(events[i].events & (EPOLLERR | EPOLLHUP));
+            if(keep && (events[i].events & EPOLLIN)) {
+                // Clients are not expected to send anything; discard it
+                uint8_t discard[256];
+                ssize_t received = recv(client->fd, discard, sizeof(discard), MSG_DONTWAIT);
+                if(received == 0) {
+                    // The end of the stream stays readable, so stop polling for input
+                    client->input_closed = true;
+                    update_polling(client);
+                }
+                else if(received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) keep = false;
+            }
+            if(keep && (events[i].events & EPOLLOUT)) keep = flush_client(client);
+
+            if(!keep) remove_client(client);
+        }
+    } while(count == MAX_EVENTS);
+}
+#endif
+
+bool server_start(const char* path, uint32_t queue_blocks_value) {
+    #ifdef __linux__
+    struct sockaddr_un address = {0};
+    if(listen_fd >= 0 || queue_blocks_value == 0 || strlen(path) >= sizeof(address.sun_path)) return false;
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+
+    if(listen_fd < 0 || epoll_fd < 0
+        || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0
+        || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) != 0) {
+        if(listen_fd >= 0) close(listen_fd);
+        if(epoll_fd >= 0) close(epoll_fd);
+        listen_fd = -1;
+        epoll_fd = -1;
+        return false;
+    }
+
+    socket_path = strdup(path);
+    if(!socket_path) {
+        fprintf(stderr, "Error: Memory allocation failed in server_start()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue_blocks = queue_blocks_value;
+    clients_accepted = 0;
+    clients_evicted = 0;
+    peak_queue = 0;
+    return true;
+    #else
+    (void)path; (void)queue_blocks_value;
+    return false;
+    #endif
+}
+
+bool server_publish(const uint8_t* data, size_t size) {
+    #ifdef __linux__
+    if(listen_fd < 0) return false;
+
+    poll_events();
+    if(client_count == 0) return true;
+
+    SharedBlock* block = (SharedBlock*)malloc(sizeof(SharedBlock) + size);
+    if(!block) {
+        fprintf(stderr, "Error: Memory allocation failed in server_publish()\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(block->data, data, size);
+    block->size = size;
+    block->references = 1; // Held until every client has queued it
+
+    // Iterate backwards, since removing a client moves the last one to its index
+    for(uint32_t i = client_count; i-- > 0;) {
+        Client* client = clients[i];
+        if(client->count == queue_blocks) {
+            clients_evicted++;
+            remove_client(client);
+            continue;
+        }
+
+        block->references++;
+        client->queue[(client->head + client->count) % queue_blocks] = block;
+        client->count++;
+        if(client->count > peak_queue) peak_queue = client->count;
+
+        if(!flush_client(client)) remove_client(client);
+    }
+
+    release_block(block);
+    return true;
+    #else
+    (void)data; (void)size;
+    return false;
+    #endif
+}
+
+void server_metrics(ServerMetrics* out) {
+    out->clients = client_count;
+    out->clients_accepted = clients_accepted;
+    out->clients_evicted = clients_evicted;
+    out->peak_queue = peak_queue;
+}
+
+void server_stop(void) {
+    #ifdef __linux__
+    if(listen_fd < 0) return;
+
+    while(client_count > 0) {
+        remove_client(clients[client_count - 1]);
+    }
+    free(clients);
+    clients = NULL;
+    client_capacity = 0;
+
+    close(epoll_fd);
+    close(listen_fd);
+    epoll_fd = -1;
+    listen_fd = -1;
+
+    unlink(socket_path);
+    free(socket_path);
+    socket_path = NULL;
+    #endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file server.h
+ * @brief Header file for the streaming server, an output sink that fans one render out to many clients.
+ *
+ * @details The server listens on a Unix domain socket, and every published block is sent to all the
+ * connected clients, so any number of listeners share a single render. Clients receive the raw
+ * samples in the output format, starting from the first block published after they connect.
+ *
+ * Sockets are non-blocking and multiplexed with epoll from the thread that publishes the blocks, so
+ * no extra thread is needed. Blocks are shared between the clients rather than copied, and each
+ * client has a bounded queue of blocks that could not be sent yet; a client whose queue is full when
+ * a new block is published is too slow to keep up, and is disconnected. Clients are otherwise only
+ * disconnected when the connection is closed or fails: a client that shuts down its sending side
+ * keeps listening.
+ *
+ * The server is only available on Linux; elsewhere `server_start()` returns false.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-25
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Default maximum number of blocks queued for a client.
+ */
+#define SERVER_DEFAULT_QUEUE_BLOCKS 50
+
+/**
+ * @brief Metrics of the server, see `server_metrics()`.
+ */
+typedef struct server_metrics {
+    /** Number of clients currently connected. */
+    uint32_t clients;
+    /** Number of clients that connected so far. */
+    uint64_t clients_accepted;
+    /** Number of clients disconnected because their queue was full. */
+    uint64_t clients_evicted;
+    /** Highest number of blocks queued for a client. */
+    uint32_t peak_queue;
+} ServerMetrics;
+
+/**
+ * @brief Starts listening on a Unix domain socket.
+ *
+ * @details An existing file at `path` is replaced. The socket is removed by `server_stop()`.
+ *
+ * @param path The path of the socket.
+ * @param queue_blocks The maximum number of blocks queued for a client, at least 1.
+ * @return false if the socket could not be created, true otherwise.
+ */
+bool server_start(const char* path, uint32_t queue_blocks);
+
+/**
+ * @brief Accepts the pending connections and sends a block to all the connected clients.
+ *
+ * @details Clients whose queue is full are disconnected. The function never blocks.
+ *
+ * @param data The data of the block.
+ * @param size The size of the block, in bytes.
+ * @return false if the server is not started, true otherwise.
+ */
+bool server_publish(const uint8_t* data, size_t size);
+
+/**
+ * @brief Retrieves the metrics of the server.
+ * @param out Set to the current metrics.
+ */
+void server_metrics(ServerMetrics* out);
+
+/**
+ * @brief Disconnects all the clients, closes the socket and removes it.
+ */
+void server_stop(void);
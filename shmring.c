@@ -0,0 +1,222 @@
+#include "shmring.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static uint8_t* memory = NULL; // The mapping, starting with the header
+static size_t memory_size = 0;
+static char* created_name = NULL; // Name to unlink on destroy, NULL when attached as a reader
+
+#define HEADER ((ShmringHeader*)memory)
+#define SLOTS ((ShmringSlot*)(memory + ROUND_UP(sizeof(ShmringHeader))))
+#define ROUND_UP(size) (((size) + SHMRING_ALIGNMENT - 1) / SHMRING_ALIGNMENT * SHMRING_ALIGNMENT)
+
+#ifdef __linux__
+// The futex word is shared between processes, so the non-private operations are used
+static void futex_wake(volatile uint32_t* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void futex_wait(volatile uint32_t* word, uint32_t expected) {
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+static bool map(int fd, size_t size, int protection) {
+    void* address = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    if(address == MAP_FAILED) return false;
+
+    memory = (uint8_t*)address;
+    memory_size = size;
+    return true;
+}
+#endif
+
+bool shmring_create(const char* name, uint32_t sample_rate, OutputFormat format, uint32_t block_count, uint32_t block_capacity) {
+    #ifdef __linux__
+    if(memory || block_count == 0 || block_capacity == 0) return false;
+
+    size_t slots_offset = ROUND_UP(sizeof(ShmringHeader));
+    size_t data_offset = ROUND_UP(slots_offset + (size_t)block_count * sizeof(ShmringSlot));
+    size_t block_stride = ROUND_UP((size_t)block_capacity);
+    size_t size = data_offset + (size_t)block_count * block_stride;
+    if(data_offset > UINT32_MAX || block_stride > UINT32_MAX) return false;
+
+    shm_unlink(name); // Readers of a previous ring keep their mapping
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) return false;
+
+    bool mapped = ftruncate(fd, (off_t)size) == 0 && map(fd, size, PROT_READ | PROT_WRITE);
+    close(fd);
+    if(!mapped) {
+        shm_unlink(name);
+        return false;
+    }
+
+    created_name = strdup(name);
+    if(!created_name) {
+        fprintf(stderr, "Error: Memory allocation failed in shmring_create()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The new object is zero-filled, so every slot starts empty
+    ShmringHeader* header = HEADER;
+    header->version = SHMRING_VERSION;
+    header->sample_rate = sample_rate;
+    header->format = (uint32_t)format;
+    header->block_count = block_count;
+    header->block_capacity = block_capacity;
+    header->block_stride = (uint32_t)block_stride;
+    header->data_offset = (uint32_t)data_offset;
+    __atomic_store_n(&header->magic, SHMRING_MAGIC, __ATOMIC_RELEASE); // Readers check the magic last
+
+    return true;
+    #else
+    (void)name; (void)sample_rate; (void)format; (void)block_count; (void)block_capacity;
+    return false;
+    #endif
+}
+
+bool shmring_publish(const uint8_t* data, size_t size) {
+    #ifdef __linux__
+    if(!memory || !created_name || size > HEADER->block_capacity) return false;
+
+    ShmringHeader* header = HEADER;
+    uint64_t sequence = header->published;
+    ShmringSlot* slot = &SLOTS[sequence % header->block_count];
+
+    // Invalidate the slot before overwriting it, so readers of the old block notice
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(memory + header->data_offset + (sequence % header->block_count) * header->block_stride, data, size);
+    slot->size = (uint32_t)size;
+
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->published, sequence + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&header->notify, 1, __ATOMIC_RELEASE);
+    futex_wake(&header->notify);
+
+    return true;
+    #else
+    (void)data; (void)size;
+    return false;
+    #endif
+}
+
+void shmring_destroy(void) {
+    #ifdef __linux__
+    if(!memory || !created_name) return;
+
+    __atomic_store_n(&HEADER->closed, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&HEADER->notify, 1, __ATOMIC_RELEASE);
+    futex_wake(&HEADER->notify);
+
+    munmap(memory, memory_size);
+    shm_unlink(created_name);
+    free(created_name);
+    created_name = NULL;
+    memory = NULL;
+    memory_size = 0;
+    #endif
+}
+
+bool shmring_attach(const char* name) {
+    #ifdef __linux__
+    if(memory) return false;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) return false;
+
+    struct stat info;
+    bool mapped = fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ShmringHeader)
+        && map(fd, (size_t)info.st_size, PROT_READ);
+    close(fd);
+    if(!mapped) return false;
+
+    const ShmringHeader* header = HEADER;
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHMRING_MAGIC || header->version != SHMRING_VERSION
+        || header->block_count == 0 || header->data_offset + (size_t)header->block_count * header->block_stride > memory_size) {
+        shmring_detach();
+        return false;
+    }
+
+    return true;
+    #else
+    (void)name;
+    return false;
+    #endif
+}
+
+const ShmringHeader* shmring_header(void) {
+    return memory ? HEADER : NULL;
+}
+
+ShmringStatus shmring_read(uint64_t* sequence, const uint8_t** data, size_t* size, bool wait) {
+    #ifdef __linux__
+    ShmringHeader* header = HEADER;
+
+    while(true) {
+        // Read the futex word first, so a block published after the checks below wakes the wait
+        uint32_t notify = __atomic_load_n(&header->notify, __ATOMIC_ACQUIRE);
+        uint64_t published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+
+        if(*sequence + header->block_count < published + 1) {
+            // Keep one slot of margin, since the oldest block may already be being overwritten
+            *sequence = published - header->block_count + 1;
+            return SHMRING_LATE;
+        }
+
+        if(*sequence < published) {
+            const ShmringSlot* slot = &SLOTS[*sequence % header->block_count];
+            if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != *sequence + 1) {
+                *sequence = published - header->block_count + 1;
+                return SHMRING_LATE;
+            }
+
+            *data = memory + header->data_offset + (*sequence % header->block_count) * header->block_stride;
+            *size = slot->size;
+            return SHMRING_OK;
+        }
+
+        if(__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) return SHMRING_CLOSED;
+        if(!wait) return SHMRING_AGAIN;
+
+        futex_wait(&header->notify, notify);
+    }
+    #else
+    (void)sequence; (void)data; (void)size; (void)wait;
+    return SHMRING_CLOSED;
+    #endif
+}
+
+bool shmring_valid(uint64_t sequence) {
+    if(!memory) return false;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); // Order the reads of the block before the check
+    const ShmringSlot* slot = &SLOTS[sequence % HEADER->block_count];
+    return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence + 1;
+}
+
+void shmring_detach(void) {
+    #ifdef __linux__
+    if(!memory || created_name) return;
+
+    munmap(memory, memory_size);
+    memory = NULL;
+    memory_size = 0;
+    #endif
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+/**
+ * @file shmring.h
+ * @brief Header file for the shared-memory ring, an output sink for local consumers.
+ *
+ * @details Rendered blocks are published into a named POSIX shared-memory object (see `shm_open()`),
+ * which any number of local processes can map and read in place, without copies through the kernel
+ * and without slowing down the producer: readers that fall more than a ring behind lose blocks, and
+ * are told so.
+ *
+ * The shared memory starts with a `ShmringHeader`, followed by `block_count` `ShmringSlot`
+ * descriptors and by the data of the blocks, each `block_stride` bytes apart. Blocks are numbered
+ * from 0 in the order they are published, and block `n` is stored in slot `n % block_count`. The
+ * sequence of a slot is set to 0 while the block is being written, and to `n + 1` once block `n` is
+ * complete; readers check it again after reading a block, to detect that it was overwritten in the
+ * meantime. Every published block increments the `notify` futex word of the header and wakes up the
+ * readers waiting on it.
+ *
+ * The same module implements both sides: a process either creates a ring with `shmring_create()` or
+ * attaches to one with `shmring_attach()`. The ring is only available on Linux; elsewhere the
+ * functions return false.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-25
+ */
+
+#include "output.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Value of `ShmringHeader.magic`, "CBRG" in little endian.
+ */
+#define SHMRING_MAGIC 0x47524243u
+
+/**
+ * @brief Version of the memory layout, stored in `ShmringHeader.version`.
+ */
+#define SHMRING_VERSION 1
+
+/**
+ * @brief Default number of blocks in the ring.
+ */
+#define SHMRING_DEFAULT_BLOCKS 64
+
+/**
+ * @brief Alignment of the slots and blocks in the shared memory, in bytes.
+ */
+#define SHMRING_ALIGNMENT 64
+
+/**
+ * @brief Header at the beginning of the shared memory.
+ */
+typedef struct shmring_header {
+    /** `SHMRING_MAGIC`. */
+    uint32_t magic;
+    /** `SHMRING_VERSION`. */
+    uint32_t version;
+    /** The sample rate of the audio, in Hz. */
+    uint32_t sample_rate;
+    /** The format of the samples, as an `OutputFormat` value. */
+    uint32_t format;
+    /** The number of blocks in the ring. */
+    uint32_t block_count;
+    /** The maximum size of a block, in bytes. */
+    uint32_t block_capacity;
+    /** The distance between the data of two consecutive blocks, in bytes. */
+    uint32_t block_stride;
+    /** The offset of the data of the first block from the beginning of the shared memory, in bytes. */
+    uint32_t data_offset;
+    /** Number of blocks published so far. */
+    volatile uint64_t published;
+    /** Futex word, incremented whenever a block is published or the ring is closed. */
+    volatile uint32_t notify;
+    /** Set to 1 when the producer closes the ring. */
+    volatile uint32_t closed;
+} ShmringHeader;
+
+/**
+ * @brief Descriptor of a block in the ring.
+ */
+typedef struct shmring_slot {
+    /** The number of the block in the slot plus 1, or 0 if the slot is empty or being written. */
+    volatile uint64_t sequence;
+    /** The size of the block, in bytes. */
+    volatile uint32_t size;
+    uint32_t reserved;
+} ShmringSlot;
+
+/**
+ * @brief Results of `shmring_read()`.
+ */
+typedef enum shmring_status {
+    /** The block was read. */
+    SHMRING_OK,
+    /** The block is not published yet, and `wait` was false. */
+    SHMRING_AGAIN,
+    /** The block was overwritten; the sequence was moved to the oldest block still in the ring. */
+    SHMRING_LATE,
+    /** The producer closed the ring, and every block was read. */
+    SHMRING_CLOSED
+} ShmringStatus;
+
+/**
+ * @brief Creates a shared-memory ring and maps it.
+ *
+ * @details An existing object with the same name is replaced. The ring is unlinked by
+ * `shmring_destroy()`.
+ *
+ * @param name The name of the shared-memory object, starting with "/" (e.g. "/cbeat").
+ * @param sample_rate The sample rate of the audio, in Hz.
+ * @param format The format of the samples that will be published.
+ * @param block_count The number of blocks in the ring.
+ * @param block_capacity The maximum size of a block, in bytes.
+ * @return false if the ring could not be created, true otherwise.
+ */
+bool shmring_create(const char* name, uint32_t sample_rate, OutputFormat format, uint32_t block_count, uint32_t block_capacity);
+
+/**
+ * @brief Publishes a block into the ring created with `shmring_create()`, and wakes up the readers.
+ * @param data The data of the block.
+ * @param size The size of the block, at most `block_capacity` bytes.
+ * @return false if no ring was created or the block is too big, true otherwise.
+ */
+bool shmring_publish(const uint8_t* data, size_t size);
+
+/**
+ * @brief Marks the ring as closed, wakes up the readers, and unmaps and unlinks it.
+ *
+ * @details Readers that already mapped the ring can still read the blocks left in it.
+ */
+void shmring_destroy(void);
+
+/**
+ * @brief Maps an existing shared-memory ring for reading.
+ * @param name The name of the shared-memory object.
+ * @return false if the ring does not exist or is not a valid ring, true otherwise.
+ */
+bool shmring_attach(const char* name);
+
+/**
+ * @brief Retrieves the header of the mapped ring.
+ * @return The header, or NULL if no ring is mapped.
+ */
+const ShmringHeader* shmring_header(void);
+
+/**
+ * @brief Retrieves a block from the ring attached with `shmring_attach()`.
+ *
+ * @details The block is read in place: `*data` points into the shared memory, and the block can be
+ * overwritten by the producer while it is being used. Call `shmring_valid()` after using it, and treat
+ * it as lost if that returns false.
+ *
+ * @param sequence The number of the block to read. Moved to the oldest block in the ring if the block
+ * was overwritten; the caller increments it after reading a block.
+ * @param data Set to the data of the block.
+ * @param size Set to the size of the block, in bytes.
+ * @param wait Whether to wait for the block to be published.
+ * @return The result of the read, see `ShmringStatus`.
+ */
+ShmringStatus shmring_read(uint64_t* sequence, const uint8_t** data, size_t* size, bool wait);
+
+/**
+ * @brief Checks whether a block read with `shmring_read()` is still in the ring.
+ * @param sequence The number of the block.
+ */
+bool shmring_valid(uint64_t sequence);
+
+/**
+ * @brief Unmaps the ring attached with `shmring_attach()`.
+ */
+void shmring_detach(void);
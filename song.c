@@ -0,0 +1,420 @@
+#include "song.h"
+#include "looper.h"
+#include "composer.h"
+#include "envelope.h"
+#include "noise.h"
+#include "custom.h"
+#include "samples.h"
+#include "effects.h"
+#include "bytebeat.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#define MAX_LINE_LENGTH 4096
+#define MAX_TOKENS 256
+
+static uint16_t length_beats = 0; // 0 until the `loop` command
+static bool channel_enabled[CUSTOM + 1];
+
+static const char* CHANNEL_NAMES[] = { "square", "sawtooth", "triangle", "noise", "custom" };
+static const char* ENVELOPE_NAMES[] = { "constant", "decay-slow", "decay-medium", "decay-fast", "hit" };
+
+// Parsing context, for error messages
+static const char* song_path;
+static int line_number;
+static char* error_message;
+static size_t error_message_size;
+
+static bool fail(const char* format, ...) {
+    int written = snprintf(error_message, error_message_size, "%s:%d: ", song_path, line_number);
+    if(written < 0 || (size_t)written >= error_message_size) return false;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error_message + written, error_message_size - written, format, args);
+    va_end(args);
+    return false;
+}
+
+static bool parse_number(const char* token, long min, long max, long* out) {
+    char* end;
+    long value = strtol(token, &end, 10);
+    if(*token == '\0' || *end != '\0' || value < min || value > max) return fail("invalid number %s (expected %ld to %ld)", token, min, max);
+
+    *out = value;
+    return true;
+}
+
+static bool parse_channel(const char* token, Channel* out) {
+    for(int i = 0; i <= CUSTOM; i++) {
+        if(strcmp(token, CHANNEL_NAMES[i]) == 0) {
+            if(length_beats > 0 && !channel_enabled[i]) return fail("channel %s is not enabled", token);
+            *out = (Channel)i;
+            return true;
+        }
+    }
+    return fail("unknown channel %s", token);
+}
+
+static bool parse_envelope(const char* token, Envelope* out) {
+    for(int i = 0; i <= HIT; i++) {
+        if(strcmp(token, ENVELOPE_NAMES[i]) == 0) {
+            *out = (Envelope)i;
+            return true;
+        }
+    }
+
+    unsigned int attack, decay, sustain, release;
+    char end;
+    if(sscanf(token, "adsr:%u,%u,%u,%u%c", &attack, &decay, &sustain, &release, &end) == 4
+        && attack <= UINT16_MAX && decay <= UINT16_MAX && sustain <= 255 && release <= UINT16_MAX) {
+        *out = envelope_register_adsr((uint16_t)attack, (uint16_t)decay, (uint8_t)sustain, (uint16_t)release);
+        if(*out == ENVELOPE_INVALID) return fail("too many ADSR envelopes");
+        return true;
+    }
+
+    return fail("invalid envelope %s", token);
+}
+
+static bool parse_flags(const char* token, bool* staccato, bool* doubles) {
+    *staccato = false;
+    *doubles = false;
+    if(strcmp(token, "-") == 0) return true;
+
+    for(const char* c = token; *c; c++) {
+        if(*c == 's') *staccato = true;
+        else if(*c == 'd') *doubles = true;
+        else return fail("invalid flags %s (expected s, d, sd or -)", token);
+    }
+    return true;
+}
+
+// Parses a frequency in Hz or a note name, such as A4, C#5 or Bb3
+static bool parse_frequency(const char* token, uint16_t* out) {
+    if(isdigit((unsigned char)token[0])) {
+        long value;
+        if(!parse_number(token, 0, UINT16_MAX, &value)) return false; // 0 is a new noise value at every sample
+        *out = (uint16_t)value;
+        return true;
+    }
+
+    static const int SEMITONES[] = { 9, 11, 0, 2, 4, 5, 7 }; // A to G
+    char letter = (char)toupper((unsigned char)token[0]);
+    if(letter < 'A' || letter > 'G') return fail("invalid frequency %s", token);
+
+    int semitone = SEMITONES[letter - 'A'];
+    const char* rest = token + 1;
+    if(*rest == '#') {
+        semitone++;
+        rest++;
+    } else if(*rest == 'b') {
+        semitone--;
+        rest++;
+    }
+
+    long octave;
+    if(!parse_number(rest, 0, 8, &octave)) return false;
+
+    uint16_t frequency = composer_get_frequency((int)octave * 12 + semitone);
+    if(frequency == 0) return fail("note %s is out of range", token);
+
+    *out = frequency;
+    return true;
+}
+
+// Parses <beat> <sixteenth> <length> and checks that the range starts inside the loop; the looper ignores the rest
+static bool parse_range(char** tokens, uint16_t* beat, uint16_t* sixteenth, uint16_t* length) {
+    long values[3];
+    if(!parse_number(tokens[0], 0, UINT16_MAX, &values[0])
+        || !parse_number(tokens[1], 0, UINT16_MAX, &values[1])
+        || !parse_number(tokens[2], 1, UINT16_MAX, &values[2])) return false;
+
+    if(values[0] * 4 + values[1] >= (long)length_beats * 4) return fail("position past the end of the loop");
+
+    *beat = (uint16_t)values[0];
+    *sixteenth = (uint16_t)values[1];
+    *length = (uint16_t)values[2];
+    return true;
+}
+
+// Parses <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags>, the arguments shared by the note commands
+typedef struct note_arguments {
+    Channel channel;
+    uint16_t beat, sixteenth, length;
+    uint8_t volume;
+    Envelope envelope;
+    bool staccato, doubles;
+} NoteArguments;
+
+static bool parse_note_arguments(char** tokens, NoteArguments* out) {
+    long volume;
+    if(!parse_channel(tokens[0], &out->channel)
+        || !parse_range(tokens + 1, &out->beat, &out->sixteenth, &out->length)
+        || !parse_number(tokens[4], 0, 255, &volume)
+        || !parse_envelope(tokens[5], &out->envelope)
+        || !parse_flags(tokens[6], &out->staccato, &out->doubles)) return false;
+
+    out->volume = (uint8_t)volume;
+    return true;
+}
+
+// Loads a wavetable file into the custom channel's bank; relative paths are relative to the song file
+static bool load_sample(uint8_t index, const char* path) {
+    char full_path[MAX_LINE_LENGTH * 2];
+    const char* separator = strrchr(song_path, '/');
+    #if defined(_WIN32) || defined(_WIN64)
+    const char* backslash = strrchr(song_path, '\\');
+    if(backslash && (!separator || backslash > separator)) separator = backslash;
+    bool absolute = path[0] == '/' || path[0] == '\\' || (path[0] != '\0' && path[1] == ':');
+    #else
+    bool absolute = path[0] == '/';
+    #endif
+
+    if(!absolute && separator) {
+        snprintf(full_path, sizeof(full_path), "%.*s%s", (int)(separator - song_path + 1), song_path, path);
+        path = full_path;
+    }
+
+    char error[256];
+    uint32_t length;
+    const uint8_t* data = samples_load(path, &length, error, sizeof(error));
+    if(!data) return fail("%s", error);
+
+    custom_bank_set(index, data, length);
+    return true;
+}
+
+static bool run_loop(char** tokens, int count) {
+    if(length_beats > 0) return fail("loop can only be used once");
+    if(count < 3) return fail("usage: loop <beats> <bpm> <channel>...");
+
+    long beats, bpm;
+    long max_bpm = looper_max_tempo_q16() >> 16; // Sixteenths must be at least one sample long
+    if(max_bpm > UINT16_MAX) max_bpm = UINT16_MAX;
+    if(!parse_number(tokens[0], 1, UINT16_MAX / 4, &beats) || !parse_number(tokens[1], 1, max_bpm, &bpm)) return false;
+
+    memset(channel_enabled, 0, sizeof(channel_enabled));
+    for(int i = 2; i < count; i++) {
+        Channel channel;
+        if(!parse_channel(tokens[i], &channel)) return false;
+        channel_enabled[channel] = true;
+    }
+
+    // Songs loaded one after the other in the same process must not inherit each other's noise
+    noise_set_mode(NOISE_MODE_LONG);
+    noise_set_seed(NOISE_DEFAULT_SEED);
+    custom_bank_clear();
+    custom_select(0);
+    custom_set_interpolated(false);
+
+    looper_init((uint16_t)beats, (uint16_t)bpm,
+        channel_enabled[SQUARE], channel_enabled[SAWTOOTH], channel_enabled[TRIANGLE], channel_enabled[NOISE], channel_enabled[CUSTOM]);
+    length_beats = (uint16_t)beats;
+    return true;
+}
+
+static bool run_command(char** tokens, int count) {
+    const char* command = tokens[0];
+    tokens++;
+    count--;
+
+    if(strcmp(command, "loop") == 0) return run_loop(tokens, count);
+    if(length_beats == 0) return fail("the song must start with a loop command");
+
+    NoteArguments note;
+    if(strcmp(command, "tempo") == 0) {
+        double bpm;
+        char end;
+        if(count != 1 || sscanf(tokens[0], "%lf%c", &bpm, &end) != 1 || bpm <= 0 || bpm > UINT16_MAX) return fail("usage: tempo <bpm>");
+        if(bpm > looper_max_tempo_q16() / 65536.0) return fail("tempo too high for the sample rate (at most %.0f)", looper_max_tempo_q16() / 65536.0);
+        looper_change_tempo_q16(LOOPER_TEMPO_Q16(bpm));
+    } else if(strcmp(command, "band-limited") == 0) {
+        Channel channel;
+        if(count != 1) return fail("usage: band-limited <channel>");
+        if(!parse_channel(tokens[0], &channel)) return false;
+        looper_set_band_limited(channel, true);
+    } else if(strcmp(command, "noise") == 0) {
+        long seed = NOISE_DEFAULT_SEED;
+        if(count < 1 || count > 2 || (strcmp(tokens[0], "long") != 0 && strcmp(tokens[0], "short") != 0)) return fail("usage: noise <long|short> [seed]");
+        if(count == 2 && !parse_number(tokens[1], 0, INT32_MAX, &seed)) return false;
+        noise_set_mode(strcmp(tokens[0], "short") == 0 ? NOISE_MODE_SHORT : NOISE_MODE_LONG);
+        noise_set_seed((uint32_t)seed);
+    } else if(strcmp(command, "sample") == 0) {
+        long index;
+        if(count != 2) return fail("usage: sample <wavetable> <path>");
+        if(!parse_number(tokens[0], 0, CUSTOM_MAX_WAVETABLES - 1, &index)) return false;
+        return load_sample((uint8_t)index, tokens[1]);
+    } else if(strcmp(command, "wavetable") == 0) {
+        long values[3];
+        if(count != 3) return fail("usage: wavetable <beat> <sixteenth> <wavetable>");
+        if(!parse_number(tokens[0], 0, UINT16_MAX, &values[0]) || !parse_number(tokens[1], 0, UINT16_MAX, &values[1])
+            || !parse_number(tokens[2], 0, CUSTOM_MAX_WAVETABLES - 1, &values[2])) return false;
+        if(!looper_set_wavetable((uint16_t)(values[0] * 4 + values[1]), (uint8_t)values[2])) return fail("position past the end of the loop, or too many wavetable changes");
+    } else if(strcmp(command, "interpolate") == 0) {
+        if(count != 0) return fail("usage: interpolate");
+        custom_set_interpolated(true);
+    } else if(strcmp(command, "bytebeat") == 0) {
+        long values[2];
+        if(count < 3) return fail("usage: bytebeat <rate> <volume> <formula>");
+        if(!parse_number(tokens[0], 1, LOOPER_MAX_SAMPLE_RATE, &values[0]) || !parse_number(tokens[1], 0, 255, &values[1])) return false;
+
+        // The formula may contain spaces, which split it into several tokens
+        char formula[MAX_LINE_LENGTH];
+        formula[0] = '\0';
+        for(int i = 2; i < count; i++) {
+            if(i > 2) strcat(formula, " ");
+            strcat(formula, tokens[i]);
+        }
+
+        char error[128];
+        if(!bytebeat_set_formula(formula, error, sizeof(error))) return fail("%s", error);
+        bytebeat_set_rate((uint32_t)values[0]);
+        bytebeat_set_amplitude((uint8_t)values[1]);
+        looper_enable_bytebeat(true);
+    } else if(strcmp(command, "delay") == 0) {
+        long values[3];
+        if(count != 3) return fail("usage: delay <milliseconds> <feedback> <mix>");
+        if(!parse_number(tokens[0], 1, EFFECTS_MAX_DELAY_MS, &values[0]) || !parse_number(tokens[1], 0, 255, &values[1])
+            || !parse_number(tokens[2], 0, 255, &values[2])) return false;
+        if(!effects_add_delay((uint16_t)values[0], (uint8_t)values[1], (uint8_t)values[2])) return fail("too many effects");
+    } else if(strcmp(command, "lowpass") == 0) {
+        long cutoff;
+        if(count != 1) return fail("usage: lowpass <frequency>");
+        if(!parse_number(tokens[0], 1, UINT16_MAX, &cutoff)) return false;
+        if(!effects_add_lowpass((uint16_t)cutoff)) return fail("too many effects");
+    } else if(strcmp(command, "bitcrush") == 0) {
+        long bits;
+        if(count != 1) return fail("usage: bitcrush <bits>");
+        if(!parse_number(tokens[0], 1, 8, &bits)) return false;
+        if(!effects_add_bitcrush((uint8_t)bits)) return fail("too many effects");
+    } else if(strcmp(command, "downsample") == 0) {
+        long rate;
+        if(count != 1) return fail("usage: downsample <rate>");
+        if(!parse_number(tokens[0], 1, LOOPER_MAX_SAMPLE_RATE, &rate)) return false;
+        if(!effects_add_downsample((uint32_t)rate)) return fail("too many effects");
+    } else if(strcmp(command, "note") == 0) {
+        uint16_t frequency;
+        if(count != 8) return fail("usage: note <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency>");
+        if(!parse_note_arguments(tokens, &note) || !parse_frequency(tokens[7], &frequency)) return false;
+        composer_set_note(note.channel, note.beat, note.sixteenth, note.length, note.volume, note.envelope, note.staccato, note.doubles, frequency);
+    } else if(strcmp(command, "notes") == 0) {
+        uint16_t frequencies[MAX_TOKENS];
+        if(count < 8) return fail("usage: notes <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency>...");
+        if(!parse_note_arguments(tokens, &note)) return false;
+        int notes = count - 7;
+        for(int i = 0; i < notes; i++) {
+            if(!parse_frequency(tokens[7 + i], &frequencies[i])) return false;
+        }
+        composer_set_frequencies(note.channel, note.beat, note.sixteenth, note.length, note.volume, note.envelope, note.staccato, note.doubles, frequencies, notes);
+    } else if(strcmp(command, "slide") == 0) {
+        uint16_t from, to;
+        if(count != 9) return fail("usage: slide <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency> <frequency>");
+        if(!parse_note_arguments(tokens, &note) || !parse_frequency(tokens[7], &from) || !parse_frequency(tokens[8], &to)) return false;
+        composer_set_slide(note.channel, note.beat, note.sixteenth, note.length, note.volume, note.envelope, note.staccato, note.doubles, from, to);
+    } else if(strcmp(command, "glissando") == 0) {
+        uint16_t frequency;
+        long step;
+        if(count != 9) return fail("usage: glissando <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency> <step>");
+        if(!parse_note_arguments(tokens, &note) || !parse_frequency(tokens[7], &frequency) || !parse_number(tokens[8], -96, 96, &step)) return false;
+        composer_set_glissando(note.channel, note.beat, note.sixteenth, note.length, note.volume, note.envelope, note.staccato, note.doubles,
+            composer_get_note_index(frequency), (int)step);
+    } else if(strcmp(command, "rest") == 0) {
+        Channel channel;
+        uint16_t beat, sixteenth, length;
+        if(count != 4) return fail("usage: rest <channel> <beat> <sixteenth> <length>");
+        if(!parse_channel(tokens[0], &channel) || !parse_range(tokens + 1, &beat, &sixteenth, &length)) return false;
+        composer_set_rest(channel, beat, sixteenth, length);
+    } else if(strcmp(command, "dynamics") == 0) {
+        Channel channel;
+        uint16_t beat, sixteenth, length;
+        long start, end;
+        if(count != 6) return fail("usage: dynamics <channel> <beat> <sixteenth> <length> <start factor> <end factor>");
+        if(!parse_channel(tokens[0], &channel) || !parse_range(tokens + 1, &beat, &sixteenth, &length)
+            || !parse_number(tokens[4], 0, 255, &start) || !parse_number(tokens[5], 0, 255, &end)) return false;
+        composer_apply_dynamics(channel, beat, sixteenth, length, (uint8_t)start, (uint8_t)end);
+    } else if(strcmp(command, "copy") == 0) {
+        Channel source, destination;
+        uint16_t source_beat, source_sixteenth, destination_beat, destination_sixteenth, length, unused;
+        char* source_range[3];
+        if(count != 7) return fail("usage: copy <channel> <beat> <sixteenth> <channel> <beat> <sixteenth> <length>");
+        source_range[0] = tokens[1];
+        source_range[1] = tokens[2];
+        source_range[2] = tokens[6];
+        if(!parse_channel(tokens[0], &source) || !parse_channel(tokens[3], &destination)
+            || !parse_range(source_range, &source_beat, &source_sixteenth, &unused)
+            || !parse_range(tokens + 4, &destination_beat, &destination_sixteenth, &length)) return false;
+        composer_copy_section(source, source_beat, source_sixteenth, destination, destination_beat, destination_sixteenth, length);
+    } else if(strcmp(command, "shift") == 0) {
+        Channel channel;
+        uint16_t beat, sixteenth, length;
+        long semitones;
+        if(count != 5) return fail("usage: shift <channel> <beat> <sixteenth> <length> <semitones>");
+        if(!parse_channel(tokens[0], &channel) || !parse_range(tokens + 1, &beat, &sixteenth, &length)
+            || !parse_number(tokens[4], -96, 96, &semitones)) return false;
+        composer_shift_semitones(channel, beat, sixteenth, length, (int)semitones);
+    } else {
+        return fail("unknown command %s", command);
+    }
+
+    return true;
+}
+
+bool song_load(const char* path, char* error, size_t error_size) {
+    song_path = path;
+    line_number = 0;
+    error_message = error;
+    error_message_size = error_size;
+    length_beats = 0;
+
+    FILE* file = fopen(path, "r");
+    if(!file) {
+        snprintf(error, error_size, "%s: could not open the file", path);
+        return false;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    char* tokens[MAX_TOKENS];
+    bool ok = true;
+
+    while(ok && fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        // Comments start at a `#` at the beginning of the line or after whitespace, so notes like C#5 are kept
+        for(char* position = line; *position; position++) {
+            if(*position == '#' && (position == line || position[-1] == ' ' || position[-1] == '\t')) {
+                *position = '\0';
+                break;
+            }
+        }
+
+        int count = 0;
+        for(char* token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+            if(count == MAX_TOKENS) {
+                ok = fail("too many arguments");
+                break;
+            }
+            tokens[count++] = token;
+        }
+
+        if(ok && count > 0) ok = run_command(tokens, count);
+    }
+
+    fclose(file);
+
+    if(ok && length_beats == 0) {
+        snprintf(error, error_size, "%s: the song has no loop command", path);
+        ok = false;
+    }
+    return ok;
+}
+
+uint64_t song_length_samples(void) {
+    return ((uint64_t)looper_samples_per_sixteenth_q16() * length_beats * 4) >> 16;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+ * @file song.h
+ * @brief Header file for the song loader, which sets up the looper from a text file.
+ *
+ * @details A song file describes a loop with the same operations a `setup_looper()` function performs
+ * through the composer, one per line, so that songs can be rendered without recompiling the program.
+ * Empty lines and comments, from a `#` at the beginning of a line or after a space or tab to the end of
+ * the line, are ignored (a `#` within a note name such as `C#5` does not start a comment); the other
+ * lines are a command followed by its arguments, separated by spaces or tabs:
+ *
+ * - `loop <beats> <bpm> <channel>...`: initializes the looper with the listed channels (`square`,
+ *   `sawtooth`, `triangle`, `noise`, `custom`); must be the first command.
+ * - `tempo <bpm>`: changes the tempo, which can be fractional.
+ *   Tempos, including that of `loop`, can be at most 15 times the sample rate (see `looper_max_tempo_q16()`).
+ * - `band-limited <channel>`: switches a channel to band-limited output.
+ * - `noise <long|short> [seed]`: sets the period mode and seed of the noise channel (see noise.h).
+ * - `sample <wavetable> <path>`: loads a raw or WAV file (see samples.h) into the custom channel's bank;
+ *   relative paths are relative to the directory of the song file.
+ * - `wavetable <beat> <sixteenth> <wavetable>`: selects the custom channel's wavetable from that
+ *   position (see `looper_set_wavetable()`).
+ * - `interpolate`: interpolates the custom channel's wavetables linearly.
+ * - `bytebeat <rate> <volume> <formula>`: enables the bytebeat channel, playing the formula with `t`
+ *   counting at the given rate in Hz (see bytebeat.h); the formula can contain spaces.
+ * - `delay <milliseconds> <feedback> <mix>`, `lowpass <frequency>`, `bitcrush <bits>`,
+ *   `downsample <rate>`: add an effect to the end of the effects chain (see effects.h).
+ * - `note <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency>`
+ * - `notes <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency>...`
+ * - `slide <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency> <frequency>`
+ * - `glissando <channel> <beat> <sixteenth> <length> <volume> <envelope> <flags> <frequency> <step>`
+ * - `rest <channel> <beat> <sixteenth> <length>`
+ * - `dynamics <channel> <beat> <sixteenth> <length> <start factor> <end factor>`
+ * - `copy <channel> <beat> <sixteenth> <channel> <beat> <sixteenth> <length>`
+ * - `shift <channel> <beat> <sixteenth> <length> <semitones>`
+ *
+ * These call the `composer_*()` function with the same name (`notes` calls
+ * `composer_set_frequencies()`). Envelopes are `constant`, `decay-slow`, `decay-medium`,
+ * `decay-fast`, `hit` or `adsr:<attack ms>,<decay ms>,<sustain>,<release ms>`; flags are any of `s`
+ * (staccato) and `d` (doubles), or `-` for none; frequencies are in Hz, or note names such as `A4`,
+ * `C#5` or `Bb3`; on the noise channel they set how often the noise changes value, and 0 changes it
+ * at every sample. Positions must be inside the loop, while notes that extend past its end are
+ * truncated, as with the composer functions.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-25
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Loads a song file into the looper.
+ *
+ * @details The looper is initialized by the song, so it must not be initialized already;
+ * `looper_free()` must be called before loading another song.
+ *
+ * @param path The path of the song file.
+ * @param error Set to a description of the problem, including the line number, if loading fails.
+ * @param error_size The size of `error`, in bytes.
+ * @return false if the file could not be read or is not a valid song, true otherwise.
+ */
+bool song_load(const char* path, char* error, size_t error_size);
+
+/**
+ * @brief Computes the length of the loaded song, in samples at the looper's sample rate.
+ */
+uint64_t song_length_samples(void);
@@ -1,24 +1,37 @@
 #include "square.h"
 #include "macros.h"
 #include "utils.h"
+#include "bandlimited.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-static uint16_t current_sample = 0;
+static uint32_t sample_rate = SAMPLE_RATE;
+static uint32_t current_sample = 0;
 
 static uint8_t duty_cycle = 127; // 50% duty cycle
-static uint16_t cutoff_sample = SAMPLE_RATE / 2; // Before cutoff = high, after = low. Recalculated in set_duty_cycle
+static uint32_t cutoff_sample = SAMPLE_RATE / 2; // Before cutoff = high, after = low. Recalculated in set_duty_cycle and set_sample_rate
 
 static uint16_t samples_per_step = 1;
 static uint8_t amplitude = 255;
 
+static bool band_limited = false;
+static const int16_t* sawtooth_table = NULL; // Band-limited sawtooth table for the current frequency
+static uint16_t duty_offset = BANDLIMITED_TABLE_SIZE / 2; // Duty cycle in wavetable samples
+static int32_t duty_center = 0; // DC offset of the difference of the two sawtooth reads
+static uint32_t index_scale = 0; // Converts the phase to a wavetable index, see bandlimited_index_scale()
+
 uint8_t square_duty_cycle(void) {
     return duty_cycle;
 }
 
 void square_set_duty_cycle(uint8_t duty) {
     duty_cycle = duty;
-    cutoff_sample = (samples_per_step * duty_cycle) / 255;
+    cutoff_sample = (uint32_t)(((uint64_t)sample_rate * duty_cycle) / 255);
+
+    duty_offset = ((uint32_t)BANDLIMITED_TABLE_SIZE * duty_cycle) / 255;
+    duty_center = BANDLIMITED_PEAK - (2 * BANDLIMITED_PEAK * (int32_t)duty_cycle) / 255;
 }
 
 uint16_t square_frequency(void) {
@@ -26,9 +39,25 @@ uint16_t square_frequency(void) {
 }
 
 void square_set_frequency(uint16_t frequency) {
+    if(band_limited && frequency != samples_per_step) {
+        sawtooth_table = bandlimited_table(BANDLIMITED_SAWTOOTH, frequency);
+    }
     samples_per_step = frequency;
 }
 
+bool square_band_limited(void) {
+    return band_limited;
+}
+
+void square_set_band_limited(bool enabled) {
+    if(enabled) {
+        bandlimited_init(sample_rate);
+        index_scale = bandlimited_index_scale(sample_rate);
+        sawtooth_table = bandlimited_table(BANDLIMITED_SAWTOOTH, samples_per_step);
+    }
+    band_limited = enabled;
+}
+
 uint8_t square_amplitude(void) {
     return amplitude;
 }
@@ -37,19 +66,38 @@ void square_set_amplitude(uint8_t amp) {
     amplitude = amp;
 }
 
+uint32_t square_sample_rate(void) {
+    return sample_rate;
+}
+
+void square_set_sample_rate(uint32_t rate) {
+    // Keep the duty cycle, whether it was set explicitly or is the default half cycle
+    cutoff_sample = (uint32_t)((uint64_t)cutoff_sample * rate / sample_rate);
+    sample_rate = rate;
+    current_sample %= sample_rate;
+
+    if(band_limited) square_set_band_limited(true);
+}
+
 uint8_t square_step(void) {
     if (samples_per_step == 0) {
         return 0; // No sound if samples per cycle is zero
     }
 
     uint8_t output;
-    if(current_sample < cutoff_sample) {
+    if(band_limited) {
+        // Pulse wave as the difference between two sawtooths offset by the duty cycle
+        uint16_t index = bandlimited_index(current_sample, index_scale);
+        uint16_t offset_index = (index - duty_offset) & (BANDLIMITED_TABLE_SIZE - 1);
+        int32_t value = (int32_t)sawtooth_table[offset_index] - sawtooth_table[index] - duty_center;
+        output = apply_amplitude(bandlimited_to_u8(value), amplitude);
+    } else if(current_sample < cutoff_sample) {
         output = apply_amplitude(255, amplitude);
     } else {
         output = apply_amplitude(0, amplitude);
     }
 
-    current_sample = (current_sample + samples_per_step) % SAMPLE_RATE;
+    current_sample = advance_phase(current_sample, samples_per_step, sample_rate);
     
     return output;
 }
\ No newline at end of file
@@ -7,16 +7,21 @@
  * @details This module provides functions to generate a square wave signal as an
  * unsigned 8-bit integer output. The returned values will be -`amplitude`/2 or
  * +`amplitude`/2, and will loop `frequency` times per second, based on the sample
- * rate defined in macros.h. Use the `square_step` function to retrieve the next
- * sample of the square wave.
+ * rate set with `square_set_sample_rate()`. Use the `square_step` function to
+ * retrieve the next sample of the square wave.
  * 
- * @sa `SAMPLE_RATE` defined in macros.h
+ * The square wave can also be generated from band-limited wavetables (see bandlimited.h),
+ * which avoids aliasing at high frequencies at the cost of a table lookup per sample.
+ * 
+ * The sample rate defaults to `SAMPLE_RATE` (defined in macros.h) and is normally set by the looper
+ * with `looper_set_sample_rate()`.
  * 
  * @author Ovidio1005
  * @date 2025-11-16
  */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /**
  * @brief Get the current duty cycle of the square wave.
@@ -36,8 +41,7 @@ void square_set_duty_cycle(uint8_t duty);
 uint16_t square_frequency(void);
 /**
  * @brief Set the frequency of the square wave.
- * @details The waveform will loop every `SAMPLE_RATE / frequency` samples.
- * @sa `SAMPLE_RATE` defined in macros.h
+ * @details The waveform will loop every `sample_rate / frequency` samples.
  * @param frequency The desired frequency in Hz.
  */
 void square_set_frequency(uint16_t frequency);
@@ -54,6 +58,31 @@ uint8_t square_amplitude(void);
  */
 void square_set_amplitude(uint8_t amplitude);
 
+/**
+ * @brief Check whether the square wave is generated from band-limited wavetables.
+ * @return true if band-limited output is enabled, false for the naive waveform.
+ */
+bool square_band_limited(void);
+/**
+ * @brief Enable or disable band-limited output for the square wave.
+ * @details The wavetables are computed the first time this is enabled.
+ * @param enabled true to use the band-limited wavetables, false to use the naive waveform.
+ */
+void square_set_band_limited(bool enabled);
+
+/**
+ * @brief Get the sample rate of the square wave.
+ * @return The sample rate in Hz.
+ */
+uint32_t square_sample_rate(void);
+/**
+ * @brief Set the sample rate of the square wave.
+ * @details The current phase is kept, wrapped around if it is past the end of the new cycle.
+ * If band-limited output is enabled, the wavetables are rebuilt for the new sample rate.
+ * @param sample_rate The sample rate in Hz; must not be 0.
+ */
+void square_set_sample_rate(uint32_t sample_rate);
+
 /**
  * @brief Get the value for the current sample of the square wave, and advance to the next sample.
  * @return The sample value as an unsigned 8-bit integer.
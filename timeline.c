@@ -0,0 +1,142 @@
+#include "timeline.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+static TimelineEvent* events = NULL;
+static uint32_t event_count = 0;
+static uint32_t event_capacity = 0;
+
+static uint16_t ppqn = 0;
+static uint32_t length_ticks = 0;
+
+static uint32_t cursor = 0;
+
+// Ordering of events: by tick, then note offs before note ons, then by channel
+static bool event_before(const TimelineEvent* a, const TimelineEvent* b) {
+    if(a->tick != b->tick) return a->tick < b->tick;
+    if(a->type != b->type) return a->type < b->type;
+    return a->channel < b->channel;
+}
+
+void timeline_init(uint16_t ppqn_value, uint16_t length_beats) {
+    ppqn = ppqn_value;
+    length_ticks = (uint32_t)length_beats * ppqn;
+    events = NULL;
+    event_count = 0;
+    event_capacity = 0;
+    cursor = 0;
+}
+
+void timeline_free(void) {
+    if(events) {
+        free(events);
+        events = NULL;
+    }
+
+    event_count = 0;
+    event_capacity = 0;
+    cursor = 0;
+    ppqn = 0;
+    length_ticks = 0;
+}
+
+uint16_t timeline_ppqn(void) {
+    return ppqn;
+}
+
+uint32_t timeline_length_ticks(void) {
+    return length_ticks;
+}
+
+uint32_t timeline_event_count(void) {
+    return event_count;
+}
+
+bool timeline_insert(const TimelineEvent* event) {
+    if(ppqn == 0 || event->tick >= length_ticks) return false; // Not initialized or out of bounds
+
+    if(event_count == event_capacity) {
+        uint32_t new_capacity = event_capacity == 0 ? INITIAL_CAPACITY : event_capacity * 2;
+        TimelineEvent* new_events = (TimelineEvent*)realloc(events, new_capacity * sizeof(TimelineEvent));
+        if(!new_events) {
+            fprintf(stderr, "Error: Memory allocation failed in timeline_insert()\n");
+            exit(EXIT_FAILURE);
+        }
+        events = new_events;
+        event_capacity = new_capacity;
+    }
+
+    // Binary search for the first event that should come after the new one
+    uint32_t low = 0;
+    uint32_t high = event_count;
+    while(low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if(event_before(event, &events[middle])) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    memmove(&events[low + 1], &events[low], (event_count - low) * sizeof(TimelineEvent));
+    events[low] = *event;
+    event_count++;
+
+    if(low < cursor) cursor++;
+
+    return true;
+}
+
+void timeline_seek(uint32_t tick) {
+    uint32_t low = 0;
+    uint32_t high = event_count;
+    while(low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if(events[middle].tick < tick) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    cursor = low;
+}
+
+const TimelineEvent* timeline_peek(void) {
+    return cursor < event_count ? &events[cursor] : NULL;
+}
+
+void timeline_advance(void) {
+    if(cursor < event_count) cursor++;
+}
+
+static int compare_events(const void* a, const void* b) {
+    const TimelineEvent* first = (const TimelineEvent*)a;
+    const TimelineEvent* second = (const TimelineEvent*)b;
+    return event_before(first, second) ? -1 : event_before(second, first) ? 1 : 0;
+}
+
+void timeline_resize(uint16_t length_beats) {
+    if(ppqn == 0) return;
+    length_ticks = (uint32_t)length_beats * ppqn;
+
+    uint32_t kept = 0;
+    for(uint32_t i = 0; i < event_count; i++) {
+        TimelineEvent event = events[i];
+        if(event.tick >= length_ticks) {
+            if(event.type != TIMELINE_NOTE_OFF) continue;
+            event.tick %= length_ticks; // Wrap around, so the note still ends
+        }
+        events[kept++] = event;
+    }
+
+    event_count = kept;
+    qsort(events, event_count, sizeof(TimelineEvent), compare_events);
+    cursor = 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+/**
+ * @file timeline.h
+ * @brief Header file for the timeline module, a sparse index of note events at tick resolution.
+ *
+ * @details While the looper's grid stores one set of attributes per sixteenth, the timeline stores
+ * individual note on and note off events positioned in ticks, with a configurable number of ticks per
+ * quarter note (PPQN). It is meant for the notes that do not fit the grid, such as triplets, swing and
+ * grace notes, and only costs memory for the events it actually contains.
+ *
+ * Events are kept sorted by tick. Playback goes through a cursor: `timeline_peek()` and
+ * `timeline_advance()` move through the events in order in O(1), and `timeline_seek()` moves the
+ * cursor to an arbitrary tick in O(log n).
+ *
+ * The timeline is played by the looper; use `looper_enable_timeline()` and `looper_add_timeline_note()`
+ * rather than calling `timeline_init()` and `timeline_insert()` directly.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-20
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Types of timeline events.
+ */
+typedef enum timeline_event_type {
+    /** Stops the note playing on the channel. */
+    TIMELINE_NOTE_OFF,
+    /** Starts a new note on the channel. */
+    TIMELINE_NOTE_ON
+} TimelineEventType;
+
+/**
+ * @brief A single timeline event.
+ */
+typedef struct timeline_event {
+    /** The position of the event, in ticks since the beginning of the loop. */
+    uint32_t tick;
+    /** The frequency of the note in Hz (note on only). */
+    uint16_t frequency;
+    /** The volume of the note, 0-255 (note on only). */
+    uint8_t volume;
+    /** The ID of the render-time envelope of the note, or 0 for none (note on only). */
+    uint8_t envelope;
+    /** The channel the event applies to, as a `Channel` value. */
+    uint8_t channel;
+    /** The type of the event, as a `TimelineEventType` value. */
+    uint8_t type;
+} TimelineEvent;
+
+/**
+ * @brief Initializes an empty timeline.
+ *
+ * @details This function does not free any previously allocated memory;
+ * timeline_free() must be called before calling this function again.
+ *
+ * @param ppqn The number of ticks per quarter note.
+ * @param length_beats The length of the timeline in beats.
+ */
+void timeline_init(uint16_t ppqn, uint16_t length_beats);
+
+/**
+ * @brief Frees all the events of the timeline.
+ */
+void timeline_free(void);
+
+/**
+ * @brief Retrieves the number of ticks per quarter note of the timeline.
+ * @return The PPQN, or 0 if the timeline is not initialized.
+ */
+uint16_t timeline_ppqn(void);
+
+/**
+ * @brief Retrieves the length of the timeline in ticks.
+ */
+uint32_t timeline_length_ticks(void);
+
+/**
+ * @brief Retrieves the number of events in the timeline.
+ */
+uint32_t timeline_event_count(void);
+
+/**
+ * @brief Inserts an event in the timeline, keeping the events sorted.
+ *
+ * @details Events on the same tick are ordered with note offs before note ons, so a note can end
+ * on the same tick the next one starts. If the event is inserted before the cursor, the cursor is
+ * moved so that it still points to the same event.
+ *
+ * @param event The event to insert.
+ * @return false if the event is out of bounds or the timeline is not initialized, true otherwise.
+ */
+bool timeline_insert(const TimelineEvent* event);
+
+/**
+ * @brief Moves the cursor to the first event at or after the given tick.
+ * @param tick The tick to move to.
+ */
+void timeline_seek(uint32_t tick);
+
+/**
+ * @brief Retrieves the event at the cursor, without advancing it.
+ * @return The event, or NULL if the cursor is past the last event.
+ */
+const TimelineEvent* timeline_peek(void);
+
+/**
+ * @brief Advances the cursor to the next event.
+ */
+void timeline_advance(void);
+
+/**
+ * @brief Changes the length of the timeline.
+ *
+ * @details Note ons past the new end are removed, while note offs past it are wrapped around, so that
+ * notes playing at the end still stop. The cursor is moved to the first event; use `timeline_seek()`
+ * to move it elsewhere.
+ *
+ * @param length_beats The new length of the timeline in beats.
+ */
+void timeline_resize(uint16_t length_beats);
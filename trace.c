@@ -0,0 +1,168 @@
+#include "trace.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct trace_event {
+    uint64_t time_ns; // Since trace_start()
+    const char* name;
+    char phase;
+} TraceEvent;
+
+// Events of a thread, written by that thread only
+typedef struct trace_buffer {
+    const char* thread_name;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t dropped;
+    TraceEvent events[];
+} TraceBuffer;
+
+bool trace_enabled = false;
+
+static TraceBuffer* buffers[TRACE_MAX_THREADS];
+static atomic_uint buffer_count = 0;
+static uint32_t capacity = 0;
+static uint64_t origin_ns = 0;
+static uint32_t generation = 0; // Incremented by trace_start(), so that threads allocate new buffers
+
+static atomic_uint_least64_t overflow_dropped = 0; // Events of the threads beyond TRACE_MAX_THREADS
+
+static _Thread_local TraceBuffer* local_buffer = NULL; // NULL for threads beyond TRACE_MAX_THREADS
+static _Thread_local uint32_t local_generation = 0;
+
+static uint64_t now_ns(void) {
+    #if defined(_WIN32) || defined(_WIN64)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+    #endif
+}
+
+// Retrieves the buffer of the calling thread, allocating it the first time
+static TraceBuffer* thread_buffer(void) {
+    if(local_generation == generation) return local_buffer;
+
+    local_generation = generation;
+    local_buffer = NULL;
+    unsigned int index = atomic_fetch_add_explicit(&buffer_count, 1, memory_order_relaxed);
+    if(index >= TRACE_MAX_THREADS) return NULL;
+
+    TraceBuffer* buffer = (TraceBuffer*)malloc(sizeof(TraceBuffer) + (size_t)capacity * sizeof(TraceEvent));
+    if(!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed in trace_record()\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->thread_name = NULL;
+    buffer->count = 0;
+    buffer->capacity = capacity;
+    buffer->dropped = 0;
+
+    buffers[index] = buffer;
+    local_buffer = buffer;
+    return buffer;
+}
+
+void trace_start(uint32_t events_per_thread) {
+    capacity = events_per_thread;
+    atomic_store(&buffer_count, 0);
+    atomic_store(&overflow_dropped, 0);
+    generation++;
+    origin_ns = now_ns();
+    trace_enabled = true;
+}
+
+void trace_set_thread_name(const char* name) {
+    if(!trace_enabled) return;
+
+    TraceBuffer* buffer = thread_buffer();
+    if(buffer) buffer->thread_name = name;
+}
+
+void trace_record(const char* name, char phase) {
+    uint64_t time = now_ns();
+    TraceBuffer* buffer = thread_buffer();
+
+    if(!buffer) {
+        atomic_fetch_add_explicit(&overflow_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    if(buffer->count == buffer->capacity) {
+        buffer->dropped++;
+        return;
+    }
+
+    TraceEvent* event = &buffer->events[buffer->count++];
+    event->time_ns = time - origin_ns;
+    event->name = name;
+    event->phase = phase;
+}
+
+// Number of buffers that were allocated, excluding threads beyond the maximum
+static uint32_t allocated_buffers(void) {
+    unsigned int count = atomic_load(&buffer_count);
+    return count < TRACE_MAX_THREADS ? count : TRACE_MAX_THREADS;
+}
+
+uint64_t trace_dropped_events(void) {
+    uint64_t dropped = atomic_load(&overflow_dropped);
+    for(uint32_t i = 0; i < allocated_buffers(); i++) {
+        dropped += buffers[i]->dropped;
+    }
+    return dropped;
+}
+
+bool trace_write(const char* path) {
+    FILE* file = fopen(path, "w");
+    if(!file) return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"cbeat\"}}");
+
+    for(uint32_t i = 0; i < allocated_buffers(); i++) {
+        const TraceBuffer* buffer = buffers[i];
+        uint32_t thread_id = i + 1;
+
+        if(buffer->thread_name) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", thread_id, buffer->thread_name);
+        } else {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}", thread_id, thread_id);
+        }
+
+        // Timestamps are in microseconds, with nanosecond precision
+        for(uint32_t j = 0; j < buffer->count; j++) {
+            const TraceEvent* event = &buffer->events[j];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%u}",
+                event->name, event->phase, (unsigned long long)(event->time_ns / 1000), (unsigned int)(event->time_ns % 1000), thread_id);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+void trace_stop(void) {
+    trace_enabled = false;
+
+    for(uint32_t i = 0; i < allocated_buffers(); i++) {
+        free(buffers[i]);
+        buffers[i] = NULL;
+    }
+    atomic_store(&buffer_count, 0);
+    generation++; // Every thread allocates a new buffer if tracing starts again
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+/**
+ * @file trace.h
+ * @brief Header file for the tracing module, which records when the stages of rendering and output
+ * begin and end, and exports them as a Chrome trace.
+ *
+ * @details Tracing is off unless `trace_start()` is called (`--trace <path>` on the command line).
+ * The code is instrumented with `TRACE_BEGIN()` and `TRACE_END()`, which cost a single branch on a
+ * global flag while tracing is off, so they can stay in the render path.
+ *
+ * While tracing, every thread records its events into its own buffer, allocated the first time it
+ * records an event: recording is a timestamp and a few stores, without locks or atomic operations.
+ * When a buffer is full, further events of its thread are dropped and counted. `trace_write()` then
+ * writes every buffer as a Chrome trace JSON file, which opens in Perfetto (https://ui.perfetto.dev)
+ * or `chrome://tracing`, with one track per thread.
+ *
+ * The names of events must be string literals (or otherwise outlive the trace), since only pointers
+ * to them are recorded.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-29
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Default number of events each thread can record.
+ */
+#define TRACE_DEFAULT_EVENTS (1u << 20)
+
+/**
+ * @brief Maximum number of threads that can record events.
+ */
+#define TRACE_MAX_THREADS 16
+
+/**
+ * @brief Whether events are being recorded; read by `TRACE_BEGIN()` and `TRACE_END()`.
+ */
+extern bool trace_enabled;
+
+/**
+ * @brief Records the beginning of a stage on the calling thread, if tracing.
+ * @param name The name of the stage, a string literal.
+ */
+#define TRACE_BEGIN(name) do { if(trace_enabled) trace_record(name, 'B'); } while(0)
+
+/**
+ * @brief Records the end of a stage on the calling thread, if tracing.
+ * @param name The name of the stage, the same as for `TRACE_BEGIN()`.
+ */
+#define TRACE_END(name) do { if(trace_enabled) trace_record(name, 'E'); } while(0)
+
+/**
+ * @brief Starts recording events.
+ *
+ * @details Must be called before starting the threads that record events; the time of the call is
+ * the origin of the timestamps.
+ *
+ * @param events_per_thread The number of events each thread can record.
+ */
+void trace_start(uint32_t events_per_thread);
+
+/**
+ * @brief Names the calling thread in the trace.
+ * @param name The name, a string literal; threads are named "thread <n>" otherwise.
+ */
+void trace_set_thread_name(const char* name);
+
+/**
+ * @brief Records an event on the calling thread; use `TRACE_BEGIN()` and `TRACE_END()` instead.
+ * @param name The name of the stage.
+ * @param phase 'B' for the beginning of the stage, 'E' for its end.
+ */
+void trace_record(const char* name, char phase);
+
+/**
+ * @brief Retrieves the number of events dropped because a thread's buffer was full.
+ */
+uint64_t trace_dropped_events(void);
+
+/**
+ * @brief Writes the recorded events as a Chrome trace JSON file.
+ * @details The threads that record events must have stopped, or at least stopped recording.
+ * @param path The path of the file.
+ * @return false if the file could not be written, true otherwise.
+ */
+bool trace_write(const char* path);
+
+/**
+ * @brief Stops recording events and frees the buffers.
+ * @details The threads that record events must have stopped.
+ */
+void trace_stop(void);
@@ -1,24 +1,48 @@
 #include "triangle.h"
 #include "macros.h"
 #include "utils.h"
+#include "bandlimited.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
-static const uint16_t HALF_CYCLE = SAMPLE_RATE / 2;
-
-static uint16_t current_sample = 0;
+static uint32_t sample_rate = SAMPLE_RATE;
+static uint32_t current_sample = 0;
+static uint32_t half_cycle = SAMPLE_RATE / 2;
+static uint64_t half_cycle_reciprocal = RECIPROCAL(SAMPLE_RATE / 2);
 
 static uint16_t samples_per_step = 1;
 static uint8_t amplitude = 255;
 
+static bool band_limited = false;
+static const int16_t* table = NULL; // Band-limited table for the current frequency
+static uint32_t index_scale = 0; // Converts the phase to a wavetable index, see bandlimited_index_scale()
+
 uint16_t triangle_frequency(void) {
     return samples_per_step;
 }
 
 void triangle_set_frequency(uint16_t frequency) {
+    if(band_limited && frequency != samples_per_step) {
+        table = bandlimited_table(BANDLIMITED_TRIANGLE, frequency);
+    }
     samples_per_step = frequency;
 }
 
+bool triangle_band_limited(void) {
+    return band_limited;
+}
+
+void triangle_set_band_limited(bool enabled) {
+    if(enabled) {
+        bandlimited_init(sample_rate);
+        index_scale = bandlimited_index_scale(sample_rate);
+        table = bandlimited_table(BANDLIMITED_TRIANGLE, samples_per_step);
+    }
+    band_limited = enabled;
+}
+
 uint8_t triangle_amplitude(void) {
     return amplitude;
 }
@@ -27,19 +51,35 @@ void triangle_set_amplitude(uint8_t amp) {
     amplitude = amp;
 }
 
+uint32_t triangle_sample_rate(void) {
+    return sample_rate;
+}
+
+void triangle_set_sample_rate(uint32_t rate) {
+    sample_rate = rate;
+    half_cycle = rate / 2;
+    half_cycle_reciprocal = RECIPROCAL(half_cycle);
+    current_sample %= sample_rate;
+
+    if(band_limited) triangle_set_band_limited(true);
+}
+
 uint8_t triangle_step(void) {
     if (samples_per_step == 0) {
         return 128; // No sound if samples per cycle is zero
     }
 
     uint8_t output;
-    if(current_sample < HALF_CYCLE) {
-        output = apply_amplitude(amplitude * current_sample / HALF_CYCLE, amplitude);
+    if(band_limited) {
+        uint16_t index = bandlimited_index(current_sample, index_scale);
+        output = apply_amplitude(bandlimited_to_u8(table[index]), amplitude);
+    } else if(current_sample < half_cycle) {
+        output = apply_amplitude(reciprocal_divide(amplitude * current_sample, half_cycle_reciprocal), amplitude);
     } else {
-        output = apply_amplitude(amplitude * (SAMPLE_RATE - current_sample) / HALF_CYCLE, amplitude);
+        output = apply_amplitude(reciprocal_divide(amplitude * (sample_rate - current_sample), half_cycle_reciprocal), amplitude);
     }
 
-    current_sample = (current_sample + samples_per_step) % SAMPLE_RATE;
+    current_sample = advance_phase(current_sample, samples_per_step, sample_rate);
 
     return output;
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 /**
  * @file utils.h
- * @brief Utility functions for interpolation.
+ * @brief Utility functions for interpolation, amplitude scaling and oscillator phase arithmetic.
  * 
  * @author Ovidio1005
  * @date 2025-11-16
@@ -83,4 +83,47 @@ uint8_t quadratic_interpolate_8(uint8_t start, uint8_t end, uint32_t position, u
  * @param amplitude The amplitude scaling factor (0-255).
  * @return The amplitude-scaled 8-bit audio sample value.
  */
-uint8_t apply_amplitude(uint8_t sample_value, uint8_t amplitude);
\ No newline at end of file
+uint8_t apply_amplitude(uint8_t sample_value, uint8_t amplitude);
+
+/**
+ * @brief Number of fractional bits of the reciprocals computed by `RECIPROCAL()`.
+ */
+#define RECIPROCAL_SHIFT 44
+
+/**
+ * @brief Computes the reciprocal of a divisor, to be used with `reciprocal_divide()`.
+ * @details Use this for divisors that only change occasionally, such as the sample rate, to avoid a
+ * division for every sample. The result is in `RECIPROCAL_SHIFT`-bit fixed point, rounded up; the
+ * divisor must not be 0.
+ */
+#define RECIPROCAL(divisor) ((((uint64_t)1 << RECIPROCAL_SHIFT) / (divisor)) + 1)
+
+/**
+ * @brief Divides an integer by a divisor through its reciprocal.
+ * @details The result is exactly `dividend / divisor` as long as `dividend * divisor` is less than
+ * 2^`RECIPROCAL_SHIFT`, which holds for phases and sample rates up to a few hundred kHz.
+ * @param dividend The value to divide.
+ * @param reciprocal_value The value of `RECIPROCAL()` for the divisor.
+ * @return The quotient, rounded down.
+ */
+static inline uint32_t reciprocal_divide(uint32_t dividend, uint64_t reciprocal_value) {
+    return (uint32_t)((dividend * reciprocal_value) >> RECIPROCAL_SHIFT);
+}
+
+/**
+ * @brief Advances the phase of an oscillator, wrapping it around at the end of the cycle.
+ * @details Equivalent to `(phase + step) % cycle_length`, but only needs a comparison when `step` is
+ * shorter than a cycle, which is always the case for frequencies below the sample rate.
+ * @param phase The current phase, less than `cycle_length`.
+ * @param step The amount to advance the phase by.
+ * @param cycle_length The length of a cycle.
+ * @return The new phase.
+ */
+static inline uint32_t advance_phase(uint32_t phase, uint32_t step, uint32_t cycle_length) {
+    phase += step;
+    if(phase >= cycle_length) {
+        phase -= cycle_length;
+        if(phase >= cycle_length) phase %= cycle_length;
+    }
+    return phase;
+}
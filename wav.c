@@ -0,0 +1,254 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // For O_DIRECT
+#endif
+
+#include "wav.h"
+#include "output.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#define open_file(path) _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define write_file _write
+#define close_file _close
+#define seek_file _lseeki64
+#define aligned_free _aligned_free
+#else
+#include <unistd.h>
+#define open_file(path) open(path, O_WRONLY | O_CREAT | O_TRUNC | open_flags, 0644)
+#define write_file write
+#define close_file close
+#define seek_file lseek
+#define aligned_free free
+#endif
+
+#include <errno.h>
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+
+#define PCM_HEADER_SIZE 44
+#define FLOAT_HEADER_SIZE 58 // Extended fmt chunk and fact chunk
+
+#define OPEN_ENDED_SIZE 0xFFFFFFFF
+
+static int fd = -1;
+static bool owns_fd = false; // false for stdout
+static int open_flags = 0;
+static bool direct = false;
+static bool sequential = false;
+
+static uint8_t* buffer = NULL;
+static size_t buffered = 0;
+static uint64_t file_offset = 0; // Offset of the first byte of the buffer in the file
+
+static OutputFormat wav_format;
+static uint32_t wav_sample_rate;
+static uint32_t header_size = 0;
+static uint64_t data_size = 0;
+
+static void put_u16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    put_u16(out, (uint16_t)value);
+    put_u16(out + 2, (uint16_t)(value >> 16));
+}
+
+static uint32_t clamp_size(uint64_t size) {
+    return size > OPEN_ENDED_SIZE ? OPEN_ENDED_SIZE : (uint32_t)size;
+}
+
+// Fills the header with the sizes for `data_bytes` bytes of data, or open-ended sizes if OPEN_ENDED_SIZE
+static void build_header(uint8_t* header, uint64_t data_bytes) {
+    bool is_float = wav_format == OUTPUT_F32LE;
+    uint16_t sample_size = (uint16_t)output_sample_size(wav_format);
+    bool open_ended = data_bytes == OPEN_ENDED_SIZE;
+    uint64_t padded = data_bytes + (data_bytes & 1); // Chunks are padded to an even size
+
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, open_ended ? OPEN_ENDED_SIZE : clamp_size(header_size - 8 + padded));
+    memcpy(header + 8, "WAVE", 4);
+
+    memcpy(header + 12, "fmt ", 4);
+    put_u32(header + 16, is_float ? 18 : 16);
+    put_u16(header + 20, is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+    put_u16(header + 22, 1); // Mono
+    put_u32(header + 24, wav_sample_rate);
+    put_u32(header + 28, wav_sample_rate * sample_size);
+    put_u16(header + 32, sample_size);
+    put_u16(header + 34, sample_size * 8);
+
+    uint8_t* data_chunk = header + 36;
+    if(is_float) {
+        put_u16(header + 36, 0); // No extension
+        memcpy(header + 38, "fact", 4);
+        put_u32(header + 42, 4);
+        put_u32(header + 46, open_ended ? OPEN_ENDED_SIZE : clamp_size(data_bytes / sample_size));
+        data_chunk = header + 50;
+    }
+
+    memcpy(data_chunk, "data", 4);
+    put_u32(data_chunk + 4, open_ended ? OPEN_ENDED_SIZE : clamp_size(data_bytes));
+}
+
+static bool write_all(const uint8_t* data, size_t size) {
+    while(size > 0) {
+        long written = (long)write_file(fd, data, (unsigned int)size);
+        if(written < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+// Writes the buffer to the file; with O_DIRECT, only whole aligned blocks are written unless `all` is set
+static bool flush_buffer(bool all) {
+    size_t size = buffered;
+    if(direct && !all) size -= size % WAV_BUFFER_ALIGNMENT;
+    if(size == 0) return true;
+
+    if(!write_all(buffer, size)) return false;
+
+    #if defined(POSIX_FADV_DONTNEED)
+    if(sequential) posix_fadvise(fd, (off_t)file_offset, (off_t)size, POSIX_FADV_DONTNEED);
+    #endif
+
+    file_offset += size;
+    buffered -= size;
+    memmove(buffer, buffer + size, buffered);
+    return true;
+}
+
+bool wav_open(const char* path, uint32_t sample_rate, OutputFormat format, int flags) {
+    if(output_sample_size(format) == 0) return false;
+
+    wav_format = format;
+    wav_sample_rate = sample_rate;
+    header_size = format == OUTPUT_F32LE ? FLOAT_HEADER_SIZE : PCM_HEADER_SIZE;
+    data_size = 0;
+    buffered = 0;
+    file_offset = 0;
+
+    bool to_stdout = strcmp(path, "-") == 0;
+    direct = false;
+    sequential = (flags & WAV_SEQUENTIAL) != 0;
+    open_flags = 0;
+    #ifdef O_DIRECT
+    if((flags & WAV_DIRECT) && !to_stdout) {
+        open_flags = O_DIRECT;
+        direct = true;
+    }
+    #endif
+
+    #if defined(_WIN32) || defined(_WIN64)
+    buffer = (uint8_t*)_aligned_malloc(WAV_BUFFER_SIZE, WAV_BUFFER_ALIGNMENT);
+    #else
+    if(posix_memalign((void**)&buffer, WAV_BUFFER_ALIGNMENT, WAV_BUFFER_SIZE) != 0) buffer = NULL;
+    #endif
+    if(!buffer) {
+        fprintf(stderr, "Error: Memory allocation failed in wav_open()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(to_stdout) {
+        fflush(stdout);
+        #if defined(_WIN32) || defined(_WIN64)
+        _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+        fd = 1;
+        owns_fd = false;
+    } else {
+        fd = open_file(path);
+        if(fd < 0 && direct) {
+            // Not every file system supports O_DIRECT
+            open_flags = 0;
+            direct = false;
+            fd = open_file(path);
+        }
+        owns_fd = true;
+    }
+
+    if(fd < 0) {
+        aligned_free(buffer);
+        buffer = NULL;
+        return false;
+    }
+
+    #if defined(POSIX_FADV_SEQUENTIAL)
+    if(sequential) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+
+    // The header goes through the buffer as well, so that O_DIRECT writes stay aligned
+    build_header(buffer, OPEN_ENDED_SIZE);
+    buffered = header_size;
+    return true;
+}
+
+// Copies data to the buffer, writing it to the file whenever it is full
+static bool append(const uint8_t* bytes, size_t size) {
+    while(size > 0) {
+        size_t chunk = WAV_BUFFER_SIZE - buffered;
+        if(chunk > size) chunk = size;
+        memcpy(buffer + buffered, bytes, chunk);
+        buffered += chunk;
+        bytes += chunk;
+        size -= chunk;
+
+        if(buffered == WAV_BUFFER_SIZE && !flush_buffer(false)) return false;
+    }
+
+    return true;
+}
+
+bool wav_write(const void* data, size_t size) {
+    data_size += size;
+    return append((const uint8_t*)data, size);
+}
+
+bool wav_close(void) {
+    if(fd < 0) return false;
+
+    #if defined(O_DIRECT) && defined(F_SETFL)
+    // The tail of the file and the header patch are not aligned
+    if(direct) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    #endif
+    direct = false;
+
+    bool ok = true;
+    if(data_size & 1) {
+        uint8_t pad = 0; // Chunks are padded to an even size, the pad is not counted in the data size
+        ok = append(&pad, 1);
+    }
+    ok = ok && flush_buffer(true);
+
+    // Patch the sizes in the header, if the output is seekable
+    if(ok && seek_file(fd, 0, SEEK_SET) == 0) {
+        uint8_t header[FLOAT_HEADER_SIZE];
+        build_header(header, data_size);
+        ok = write_all(header, header_size);
+    }
+
+    if(owns_fd) close_file(fd);
+    fd = -1;
+    aligned_free(buffer);
+    buffer = NULL;
+    return ok;
+}
+
+uint64_t wav_data_size(void) {
+    return data_size;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+/**
+ * @file wav.h
+ * @brief Header file for the WAV (RIFF) file writer.
+ *
+ * @details The writer produces a standard WAV file from the samples converted by the output module
+ * (see output.h), so consumers do not need to be told the sample format and rate separately.
+ *
+ * The header is written as soon as the file is opened, with open-ended (0xFFFFFFFF) sizes; when the
+ * writer is closed, the sizes are patched in if the output is seekable. Outputs that are not seekable,
+ * such as pipes, keep the open-ended sizes, which most readers treat as "read until the end of the
+ * stream".
+ *
+ * Data goes through a large buffer aligned to `WAV_BUFFER_ALIGNMENT` bytes and is written to the
+ * file one full buffer at a time. For long offline renders, the file can also be opened with
+ * `O_DIRECT` to bypass the page cache, or written with `posix_fadvise()` hints so that the written
+ * data does not fill the page cache; these are only available on Linux and ignored elsewhere.
+ *
+ * Like the other modules, the writer is a singleton: only one file can be open at a time.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-24
+ */
+
+#include "output.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Size of the write buffer, in bytes.
+ */
+#define WAV_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief Alignment of the write buffer and of the writes to the file, in bytes.
+ */
+#define WAV_BUFFER_ALIGNMENT 4096
+
+/**
+ * @brief Flags for `wav_open()`.
+ */
+typedef enum wav_flags {
+    /** Opens the file with `O_DIRECT`, bypassing the page cache. */
+    WAV_DIRECT = 0x01,
+    /** Tells the kernel the file is written sequentially, and drops written data from the page cache. */
+    WAV_SEQUENTIAL = 0x02
+} WavFlags;
+
+/**
+ * @brief Opens a WAV file for writing and writes its header.
+ *
+ * @details The write buffer is allocated dynamically, and freed by `wav_close()`.
+ * An existing file at `path` is overwritten.
+ *
+ * @param path The path of the file, or "-" to write to `stdout`.
+ * @param sample_rate The sample rate of the audio, in Hz.
+ * @param format The format of the samples that will be written.
+ * @param flags A combination of `WavFlags` values, or 0.
+ * @return false if the file could not be opened or the format is invalid, true otherwise.
+ */
+bool wav_open(const char* path, uint32_t sample_rate, OutputFormat format, int flags);
+
+/**
+ * @brief Writes samples to the file.
+ * @param data The samples, in the format passed to `wav_open()`.
+ * @param size The size of the data in bytes.
+ * @return false if writing to the file failed, true otherwise.
+ */
+bool wav_write(const void* data, size_t size);
+
+/**
+ * @brief Writes any buffered data, patches the sizes in the header if possible, and closes the file.
+ * @return false if writing to the file failed, true otherwise.
+ */
+bool wav_close(void);
+
+/**
+ * @brief Retrieves the number of bytes of audio data written since the file was opened.
+ */
+uint64_t wav_data_size(void);
@@ -0,0 +1,272 @@
+#include "writer.h"
+#include "trace.h"
+#include "realtime.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <limits.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#endif
+
+typedef struct slot {
+    uint8_t* data;
+    size_t size;
+} Slot;
+
+static Slot* slots = NULL;
+static uint32_t slot_count = 0;
+static size_t slot_capacity = 0;
+static uint32_t low_watermark = 1;
+static uint32_t high_watermark = 1;
+static WriterSink sink = NULL;
+
+// Counters of committed and written blocks; the slot of a counter is counter % slot_count
+static atomic_uint head = 0; // Written by the render thread only
+static atomic_uint tail = 0; // Written by the writer thread only
+
+static atomic_bool stopping = false;
+static atomic_bool producer_waiting = false;
+static atomic_bool failed = false;
+
+// Metrics updated by the render thread
+static uint32_t peak_fill = 0;
+static bool at_high_watermark = false;
+static atomic_uint_least64_t high_watermark_hits = 0;
+static atomic_uint_least64_t blocks_dropped = 0;
+
+// Metrics updated by the writer thread
+static atomic_uint_least64_t blocks_written = 0;
+static atomic_uint_least64_t bytes_written = 0;
+static atomic_uint_least64_t max_write_us = 0;
+
+#if defined(_WIN32) || defined(_WIN64)
+static HANDLE thread;
+static HANDLE data_ready; // Posted when the fill level reaches the low watermark
+static HANDLE space_available; // Posted when a block is written while the render thread waits
+
+static void semaphore_post(HANDLE* semaphore) { ReleaseSemaphore(*semaphore, 1, NULL); }
+static void semaphore_wait(HANDLE* semaphore) { WaitForSingleObject(*semaphore, INFINITE); }
+
+static uint64_t now_us(void) {
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart * 1000000 / frequency.QuadPart);
+}
+#else
+static pthread_t thread;
+static sem_t data_ready; // Posted when the fill level reaches the low watermark
+static sem_t space_available; // Posted when a block is written while the render thread waits
+
+static void semaphore_post(sem_t* semaphore) { sem_post(semaphore); }
+static void semaphore_wait(sem_t* semaphore) { while(sem_wait(semaphore) != 0); } // Retry if interrupted by a signal
+
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+#endif
+
+// Writes every queued block to the sink
+static void drain(void) {
+    unsigned int written = atomic_load_explicit(&tail, memory_order_relaxed);
+    unsigned int committed = atomic_load_explicit(&head, memory_order_acquire);
+
+    while(written != committed) {
+        const Slot* slot = &slots[written % slot_count];
+
+        if(!atomic_load_explicit(&failed, memory_order_relaxed)) {
+            uint64_t start = now_us();
+            TRACE_BEGIN("write");
+            bool written_ok = sink(slot->data, slot->size);
+            TRACE_END("write");
+            if(written_ok) {
+                uint64_t elapsed = now_us() - start;
+                if(elapsed > atomic_load_explicit(&max_write_us, memory_order_relaxed)) {
+                    atomic_store_explicit(&max_write_us, elapsed, memory_order_relaxed);
+                }
+                atomic_fetch_add_explicit(&blocks_written, 1, memory_order_relaxed);
+                atomic_fetch_add_explicit(&bytes_written, slot->size, memory_order_relaxed);
+            } else {
+                atomic_store_explicit(&failed, true, memory_order_relaxed);
+            }
+        }
+
+        // Blocks are released even after a failure, so the render thread never waits forever
+        written++;
+        atomic_store_explicit(&tail, written, memory_order_release);
+        if(atomic_exchange_explicit(&producer_waiting, false, memory_order_acq_rel)) semaphore_post(&space_available);
+
+        committed = atomic_load_explicit(&head, memory_order_acquire);
+    }
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static DWORD WINAPI writer_thread(LPVOID argument) {
+#else
+static void* writer_thread(void* argument) {
+#endif
+    (void)argument;
+    trace_set_thread_name("writer");
+
+    while(!atomic_load_explicit(&stopping, memory_order_acquire)) {
+        TRACE_BEGIN("wait for blocks");
+        semaphore_wait(&data_ready);
+        TRACE_END("wait for blocks");
+        drain();
+    }
+    drain();
+
+    return 0;
+}
+
+bool writer_start(WriterSink sink_function, uint32_t block_count, size_t block_capacity, uint32_t low, uint32_t high) {
+    if(!sink_function || block_count == 0 || low == 0 || low > high || high > block_count) return false;
+
+    slots = (Slot*)calloc(block_count, sizeof(Slot));
+    if(!slots) {
+        fprintf(stderr, "Error: Memory allocation failed in writer_start()\n");
+        exit(EXIT_FAILURE);
+    }
+    for(uint32_t i = 0; i < block_count; i++) {
+        slots[i].data = (uint8_t*)malloc(block_capacity);
+        if(!slots[i].data) {
+            fprintf(stderr, "Error: Memory allocation failed in writer_start()\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    sink = sink_function;
+    slot_count = block_count;
+    slot_capacity = block_capacity;
+    low_watermark = low;
+    high_watermark = high;
+
+    atomic_store(&head, 0);
+    atomic_store(&tail, 0);
+    atomic_store(&stopping, false);
+    atomic_store(&producer_waiting, false);
+    atomic_store(&failed, false);
+    peak_fill = 0;
+    at_high_watermark = false;
+    atomic_store(&high_watermark_hits, 0);
+    atomic_store(&blocks_dropped, 0);
+    atomic_store(&blocks_written, 0);
+    atomic_store(&bytes_written, 0);
+    atomic_store(&max_write_us, 0);
+
+    #if defined(_WIN32) || defined(_WIN64)
+    data_ready = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    space_available = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    thread = CreateThread(NULL, 0, writer_thread, NULL, 0, NULL);
+    return data_ready && space_available && thread;
+    #else
+    sem_init(&data_ready, 0, 0);
+    sem_init(&space_available, 0, 0);
+    return pthread_create(&thread, NULL, writer_thread, NULL) == 0;
+    #endif
+}
+
+uint8_t* writer_acquire(bool wait) {
+    unsigned int committed = atomic_load_explicit(&head, memory_order_relaxed);
+
+    while(true) {
+        uint32_t fill = committed - atomic_load_explicit(&tail, memory_order_acquire);
+        if(fill < high_watermark) {
+            at_high_watermark = false;
+            return slots[committed % slot_count].data;
+        }
+
+        if(!at_high_watermark) {
+            at_high_watermark = true;
+            atomic_fetch_add_explicit(&high_watermark_hits, 1, memory_order_relaxed);
+        }
+
+        if(!wait) {
+            atomic_fetch_add_explicit(&blocks_dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+
+        // Check again after announcing the wait, so that a block written in between is not missed
+        atomic_store_explicit(&producer_waiting, true, memory_order_seq_cst);
+        fill = committed - atomic_load_explicit(&tail, memory_order_seq_cst);
+        if(fill >= high_watermark) {
+            semaphore_post(&data_ready); // Make sure the writer thread is not waiting for the low watermark
+            TRACE_BEGIN("wait for ring space");
+            semaphore_wait(&space_available);
+            TRACE_END("wait for ring space");
+        }
+        atomic_store_explicit(&producer_waiting, false, memory_order_relaxed);
+    }
+}
+
+void writer_commit(size_t size) {
+    unsigned int committed = atomic_load_explicit(&head, memory_order_relaxed);
+    slots[committed % slot_count].size = size;
+    committed++;
+    atomic_store_explicit(&head, committed, memory_order_release);
+
+    uint32_t fill = committed - atomic_load_explicit(&tail, memory_order_acquire);
+    if(fill > peak_fill) peak_fill = fill;
+    if(fill >= low_watermark) semaphore_post(&data_ready);
+}
+
+bool writer_failed(void) {
+    return atomic_load_explicit(&failed, memory_order_relaxed);
+}
+
+void writer_metrics(WriterMetrics* out) {
+    out->block_count = slot_count;
+    out->low_watermark = low_watermark;
+    out->high_watermark = high_watermark;
+    out->fill = atomic_load_explicit(&head, memory_order_relaxed) - atomic_load_explicit(&tail, memory_order_relaxed);
+    out->peak_fill = peak_fill;
+    out->high_watermark_hits = atomic_load_explicit(&high_watermark_hits, memory_order_relaxed);
+    out->blocks_dropped = atomic_load_explicit(&blocks_dropped, memory_order_relaxed);
+    out->blocks_written = atomic_load_explicit(&blocks_written, memory_order_relaxed);
+    out->bytes_written = atomic_load_explicit(&bytes_written, memory_order_relaxed);
+    out->max_write_us = atomic_load_explicit(&max_write_us, memory_order_relaxed);
+    out->failed = atomic_load_explicit(&failed, memory_order_relaxed);
+}
+
+size_t writer_prefault(void) {
+    size_t bytes = 0;
+    for(uint32_t i = 0; slots && i < slot_count; i++) {
+        bytes += realtime_prefault(slots[i].data, slot_capacity);
+    }
+    return bytes;
+}
+
+void writer_stop(void) {
+    if(!slots) return;
+
+    atomic_store_explicit(&stopping, true, memory_order_release);
+    semaphore_post(&data_ready);
+
+    #if defined(_WIN32) || defined(_WIN64)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    CloseHandle(data_ready);
+    CloseHandle(space_available);
+    #else
+    pthread_join(thread, NULL);
+    sem_destroy(&data_ready);
+    sem_destroy(&space_available);
+    #endif
+
+    for(uint32_t i = 0; i < slot_count; i++) {
+        free(slots[i].data);
+    }
+    free(slots);
+    slots = NULL; // slot_count is kept for writer_metrics()
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+/**
+ * @file writer.h
+ * @brief Header file for the writer thread, which decouples rendering from blocking output.
+ *
+ * @details The render thread renders blocks of samples directly into the slots of a ring buffer
+ * (`writer_acquire()` and `writer_commit()`), and a dedicated thread drains the ring into a sink,
+ * such as `stdout` or a WAV file. The ring has a single producer and a single consumer, and is
+ * lock-free: the render thread never waits for a lock held by the writer thread, so a slow consumer
+ * cannot delay rendering.
+ *
+ * Two watermarks control the ring:
+ * - The writer thread is woken up once at least `low_watermark` blocks are queued, so that writes
+ *   can be batched; a low watermark of 1 writes every block as soon as it is rendered.
+ * - At most `high_watermark` blocks can be queued. When the consumer falls that far behind, new
+ *   blocks are either dropped, so that real-time rendering keeps its timing, or the render thread
+ *   waits for a free slot, which is what offline renders want.
+ *
+ * The fill level of the ring and the number of dropped blocks are tracked, and can be retrieved at
+ * any time with `writer_metrics()`.
+ *
+ * Like the other modules, the writer is a singleton.
+ *
+ * @author Ovidio1005
+ * @date 2025-11-25
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Default number of blocks in the ring.
+ */
+#define WRITER_DEFAULT_BLOCKS 32
+
+/**
+ * @brief Function that writes a block of data to the output.
+ * @return false if writing failed, true otherwise.
+ */
+typedef bool (*WriterSink)(const uint8_t* data, size_t size);
+
+/**
+ * @brief Metrics of the writer, see `writer_metrics()`.
+ */
+typedef struct writer_metrics {
+    /** Number of blocks in the ring. */
+    uint32_t block_count;
+    /** The low watermark, in blocks. */
+    uint32_t low_watermark;
+    /** The high watermark, in blocks. */
+    uint32_t high_watermark;
+    /** Number of blocks currently queued. */
+    uint32_t fill;
+    /** Highest number of blocks queued at once. */
+    uint32_t peak_fill;
+    /** Number of times the fill level reached the high watermark. */
+    uint64_t high_watermark_hits;
+    /** Number of blocks dropped because the fill level was at the high watermark. */
+    uint64_t blocks_dropped;
+    /** Number of blocks written to the sink. */
+    uint64_t blocks_written;
+    /** Number of bytes written to the sink. */
+    uint64_t bytes_written;
+    /** Longest time taken by the sink to write a block, in microseconds. */
+    uint64_t max_write_us;
+    /** Whether the sink failed; no more blocks are written after a failure. */
+    bool failed;
+} WriterMetrics;
+
+/**
+ * @brief Allocates the ring and starts the writer thread.
+ *
+ * @details This function does not free any previously allocated memory;
+ * writer_stop() must be called before calling this function again.
+ *
+ * @param sink The function the writer thread writes the blocks with.
+ * @param block_count The number of blocks in the ring.
+ * @param block_capacity The maximum size of a block, in bytes.
+ * @param low_watermark The number of queued blocks that wakes up the writer thread, at least 1.
+ * @param high_watermark The maximum number of queued blocks, between `low_watermark` and `block_count`.
+ * @return false if the arguments are invalid or the thread could not be started, true otherwise.
+ */
+bool writer_start(WriterSink sink, uint32_t block_count, size_t block_capacity, uint32_t low_watermark, uint32_t high_watermark);
+
+/**
+ * @brief Retrieves the slot to render the next block into.
+ *
+ * @details Must only be called by the render thread, and followed by `writer_commit()` when a slot is
+ * returned.
+ *
+ * @param wait Whether to wait for a free slot when the ring is at the high watermark.
+ * @return The slot, with room for `block_capacity` bytes, or NULL if the ring is at the high watermark
+ * and `wait` is false (the block is counted as dropped).
+ */
+uint8_t* writer_acquire(bool wait);
+
+/**
+ * @brief Queues the block rendered into the slot returned by `writer_acquire()`.
+ * @param size The size of the block, in bytes.
+ */
+void writer_commit(size_t size);
+
+/**
+ * @brief Checks whether the sink failed.
+ */
+bool writer_failed(void);
+
+/**
+ * @brief Retrieves the metrics of the writer.
+ * @param out Set to the current metrics.
+ */
+void writer_metrics(WriterMetrics* out);
+
+/**
+ * @brief Faults in the slots of the ring, see `realtime_prefault()`.
+ * @details Must be called by the producer before it queues the first block.
+ * @return The number of bytes prefaulted.
+ */
+size_t writer_prefault(void);
+
+/**
+ * @brief Writes every queued block, stops the writer thread and frees the ring.
+ */
+void writer_stop(void);